@@ -0,0 +1,57 @@
+/**
+@file AlignedAllocator.h
+*/
+#pragma once
+#ifndef _ALIGNED_ALLOCATOR_H_
+#define _ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A standard allocator whose blocks are aligned on \a Align bytes
+  /// (a power of two), e.g. for arrays loaded with aligned SSE or AVX
+  /// instructions: std::vector< float, AlignedAllocator<float, 32> >.
+  template <typename T, std::size_t Align>
+  struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator( const AlignedAllocator<U, Align>& ) {}
+
+    /// Allocates \a n objects. The address returned by operator new is
+    /// stored just before the aligned block.
+    T* allocate( std::size_t n )
+    {
+      std::size_t size = n * sizeof( T ) + Align + sizeof( void* );
+      char* raw = static_cast<char*>( ::operator new( size ) );
+      std::uintptr_t p = reinterpret_cast<std::uintptr_t>( raw + sizeof( void* ) );
+      p = ( p + Align - 1 ) & ~( (std::uintptr_t) Align - 1 );
+      reinterpret_cast<void**>( p )[ -1 ] = raw;
+      return reinterpret_cast<T*>( p );
+    }
+
+    void deallocate( T* p, std::size_t )
+    {
+      ::operator delete( reinterpret_cast<void**>( p )[ -1 ] );
+    }
+  };
+
+  template <typename T, typename U, std::size_t Align>
+  bool operator==( const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>& )
+  { return true; }
+
+  template <typename T, typename U, std::size_t Align>
+  bool operator!=( const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>& )
+  { return false; }
+
+} // namespace rt
+
+#endif // #define _ALIGNED_ALLOCATOR_H_
@@ -0,0 +1,402 @@
+/**
+@file BVH.cpp
+*/
+#include <algorithm>
+#include "BVH.h"
+
+namespace {
+  /// Number of bins used to evaluate the surface area heuristic.
+  const int NB_BINS = 12;
+  /// Depth after which nodes are split at the median, which bounds the
+  /// depth of the tree whatever the primitive layout.
+  const int MEDIAN_SPLIT_DEPTH = 32;
+}
+
+void
+rt::BVH::build( const std::vector<BoundingBox>& boxes, int max_leaf_size )
+{
+  nodes.clear();
+  myBuiltAreas.clear();
+  myParents.clear();
+  myLeaves.clear();
+  indices.resize( boxes.size() );
+  if ( boxes.empty() ) return;
+  std::vector<Point3> centroids( boxes.size() );
+  for ( std::size_t i = 0; i < boxes.size(); ++i ) {
+    indices[ i ]   = (int) i;
+    centroids[ i ] = boxes[ i ].centroid();
+  }
+  nodes.reserve( 2 * boxes.size() );
+  buildNode( boxes, centroids, 0, (int) boxes.size(), 0, std::max( 1, max_leaf_size ) );
+  keepAreas();
+}
+
+int
+rt::BVH::update( const std::vector<BoundingBox>& boxes, Real max_growth, int max_leaf_size )
+{
+  if ( nodes.empty() ) return 0;
+  if ( myParents.size() != nodes.size() ) link();
+  refit( boxes );
+  // The topmost degraded subtrees, in depth-first order.
+  std::vector<int> degraded, depths;
+  int nb_degraded = 0;
+  for ( int i = 0; i < (int) nodes.size(); ) {
+    if ( nodes[ i ].box.area() > max_growth * myBuiltAreas[ i ] ) {
+      int first, count;
+      range( i, first, count );
+      degraded.push_back( i );
+      depths.push_back( depth( i ) );
+      nb_degraded += count;
+      i = subtreeEnd( i );
+    } else
+      ++i;
+  }
+  // Most of the tree is degraded: a new one is cheaper and better.
+  if ( 2 * nb_degraded > (int) indices.size() ) {
+    build( boxes, max_leaf_size );
+    return 1;
+  }
+  // From the last one, so that the nodes of the others do not move.
+  for ( int k = (int) degraded.size() - 1; k >= 0; --k ) {
+    int first, count;
+    range( degraded[ k ], first, count );
+    rebuild( boxes, degraded[ k ], subtreeEnd( degraded[ k ] ), first, count, depths[ k ],
+             std::max( 1, max_leaf_size ) );
+  }
+  return (int) degraded.size();
+}
+
+int
+rt::BVH::update( const std::vector<BoundingBox>& boxes, int i, Real max_growth,
+                 int max_leaf_size )
+{
+  if ( nodes.empty() ) return 0;
+  if ( myParents.size() != nodes.size() ) link();
+  bool degraded = false;
+  for ( int node = myLeaves[ i ]; node >= 0; node = myParents[ node ] ) {
+    fit( boxes, node );
+    if ( nodes[ node ].box.area() > max_growth * myBuiltAreas[ node ] ) degraded = true;
+  }
+  if ( ! degraded ) return 0;
+  detach( boxes, i, -1, std::max( 1, max_leaf_size ) );
+  place( boxes, i, max_growth, std::max( 1, max_leaf_size ) );
+  return 1;
+}
+
+void
+rt::BVH::insert( const std::vector<BoundingBox>& boxes, Real max_growth, int max_leaf_size )
+{
+  place( boxes, (int) boxes.size() - 1, max_growth, std::max( 1, max_leaf_size ) );
+}
+
+void
+rt::BVH::remove( const std::vector<BoundingBox>& boxes, int i, int max_leaf_size )
+{
+  const int last = (int) boxes.size();
+  detach( boxes, i, i == last ? -1 : last, std::max( 1, max_leaf_size ) );
+}
+
+void
+rt::BVH::place( const std::vector<BoundingBox>& boxes, int p, Real max_growth,
+                int max_leaf_size )
+{
+  if ( nodes.empty() ) {
+    build( boxes, max_leaf_size );
+    return;
+  }
+  if ( myParents.size() != nodes.size() ) link();
+  auto growth = [&] ( const BoundingBox& b ) {
+    BoundingBox u = b;
+    u.extend( boxes[ p ] );
+    return u.area() - b.area();
+  };
+  int i = 0;
+  while ( nodes[ i ].count == 0 )
+    i = growth( nodes[ i + 1 ].box ) <= growth( nodes[ nodes[ i ].offset ].box )
+      ? i + 1 : nodes[ i ].offset;
+  const int first = nodes[ i ].offset;
+  const int count = nodes[ i ].count + 1;
+  const std::vector<int> above = ancestors( i );
+  indices.insert( indices.begin() + first + count - 1, p );
+  for ( BVHNode& node : nodes )
+    if ( node.count > 0 && node.offset > first ) node.offset += 1;
+  rebuild( boxes, i, i + 1, first, count, (int) above.size(), max_leaf_size );
+  // the ancestors come before the leaf, their index did not change.
+  for ( int node : above ) fit( boxes, node );
+  // As in update(), the highest degraded ancestor is rebuilt. So is the
+  // one at MEDIAN_SPLIT_DEPTH when the branch grows near MAX_DEPTH
+  // (sequential insertions along a line make a chain otherwise): its
+  // subtree is then split at the median, which bounds its depth.
+  const int nb_above = (int) above.size();
+  int top = -1;
+  for ( int k = nb_above - 1; k >= 0 && top < 0; --k )
+    if ( nodes[ above[ k ] ].box.area() > max_growth * myBuiltAreas[ above[ k ] ] ) top = k;
+  if ( nb_above + subtreeEnd( i ) - i > MAX_DEPTH - 16 )
+    top = std::max( top, nb_above - 1 - MEDIAN_SPLIT_DEPTH );
+  if ( top < 0 ) return;
+  int first_top, count_top;
+  range( above[ top ], first_top, count_top );
+  rebuild( boxes, above[ top ], subtreeEnd( above[ top ] ), first_top, count_top,
+           nb_above - 1 - top, max_leaf_size );
+  for ( int k = top + 1; k < nb_above; ++k ) fit( boxes, above[ k ] );
+}
+
+void
+rt::BVH::detach( const std::vector<BoundingBox>& boxes, int i, int renamed,
+                 int max_leaf_size )
+{
+  if ( nodes.empty() ) return;
+  if ( myParents.size() != nodes.size() ) link();
+  const int leaf = myLeaves[ i ];
+  const int k    = (int) ( std::find( indices.begin() + nodes[ leaf ].offset,
+                                      indices.end(), i ) - indices.begin() );
+  // A leaf left empty is merged with its sibling by rebuilding their
+  // parent, whose subtree is known before the leaf becomes empty.
+  const bool emptied = nodes[ leaf ].count == 1;
+  const int parent   = myParents[ leaf ];
+  const std::vector<int> above = ancestors( emptied ? parent : leaf );
+  int first = 0, count = 0, end = 0;
+  if ( emptied && parent >= 0 ) {
+    range( parent, first, count );
+    end = subtreeEnd( parent );
+  }
+  indices.erase( indices.begin() + k );
+  for ( BVHNode& node : nodes )
+    if ( node.count > 0 && node.offset > k ) node.offset -= 1;
+  nodes[ leaf ].count -= 1;
+  if ( renamed >= 0 )
+    for ( int& j : indices )
+      if ( j == renamed ) j = i;
+  myParents.clear();
+  myLeaves.clear();
+  if ( emptied && parent < 0 ) {
+    nodes.clear();
+    myBuiltAreas.clear();
+    return;
+  }
+  if ( emptied )
+    rebuild( boxes, parent, end, first, count - 1, (int) above.size(), max_leaf_size );
+  else
+    fit( boxes, leaf );
+  for ( int node : above ) fit( boxes, node );
+}
+
+void
+rt::BVH::rebuild( const std::vector<BoundingBox>& boxes, int node, int end,
+                  int first, int count, int depth, int max_leaf_size )
+{
+  myParents.clear();
+  myLeaves.clear();
+  std::vector<Point3> centroids( boxes.size() );
+  for ( int k = first; k < first + count; ++k )
+    centroids[ indices[ k ] ] = boxes[ indices[ k ] ].centroid();
+  // The subtree is built after the nodes, then moved in place.
+  const int size = (int) nodes.size();
+  buildNode( boxes, centroids, first, count, depth, max_leaf_size );
+  std::vector<BVHNode> subtree( nodes.begin() + size, nodes.end() );
+  std::vector<Real> areas( subtree.size() );
+  for ( std::size_t j = 0; j < subtree.size(); ++j ) {
+    if ( subtree[ j ].count == 0 ) subtree[ j ].offset -= size - node;
+    areas[ j ] = subtree[ j ].box.area();
+  }
+  nodes.resize( size );
+  // The nodes after the subtree are shifted, as are the links to them.
+  const int delta = (int) subtree.size() - ( end - node );
+  if ( delta != 0 ) {
+    for ( int j = 0; j < size; ++j )
+      if ( nodes[ j ].count == 0 && nodes[ j ].offset >= end ) nodes[ j ].offset += delta;
+    nodes.erase( nodes.begin() + node, nodes.begin() + end );
+    nodes.insert( nodes.begin() + node, subtree.size(), BVHNode() );
+    myBuiltAreas.erase( myBuiltAreas.begin() + node, myBuiltAreas.begin() + end );
+    myBuiltAreas.insert( myBuiltAreas.begin() + node, areas.size(), 0.0f );
+  }
+  std::copy( subtree.begin(), subtree.end(), nodes.begin() + node );
+  std::copy( areas.begin(), areas.end(), myBuiltAreas.begin() + node );
+}
+
+void
+rt::BVH::refit( const std::vector<BoundingBox>& boxes )
+{
+  // children come after their parent.
+  for ( int i = (int) nodes.size() - 1; i >= 0; --i )
+    fit( boxes, i );
+}
+
+void
+rt::BVH::fit( const std::vector<BoundingBox>& boxes, int node )
+{
+  BVHNode& n = nodes[ node ];
+  BoundingBox box;
+  if ( n.count == 0 ) {
+    box = nodes[ node + 1 ].box;
+    box.extend( nodes[ n.offset ].box );
+  } else
+    for ( int k = n.offset; k < n.offset + n.count; ++k )
+      box.extend( boxes[ indices[ k ] ] );
+  n.box = box;
+}
+
+int
+rt::BVH::subtreeEnd( int node ) const
+{
+  while ( nodes[ node ].count == 0 ) node = nodes[ node ].offset;
+  return node + 1;
+}
+
+void
+rt::BVH::range( int node, int& first, int& count ) const
+{
+  first = (int) indices.size();
+  count = 0;
+  const int end = subtreeEnd( node );
+  for ( int j = node; j < end; ++j )
+    if ( nodes[ j ].count > 0 ) {
+      first  = std::min( first, nodes[ j ].offset );
+      count += nodes[ j ].count;
+    }
+}
+
+void
+rt::BVH::link()
+{
+  if ( myBuiltAreas.size() != nodes.size() ) keepAreas();
+  myParents.assign( nodes.size(), -1 );
+  myLeaves.assign( indices.size(), -1 );
+  for ( int i = 0; i < (int) nodes.size(); ++i ) {
+    const BVHNode& node = nodes[ i ];
+    if ( node.count == 0 )
+      myParents[ i + 1 ] = myParents[ node.offset ] = i;
+    else
+      for ( int k = node.offset; k < node.offset + node.count; ++k )
+        myLeaves[ indices[ k ] ] = i;
+  }
+}
+
+int
+rt::BVH::depth( int node ) const
+{
+  int d = 0;
+  for ( ; myParents[ node ] >= 0; node = myParents[ node ] ) ++d;
+  return d;
+}
+
+int
+rt::BVH::height() const
+{
+  // depths of the nodes, which come after their parent.
+  std::vector<int> depths( nodes.size(), 0 );
+  int h = 0;
+  for ( int i = 0; i < (int) nodes.size(); ++i )
+    if ( nodes[ i ].count == 0 )
+      depths[ i + 1 ] = depths[ nodes[ i ].offset ] = depths[ i ] + 1;
+    else
+      h = std::max( h, depths[ i ] );
+  return h;
+}
+
+std::vector<int>
+rt::BVH::ancestors( int node ) const
+{
+  std::vector<int> above;
+  if ( node < 0 ) return above;
+  for ( node = myParents[ node ]; node >= 0; node = myParents[ node ] )
+    above.push_back( node );
+  return above;
+}
+
+void
+rt::BVH::keepAreas()
+{
+  myBuiltAreas.resize( nodes.size() );
+  for ( std::size_t i = 0; i < nodes.size(); ++i )
+    myBuiltAreas[ i ] = nodes[ i ].box.area();
+}
+
+int
+rt::BVH::buildNode( const std::vector<BoundingBox>& boxes,
+                    const std::vector<Point3>& centroids,
+                    int first, int count, int depth, int max_leaf_size )
+{
+  int index = (int) nodes.size();
+  nodes.push_back( BVHNode() );
+  BoundingBox box, centroid_box;
+  for ( int k = first; k < first + count; ++k ) {
+    box.extend( boxes[ indices[ k ] ] );
+    centroid_box.extend( centroids[ indices[ k ] ] );
+  }
+  nodes[ index ].box    = box;
+  nodes[ index ].offset = first;
+  nodes[ index ].count  = count;
+  nodes[ index ].axis   = 0;
+  if ( count <= 1 ) return index;
+
+  // The split axis is the one along which centroids spread the most.
+  Vector3 extent = centroid_box.hi - centroid_box.lo;
+  int axis = 0;
+  if ( extent[ 1 ] > extent[ axis ] ) axis = 1;
+  if ( extent[ 2 ] > extent[ axis ] ) axis = 2;
+  if ( extent[ axis ] <= 0.0f ) {
+    // All centroids coincide: they cannot be separated.
+    return index;
+  }
+
+  int* begin = indices.data() + first;
+  int* end   = begin + count;
+  int* middle;
+  if ( depth >= MEDIAN_SPLIT_DEPTH ) {
+    middle = begin + count / 2;
+    std::nth_element( begin, middle, end, [&] ( int a, int b ) {
+        return centroids[ a ][ axis ] < centroids[ b ][ axis ]; } );
+  } else {
+    // Binned surface area heuristic.
+    Real lo    = centroid_box.lo[ axis ];
+    Real scale = NB_BINS / extent[ axis ];
+    auto binOf = [&] ( int i ) {
+      int b = (int) ( ( centroids[ i ][ axis ] - lo ) * scale );
+      return std::min( b, NB_BINS - 1 );
+    };
+    BoundingBox bin_boxes[ NB_BINS ];
+    int bin_counts[ NB_BINS ] = { 0 };
+    for ( int* it = begin; it != end; ++it ) {
+      int b = binOf( *it );
+      bin_boxes[ b ].extend( boxes[ *it ] );
+      bin_counts[ b ] += 1;
+    }
+    // costs of the NB_BINS-1 possible splits, sweeping from both sides.
+    Real right_area[ NB_BINS ];
+    int right_count[ NB_BINS ];
+    BoundingBox acc;
+    int n = 0;
+    for ( int b = NB_BINS - 1; b > 0; --b ) {
+      acc.extend( bin_boxes[ b ] );
+      n += bin_counts[ b ];
+      right_area[ b ]  = acc.area();
+      right_count[ b ] = n;
+    }
+    acc = BoundingBox();
+    n = 0;
+    Real best_cost = std::numeric_limits<Real>::max();
+    int best_split = -1;
+    for ( int b = 1; b < NB_BINS; ++b ) {
+      acc.extend( bin_boxes[ b - 1 ] );
+      n += bin_counts[ b - 1 ];
+      if ( n == 0 || right_count[ b ] == 0 ) continue;
+      Real cost = acc.area() * n + right_area[ b ] * right_count[ b ];
+      if ( cost < best_cost ) { best_cost = cost; best_split = b; }
+    }
+    // Cost of a leaf vs. cost of a traversal step plus both children.
+    Real leaf_cost  = (Real) count;
+    Real split_cost = 1.0f + best_cost / box.area();
+    if ( best_split < 0 || ( count <= max_leaf_size && leaf_cost <= split_cost ) )
+      return index;
+    middle = std::partition( begin, end, [&] ( int i ) { return binOf( i ) < best_split; } );
+  }
+  int nb_left = (int) ( middle - begin );
+  buildNode( boxes, centroids, first, nb_left, depth + 1, max_leaf_size );
+  int right = buildNode( boxes, centroids, first + nb_left, count - nb_left,
+                         depth + 1, max_leaf_size );
+  nodes[ index ].offset = right;
+  nodes[ index ].count  = 0;
+  nodes[ index ].axis   = axis;
+  return index;
+}
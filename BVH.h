@@ -0,0 +1,286 @@
+/**
+@file BVH.h
+*/
+#pragma once
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <vector>
+#include "BoundingBox.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A node of a flattened bounding volume hierarchy. Nodes are stored
+  /// in depth-first order: the first child of an inner node \a i is
+  /// node \a i+1, its second child is node \a offset.
+  struct BVHNode {
+    /// The bounding box of all primitives below this node.
+    BoundingBox box;
+    /// index of the second child (inner node) or of the first
+    /// primitive in BVH::indices (leaf).
+    int offset;
+    /// number of primitives of a leaf (0 for an inner node).
+    int count;
+    /// axis along which the children of an inner node were split.
+    int axis;
+  };
+
+  /// The stack of the nodes left to visit by a traversal of a BVH. It
+  /// holds SIZE nodes without allocation, enough for the hierarchies
+  /// built by BVH::build, and grows beyond, e.g. for a hierarchy read
+  /// from a file.
+  struct BVHStack {
+    static const int SIZE = 64;
+
+    BVHStack() : top( 0 ) {}
+    bool empty() const { return top == 0; }
+    void push( int i )
+    {
+      if ( top < SIZE ) nodes[ top++ ] = i;
+      else more.push_back( i );
+    }
+    int pop()
+    {
+      if ( more.empty() ) return nodes[ --top ];
+      int i = more.back();
+      more.pop_back();
+      return i;
+    }
+
+  private:
+    int nodes[ SIZE ];
+    int top;
+    /// The nodes beyond the SIZE first ones.
+    std::vector<int> more;
+  };
+
+  /// A bounding volume hierarchy over a set of primitives known by their
+  /// bounding boxes. It is built with the surface area heuristic and
+  /// stored as a flat array of nodes. The primitives themselves are not
+  /// stored: traversals call back a functor with primitive indices.
+  /// When primitives move, are added or removed, the hierarchy is
+  /// updated in place (see update(), insert() and remove()) rather than
+  /// built again.
+  struct BVH {
+    /// The nodes, node 0 is the root.
+    std::vector<BVHNode> nodes;
+    /// The primitive indices, grouped by leaf.
+    std::vector<int> indices;
+
+    /// Builds the hierarchy over the primitives with bounding boxes \a
+    /// boxes. Leaves hold at most \a max_leaf_size primitives, unless
+    /// they cannot be separated.
+    void build( const std::vector<BoundingBox>& boxes, int max_leaf_size = 4 );
+
+    /// Updates the hierarchy once some primitives have moved, \a boxes
+    /// being their new bounding boxes. The boxes of the nodes are refit
+    /// without changing the tree. Then the topmost subtrees whose
+    /// surface area grew by more than \a max_growth since they were
+    /// built are rebuilt, as their traversal has become too costly: a
+    /// primitive moved a little costs a refit, one moved far away a
+    /// rebuild of the smallest subtree spanning both of its positions.
+    /// If these subtrees hold most primitives, the whole tree is built
+    /// again.
+    /// @return the number of subtrees rebuilt (1 for the whole tree).
+    int update( const std::vector<BoundingBox>& boxes, Real max_growth = 2.0f,
+                int max_leaf_size = 4 );
+
+    /// Same as above when only the primitive \a i has moved: only the
+    /// nodes above it are refit and checked. If one of them degraded,
+    /// the primitive is rather moved to the leaf of its new position
+    /// (see insert()), which keeps the other subtrees tight.
+    /// @return 1 if the primitive changed of leaf, 0 otherwise.
+    int update( const std::vector<BoundingBox>& boxes, int i, Real max_growth = 2.0f,
+                int max_leaf_size = 4 );
+
+    /// Adds the primitive boxes.size()-1, \a boxes being the bounding
+    /// boxes of the primitives. It goes into the leaf whose surface area
+    /// grows the least, which is then rebuilt. As in update(), the
+    /// highest ancestor whose surface area grew by more than \a
+    /// max_growth is rebuilt, as is a branch grown too deep, so that
+    /// repeated insertions do not degrade the tree into a chain.
+    void insert( const std::vector<BoundingBox>& boxes, Real max_growth = 2.0f,
+                 int max_leaf_size = 4 );
+
+    /// Removes the primitive \a i, \a boxes being the bounding boxes of
+    /// the remaining primitives: the last primitive (boxes.size()) is
+    /// renamed \a i, as the primitives are kept in a vector. A leaf left
+    /// empty is rebuilt with its sibling.
+    void remove( const std::vector<BoundingBox>& boxes, int i, int max_leaf_size = 4 );
+
+    /// @return 'true' if there is no primitive.
+    bool empty() const { return nodes.empty(); }
+
+    /// Closest-hit traversal. \a intersect( i, t_max ) must test
+    /// primitive \a i against the ray, and if it is hit at distance t <
+    /// t_max, update t_max and return 'true'. Nodes further than the
+    /// current \a t_max are skipped.
+    ///
+    /// @return 'true' if some primitive was hit.
+    template <typename Intersect>
+    bool closestHit( const Ray& ray, Real& t_max, Intersect intersect ) const
+    {
+      if ( nodes.empty() ) return false;
+      Vector3 inv_dir( 1.0f / ray.direction[ 0 ], 1.0f / ray.direction[ 1 ],
+                       1.0f / ray.direction[ 2 ] );
+      BVHStack stack;
+      int i = 0;
+      bool hit = false;
+      for ( ;; ) {
+        const BVHNode& node = nodes[ i ];
+        if ( node.box.rayIntersection( ray.origin, inv_dir, t_max ) ) {
+          if ( node.count == 0 ) {
+            // visit first the child on the side the ray comes from.
+            if ( ray.direction[ node.axis ] < 0.0f ) {
+              stack.push( i + 1 );
+              i = node.offset;
+            } else {
+              stack.push( node.offset );
+              i = i + 1;
+            }
+            continue;
+          }
+          for ( int k = node.offset; k < node.offset + node.count; ++k )
+            if ( intersect( indices[ k ], t_max ) ) hit = true;
+        }
+        if ( stack.empty() ) break;
+        i = stack.pop();
+      }
+      return hit;
+    }
+
+    /// Closest-hit traversal of a coherent packet of rays. Nodes are
+    /// tested against the frustum of the packet and culled when no ray
+    /// may enter them before its current distance in \a hit.
+    /// \a intersect( i ) must test primitive \a i against the rays and
+    /// update \a hit (see GraphicalObject::packetIntersection).
+    template <typename Intersect>
+    void closestHit( const RayPacket& packet, RayPacketHit& hit, Intersect intersect ) const
+    {
+      if ( nodes.empty() ) return;
+      BVHStack stack;
+      int i = 0;
+      for ( ;; ) {
+        const BVHNode& node = nodes[ i ];
+        if ( packet.intersects( node.box, hit.maxDistance() ) ) {
+          if ( node.count == 0 ) {
+            // all the rays come from the same side.
+            if ( ! packet.positive[ node.axis ] ) {
+              stack.push( i + 1 );
+              i = node.offset;
+            } else {
+              stack.push( node.offset );
+              i = i + 1;
+            }
+            continue;
+          }
+          for ( int k = node.offset; k < node.offset + node.count; ++k )
+            intersect( indices[ k ] );
+        }
+        if ( stack.empty() ) break;
+        i = stack.pop();
+      }
+    }
+
+    /// Any-hit traversal. \a occluded( i ) must test primitive \a i
+    /// against the ray and return 'true' if it blocks it before \a t_max.
+    /// The traversal stops at the first such primitive.
+    ///
+    /// @return 'true' if some primitive blocks the ray.
+    template <typename Occluded>
+    bool anyHit( const Ray& ray, Real t_max, Occluded occluded ) const
+    {
+      if ( nodes.empty() ) return false;
+      Vector3 inv_dir( 1.0f / ray.direction[ 0 ], 1.0f / ray.direction[ 1 ],
+                       1.0f / ray.direction[ 2 ] );
+      BVHStack stack;
+      int i = 0;
+      for ( ;; ) {
+        const BVHNode& node = nodes[ i ];
+        if ( node.box.rayIntersection( ray.origin, inv_dir, t_max ) ) {
+          if ( node.count == 0 ) {
+            stack.push( node.offset );
+            i = i + 1;
+            continue;
+          }
+          for ( int k = node.offset; k < node.offset + node.count; ++k )
+            if ( occluded( indices[ k ] ) ) return true;
+        }
+        if ( stack.empty() ) break;
+        i = stack.pop();
+      }
+      return false;
+    }
+
+    /// Maximal depth of the hierarchy (the builder switches to median
+    /// splits before reaching it, and so do insert() and update()), up
+    /// to which the traversals do not allocate.
+    static const int MAX_DEPTH = BVHStack::SIZE;
+
+    /// @return the depth of the deepest leaf (0 for a single leaf).
+    int height() const;
+
+  private:
+    /// The surface area of each node when it was built, see update().
+    std::vector<Real> myBuiltAreas;
+    /// The parent of each node (-1 for the root) and the leaf of each
+    /// primitive, empty when the tree has changed since link().
+    std::vector<int> myParents, myLeaves;
+
+    /// Builds the subtree over indices[ first, first+count [ and returns
+    /// its node index.
+    int buildNode( const std::vector<BoundingBox>& boxes,
+                   const std::vector<Point3>& centroids,
+                   int first, int count, int depth, int max_leaf_size );
+
+    /// Replaces the subtree of \a node, made of the nodes [ node, end [,
+    /// by a new subtree over indices[ first, first+count [.
+    void rebuild( const std::vector<BoundingBox>& boxes, int node, int end,
+                  int first, int count, int depth, int max_leaf_size );
+
+    /// Fits the boxes of the nodes to \a boxes, from the leaves up.
+    void refit( const std::vector<BoundingBox>& boxes );
+
+    /// Fits the box of \a node to its primitives or to its children.
+    void fit( const std::vector<BoundingBox>& boxes, int node );
+
+    /// @return the end of the subtree of \a node, i.e. the node after
+    /// its last one in depth-first order.
+    int subtreeEnd( int node ) const;
+
+    /// Computes the range indices[ first, first+count [ of the
+    /// primitives below \a node.
+    void range( int node, int& first, int& count ) const;
+
+    /// Computes myParents and myLeaves, and myBuiltAreas if they do not
+    /// match the nodes (e.g. they were read from a SceneCache).
+    void link();
+
+    /// @return the depth of \a node, see link().
+    int depth( int node ) const;
+
+    /// @return the ancestors of \a node, from its parent to the root.
+    std::vector<int> ancestors( int node ) const;
+
+    /// Adds the primitive \a p to the leaf whose surface area grows the
+    /// least, which is then rebuilt, then restores the quality of the
+    /// tree above it (see insert()).
+    void place( const std::vector<BoundingBox>& boxes, int p, Real max_growth,
+                int max_leaf_size );
+
+    /// Removes the primitive \a i from its leaf (a leaf left empty is
+    /// rebuilt with its sibling), then renames the primitive \a renamed
+    /// \a i, unless it is -1.
+    void detach( const std::vector<BoundingBox>& boxes, int i, int renamed,
+                 int max_leaf_size );
+
+    /// Stores the current area of the nodes in myBuiltAreas.
+    void keepAreas();
+  };
+
+} // namespace rt
+
+#endif // #define _BVH_H_
@@ -0,0 +1,89 @@
+/**
+@file BoundingBox.h
+*/
+#pragma once
+#ifndef _BOUNDING_BOX_H_
+#define _BOUNDING_BOX_H_
+
+#include <algorithm>
+#include <limits>
+#include "PointVector.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// An axis-aligned bounding box [lo,hi]. A default constructed box
+  /// is empty and grows with extend().
+  struct BoundingBox {
+    /// the lowest corner of the box.
+    Point3 lo;
+    /// the highest corner of the box.
+    Point3 hi;
+
+    /// Default constructor. The box is empty.
+    BoundingBox()
+      : lo( std::numeric_limits<Real>::max(), std::numeric_limits<Real>::max(),
+            std::numeric_limits<Real>::max() ),
+        hi( -std::numeric_limits<Real>::max(), -std::numeric_limits<Real>::max(),
+            -std::numeric_limits<Real>::max() )
+    {}
+
+    /// Constructor from its two corners.
+    BoundingBox( const Point3& low, const Point3& high ) : lo( low ), hi( high ) {}
+
+    /// @return 'true' if the box contains no point.
+    bool empty() const { return lo[ 0 ] > hi[ 0 ]; }
+
+    /// Grows the box so that it contains \a p.
+    void extend( const Point3& p )
+    {
+      for ( int i = 0; i < 3; ++i ) {
+        lo[ i ] = std::min( lo[ i ], p[ i ] );
+        hi[ i ] = std::max( hi[ i ], p[ i ] );
+      }
+    }
+
+    /// Grows the box so that it contains \a other.
+    void extend( const BoundingBox& other )
+    {
+      for ( int i = 0; i < 3; ++i ) {
+        lo[ i ] = std::min( lo[ i ], other.lo[ i ] );
+        hi[ i ] = std::max( hi[ i ], other.hi[ i ] );
+      }
+    }
+
+    /// @return the center of the box.
+    Point3 centroid() const { return 0.5f * ( lo + hi ); }
+
+    /// @return the surface area of the box (0 if empty).
+    Real area() const
+    {
+      if ( empty() ) return 0.0f;
+      Vector3 d = hi - lo;
+      return 2.0f * ( d[ 0 ] * d[ 1 ] + d[ 1 ] * d[ 2 ] + d[ 2 ] * d[ 0 ] );
+    }
+
+    /// Slab test between the box and the ray starting at \a origin with
+    /// inverted direction \a inv_dir.
+    /// @return 'true' if the ray enters the box before \a t_max.
+    bool rayIntersection( const Point3& origin, const Vector3& inv_dir,
+                          Real t_max ) const
+    {
+      Real t0 = 0.0f;
+      Real t1 = t_max;
+      for ( int i = 0; i < 3; ++i ) {
+        Real ta = ( lo[ i ] - origin[ i ] ) * inv_dir[ i ];
+        Real tb = ( hi[ i ] - origin[ i ] ) * inv_dir[ i ];
+        if ( ta > tb ) std::swap( ta, tb );
+        // written so that a NaN (0 * inf) keeps the current interval.
+        t0 = ta > t0 ? ta : t0;
+        t1 = tb < t1 ? tb : t1;
+        if ( t0 > t1 ) return false;
+      }
+      return true;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _BOUNDING_BOX_H_
@@ -26,9 +26,7 @@ namespace rt {
     /// Garantees that color channels are between 0 and 1.
     Color& clamp()
     {
-      my_channels[ 0 ] = std::max( 0.0f, std::min( 1.0f, my_channels[ 0 ] ) );
-      my_channels[ 1 ] = std::max( 0.0f, std::min( 1.0f, my_channels[ 1 ] ) );
-      my_channels[ 2 ] = std::max( 0.0f, std::min( 1.0f, my_channels[ 2 ] ) );
+      my_channels = my_channels.inf( Vector3( 1.0, 1.0, 1.0 ) ).sup( Vector3( 0.0, 0.0, 0.0 ) );
       return *this;
     }
     // Useful for conversion to OpenGL vectors
@@ -47,9 +45,7 @@ namespace rt {
     Color operator*( Real v ) const
     {
       Color tmp( *this );
-      tmp.my_channels[ 0 ] *= v;
-      tmp.my_channels[ 1 ] *= v;
-      tmp.my_channels[ 2 ] *= v;
+      tmp.my_channels *= v;
       return tmp;
     }
 
@@ -57,9 +53,7 @@ namespace rt {
     Color operator*( Color other ) const
     {
       Color tmp( *this );
-      tmp.my_channels[ 0 ] *= other.my_channels[ 0 ];
-      tmp.my_channels[ 1 ] *= other.my_channels[ 1 ];
-      tmp.my_channels[ 2 ] *= other.my_channels[ 2 ];
+      tmp.my_channels = tmp.my_channels.mul( other.my_channels );
       return tmp;
     }
 
@@ -67,26 +61,20 @@ namespace rt {
     Color operator+( Color other ) const
     {
       Color tmp( *this );
-      tmp.my_channels[ 0 ] += other.my_channels[ 0 ];
-      tmp.my_channels[ 1 ] += other.my_channels[ 1 ];
-      tmp.my_channels[ 2 ] += other.my_channels[ 2 ];
+      tmp.my_channels += other.my_channels;
       return tmp;
     }
 
     // Operations between colors
     Color& operator+=( Color other )
     {
-      my_channels[ 0 ] += other.my_channels[ 0 ];
-      my_channels[ 1 ] += other.my_channels[ 1 ];
-      my_channels[ 2 ] += other.my_channels[ 2 ];
+      my_channels += other.my_channels;
       return *this;
     }
 
     Color sup( Color other ) const
     {
-      other[ 0 ] = std::max( (*this)[ 0 ], other[ 0 ] );
-      other[ 1 ] = std::max( (*this)[ 1 ], other[ 1 ] );
-      other[ 2 ] = std::max( (*this)[ 2 ], other[ 2 ] );
+      other.my_channels = other.my_channels.sup( my_channels );
       return other;
     }
     
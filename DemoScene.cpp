@@ -0,0 +1,69 @@
+/**
+@file DemoScene.cpp
+*/
+#include <utility>
+#include "DemoScene.h"
+#include "Sphere.h"
+#include "SphereSet.h"
+#include "Instance.h"
+#include "PeriodicPlane.h"
+#include "PointLight.h"
+#include "WaterPlane.h"
+
+std::shared_ptr<rt::GraphicalObject>
+rt::makeBubble( Real r, Material transp_m )
+{
+    Material revert_m = transp_m;
+    std::swap(revert_m.in_refractive_index, revert_m.out_refractive_index);
+    std::shared_ptr<SphereSet> bubble = std::make_shared<SphereSet>();
+    bubble->add(Point3(0, 0, 0), r, transp_m);
+    bubble->add(Point3(0, 0, 0), r - BUBBLE_THICKNESS, revert_m);
+    return bubble;
+}
+
+void
+rt::addBubble( Scene& scene, const std::shared_ptr<GraphicalObject>& bubble, Point3 c )
+{
+    scene.addObject(new Instance(bubble, Transform::translate(c)));
+}
+
+void
+rt::addBubble( Scene& scene, Point3 c, Real r, Material transp_m )
+{
+    addBubble(scene, makeBubble(r, transp_m), c);
+}
+
+void
+rt::buildDemoScene( Scene& scene, int noise_resolution )
+{
+    // Light at infinity
+    Light *light0 = new PointLight(0, Point4(0, 0, 1, 0),
+                                   Color(1.0, 1.0, 1.0));
+    Light *light1 = new PointLight(1, Point4(-10, -4, 2, 1),
+                                   Color(1.0, 1.0, 1.0));
+    scene.addLight(light0);
+    scene.addLight(light1);
+    // Objects
+    SphereSet *spheres = new SphereSet();
+    spheres->add(Point3(0, 0, 0), 2.0, Material::bronze());
+    spheres->add(Point3(0, 4, 0), 1.0, Material::emerald());
+    spheres->add(Point3(6, 6, 0), 3.0, Material::whitePlastic());
+    scene.addObject(spheres);
+    addBubble(scene, Point3(-5, 4, -1), 2.0, Material::glass());
+
+    // Un sol effet piscine
+    PeriodicPlane* pplane1 = new PeriodicPlane( Point3( 0, 0, -2.5 ), Vector3( 5, 0, 0 ), Vector3( 0, 5, 0 ),
+                                               Material::blueWater(), Material::whitePlastic(), 0.05f );
+    scene.addObject(pplane1);
+
+    // Une mer calme
+    auto * sea = new WaterPlane(Point3( 0, 0, -2 ), Vector3( 5, 0, 0 ), Vector3( 0, 5, 0 ), Material::blueWater());
+    sea->setNoiseVolume(noise_resolution);
+    scene.addObject(sea);
+
+
+//    // Un mur de building "moderne" à gauche.
+//    PeriodicPlane* pplane2 = new PeriodicPlane( Point3( -15, 0, 0 ), Vector3( 0, 2, 0 ), Vector3( 0, 0, 4 ),
+//                                               Material::silver(), Material::black_plastic(), 0.025f );
+//    scene.addObject(pplane2);
+}
@@ -0,0 +1,41 @@
+/**
+@file DemoScene.h
+*/
+#pragma once
+#ifndef _DEMO_SCENE_H_
+#define _DEMO_SCENE_H_
+
+#include <memory>
+#include "Scene.h"
+#include "Material.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// Thickness of the shell of a bubble: its radius must be larger.
+  const Real BUBBLE_THICKNESS = 0.02f;
+
+  /// @return the geometry of a bubble of radius \a r centered at the
+  /// origin, made of two spheres of transparent material \a transp_m
+  /// (\a r - BUBBLE_THICKNESS for the inner one).
+  /// It is shared by the bubbles placed by addBubble.
+  std::shared_ptr<GraphicalObject> makeBubble( Real r, Material transp_m );
+
+  /// Adds to \a scene an instance of \a bubble (see makeBubble) moved
+  /// to \a c.
+  void addBubble( Scene& scene, const std::shared_ptr<GraphicalObject>& bubble, Point3 c );
+
+  /// Adds to \a scene a bubble of center \a c and radius \a r, made of
+  /// two spheres of transparent material \a transp_m. Its geometry is not
+  /// shared: scenes with many bubbles should use makeBubble instead.
+  void addBubble( Scene& scene, Point3 c, Real r, Material transp_m );
+
+  /// Fills \a scene with the lights and objects of the demo scene. It
+  /// is shared by the viewer and the command-line renderer. If \a
+  /// noise_resolution is positive, the sea uses a precomputed noise of
+  /// this resolution instead of the exact Worley noise.
+  void buildDemoScene( Scene& scene, int noise_resolution = 0 );
+
+} // namespace rt
+
+#endif // #define _DEMO_SCENE_H_
@@ -0,0 +1,108 @@
+/**
+@file GBuffer.h
+*/
+#pragma once
+#ifndef _GBUFFER_H_
+#define _GBUFFER_H_
+
+#include <vector>
+#include "RayHit.h"
+#include "Renderer.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// The primary hits of a render, i.e. the intersection (object, point,
+  /// normal, material) of the ray through the center of each pixel, kept
+  /// for the camera, the resolution and the geometry of the scene that
+  /// produced them. As long as only the lights or the materials change,
+  /// a new render shades these hits again (reflections, refractions and
+  /// shadows included) instead of tracing the primary rays.
+  struct GBuffer {
+
+    GBuffer()
+      : myScene( nullptr ), myVersion( 0 ), myMaterialsVersion( 0 ),
+        myWidth( 0 ), myHeight( 0 ), myIsComplete( false ) {}
+
+    /// Prepares the buffer for a render of \a renderer, whose scene must
+    /// be prepared. The hits are kept if they were all computed for the
+    /// same camera, resolution and scene geometry; their materials are
+    /// read again if the materials of the scene were shared again (see
+    /// Scene::updateMaterials). Otherwise the buffer is sized for the
+    /// render and must be filled by set().
+    /// @return 'true' if the hits are kept.
+    bool reset( const Renderer& renderer )
+    {
+      const Scene* scene = renderer.ptrScene;
+      if ( myIsComplete && scene == myScene && scene->myVersion == myVersion
+           && renderer.myWidth == myWidth && renderer.myHeight == myHeight
+           && same( renderer.myOrigin, myOrigin )
+           && same( renderer.myDirUL, myDirUL ) && same( renderer.myDirUR, myDirUR )
+           && same( renderer.myDirLL, myDirLL ) && same( renderer.myDirLR, myDirLR ) )
+        {
+          if ( scene->myMaterialsVersion != myMaterialsVersion ) {
+            for ( std::size_t i = 0; i < myHits.size(); ++i )
+              if ( myFound[ i ] )
+                myHits[ i ].material = &myHits[ i ].object->getMaterial( myHits[ i ].point );
+            myMaterialsVersion = scene->myMaterialsVersion;
+          }
+          return true;
+        }
+      myScene            = scene;
+      myVersion          = scene->myVersion;
+      myMaterialsVersion = scene->myMaterialsVersion;
+      myWidth            = renderer.myWidth;
+      myHeight           = renderer.myHeight;
+      myOrigin           = renderer.myOrigin;
+      myDirUL            = renderer.myDirUL;
+      myDirUR            = renderer.myDirUR;
+      myDirLL            = renderer.myDirLL;
+      myDirLR            = renderer.myDirLR;
+      myIsComplete       = false;
+      myHits.assign( (std::size_t) myWidth * myHeight, RayHit() );
+      myFound.assign( (std::size_t) myWidth * myHeight, 0 );
+      return false;
+    }
+
+    /// Stores the primary hit of pixel (\a x, \a y), \a found being
+    /// 'false' if its ray hits nothing.
+    void set( int x, int y, bool found, const RayHit& hit )
+    {
+      const std::size_t i = (std::size_t) y * myWidth + x;
+      myFound[ i ] = found;
+      myHits[ i ]  = hit;
+    }
+
+    /// @return 'true' if the ray through pixel (\a x, \a y) hits the scene.
+    bool found( int x, int y ) const
+    { return myFound[ (std::size_t) y * myWidth + x ] != 0; }
+
+    /// @return the primary hit of pixel (\a x, \a y), if found.
+    const RayHit& hit( int x, int y ) const
+    { return myHits[ (std::size_t) y * myWidth + x ]; }
+
+    /// Marks the buffer as complete, once every pixel has been set, so
+    /// that the next reset() may keep it.
+    void setComplete() { myIsComplete = true; }
+
+  private:
+    /// The scene, its versions and the camera of the hits.
+    const Scene* myScene;
+    unsigned int myVersion, myMaterialsVersion;
+    int myWidth, myHeight;
+    Point3 myOrigin;
+    Vector3 myDirUL, myDirUR, myDirLL, myDirLR;
+    /// 'true' when all the hits have been computed.
+    bool myIsComplete;
+    /// The hits, row by row, and whether they exist.
+    std::vector< RayHit > myHits;
+    std::vector< unsigned char > myFound;
+
+    /// @return 'true' if \a u and \a v have the same coordinates.
+    static bool same( const Vector3& u, const Vector3& v )
+    { return u[ 0 ] == v[ 0 ] && u[ 1 ] == v[ 1 ] && u[ 2 ] == v[ 2 ]; }
+  };
+
+} // namespace rt
+
+#endif // #define _GBUFFER_H_
@@ -0,0 +1,227 @@
+/**
+@file GLDraw.cpp
+*/
+#include <iostream>
+#include <QGLViewer/manipulatedFrame.h>
+#include "GLDraw.h"
+#include "Sphere.h"
+#include "SphereSet.h"
+#include "PeriodicPlane.h"
+#include "TriangleMesh.h"
+#include "Instance.h"
+#include "PointLight.h"
+
+static void
+drawSphere( rt::Sphere& sphere )
+{
+  using namespace rt;
+  const int NLAT = Sphere::NLAT;
+  const int NLON = Sphere::NLON;
+  Material m = sphere.material;
+  // Taking care of south pole
+  glBegin( GL_TRIANGLE_FAN );
+  glColor4fv( m.ambient );
+  glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
+  glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
+  Point3 south_pole = sphere.localize( -90, 0 );
+  glNormal3fv( sphere.getNormal( south_pole ) );
+  glVertex3fv( south_pole );
+  for ( int x = 0; x <= NLON; ++x )
+    {
+      Point3 p = sphere.localize( -90 + 180/NLAT, x * 360 / NLON );
+      glNormal3fv( sphere.getNormal( p ) );
+      glVertex3fv( p );
+    }
+  glEnd();
+  // Taking care of in-between poles
+  for ( int y = 1; y < NLAT - 1; ++y )
+    {
+      glBegin( GL_QUAD_STRIP);
+      glColor4fv( m.ambient );
+      glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
+      glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
+      glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
+      for ( int x = 0; x <= NLON; ++x )
+        {
+          Point3 p = sphere.localize( -90 + y*180/NLAT,     x * 360 / NLON );
+          Point3 q = sphere.localize( -90 + (y+1)*180/NLAT, x * 360 / NLON );
+          glNormal3fv( sphere.getNormal( p ) );
+          glVertex3fv( p );
+          glNormal3fv( sphere.getNormal( q ) );
+          glVertex3fv( q );
+        }
+      glEnd();
+    }
+  // Taking care of north pole
+  glBegin( GL_TRIANGLE_FAN );
+  glColor4fv( m.ambient );
+  glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
+  glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
+  Point3 north_pole = sphere.localize( 90, 0 );
+  glNormal3fv( sphere.getNormal( north_pole ) );
+  glVertex3fv( north_pole );
+  for ( int x = NLON; x >= 0; --x )
+    {
+      Point3 p = sphere.localize( -90 + (NLAT-1)*180/NLAT, x * 360 / NLON );
+      glNormal3fv( sphere.getNormal( p ) );
+      glVertex3fv( p );
+    }
+  glEnd();
+}
+
+static void drawPeriodicPlane(rt::PeriodicPlane& plane) {
+    using namespace rt;
+    const Point3& c = plane.c;
+    const Material& material_main = plane.material_main;
+    float big = 200.f;
+    Vector3 bigU = plane.u * big;
+    Vector3 bigV = plane.v * big;
+
+    glBegin(GL_QUADS);
+    glColor4fv( material_main.ambient );
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, material_main.diffuse);
+    glMaterialfv(GL_FRONT, GL_SPECULAR, material_main.specular);
+    glMaterialf(GL_FRONT, GL_SHININESS, material_main.shinyness );
+    glVertex3f(bigU[0] + bigV[0] + c[0], bigU[1] + bigV[1] + c[1], bigU[2] + bigV[2] + c[2]);
+    glVertex3f(bigU[0] - bigV[0] + c[0], bigU[1] - bigV[1] + c[1], bigU[2] - bigV[2] + c[2]);
+    glVertex3f(-bigU[0] - bigV[0] + c[0], -bigU[1] - bigV[1] + c[1], -bigU[2] - bigV[2] + c[2]);
+    glVertex3f(-bigU[0] + bigV[0] + c[0], -bigU[1] + bigV[1] + c[1], -bigU[2] + bigV[2] + c[2]);
+
+    glEnd();
+}
+
+static void
+drawTriangleMesh( rt::TriangleMesh& mesh )
+{
+  using namespace rt;
+  const Material& m = mesh.material;
+  glBegin( GL_TRIANGLES );
+  glColor4fv( m.ambient );
+  glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
+  glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
+  for ( const TriangleMesh::Triangle& tri : mesh.triangles )
+    {
+      Vector3 n = ( mesh.vertices[ tri.v[ 1 ] ] - mesh.vertices[ tri.v[ 0 ] ] )
+        .cross( mesh.vertices[ tri.v[ 2 ] ] - mesh.vertices[ tri.v[ 0 ] ] );
+      for ( int j = 0; j < 3; ++j )
+        {
+          glNormal3fv( tri.n[ 0 ] >= 0 ? mesh.normals[ tri.n[ j ] ] : n );
+          glVertex3fv( mesh.vertices[ tri.v[ j ] ] );
+        }
+    }
+  glEnd();
+}
+
+void
+rt::glInit( Viewer& viewer, GraphicalObject* obj )
+{
+  if ( Drawable* d = dynamic_cast<Drawable*>( obj ) ) d->init( viewer );
+}
+
+void
+rt::glDraw( Viewer& viewer, GraphicalObject* obj )
+{
+  if ( Drawable* d = dynamic_cast<Drawable*>( obj ) )
+    d->draw( viewer );
+  else if ( Sphere* sphere = dynamic_cast<Sphere*>( obj ) )
+    drawSphere( *sphere );
+  else if ( SphereSet* spheres = dynamic_cast<SphereSet*>( obj ) )
+    for ( int i = 0; i < spheres->size(); ++i )
+      {
+        Sphere sphere( spheres->center( i ), spheres->radius( i ), spheres->material( i ) );
+        drawSphere( sphere );
+      }
+  else if ( PeriodicPlane* plane = dynamic_cast<PeriodicPlane*>( obj ) )
+    drawPeriodicPlane( *plane );
+  else if ( TriangleMesh* mesh = dynamic_cast<TriangleMesh*>( obj ) )
+    drawTriangleMesh( *mesh );
+  else if ( Instance* instance = dynamic_cast<Instance*>( obj ) )
+    {
+      // OpenGL matrices are stored by columns.
+      const Transform& T = instance->transform();
+      GLfloat m[ 16 ];
+      for ( int j = 0; j < 3; ++j )
+        {
+          for ( int i = 0; i < 3; ++i ) m[ 4 * j + i ] = T.rows[ i ][ j ];
+          m[ 4 * j + 3 ]  = 0.0f;
+          m[ 12 + j ]     = T.translation[ j ];
+        }
+      m[ 15 ] = 1.0f;
+      glPushMatrix();
+      glMultMatrixf( m );
+      glDraw( viewer, instance->geometry().get() );
+      glPopMatrix();
+    }
+}
+
+void
+rt::glInit( Viewer& viewer, Light* light, qglviewer::ManipulatedFrame*& manipulator )
+{
+  if ( Drawable* d = dynamic_cast<Drawable*>( light ) ) {
+    d->init( viewer );
+    return;
+  }
+  PointLight* pl = dynamic_cast<PointLight*>( light );
+  if ( pl == 0 ) return;
+  GLenum number = GL_LIGHT0 + pl->number;
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glEnable( number );
+  glLightfv( number, GL_AMBIENT,  pl->material.ambient );
+  glLightfv( number, GL_DIFFUSE,  pl->material.diffuse );
+  glLightfv( number, GL_SPECULAR, pl->material.specular );
+  std::cout << "Init  light at " << pl->position << std::endl;
+  if ( pl->position[ 3 ] != 0.0 ) // the point light is not at infinity
+    {
+      std::cout << "Init manipulator for light at " << pl->position << std::endl;
+      manipulator = new qglviewer::ManipulatedFrame;
+      viewer.setMouseTracking( true );
+      manipulator->setPosition( pl->position[ 0 ] / pl->position[ 3 ],
+                                pl->position[ 1 ] / pl->position[ 3 ],
+                                pl->position[ 2 ] / pl->position[ 3 ] );
+    }
+}
+
+void
+rt::glLight( Viewer& viewer, Light* light, qglviewer::ManipulatedFrame* manipulator )
+{
+  if ( Drawable* d = dynamic_cast<Drawable*>( light ) ) {
+    d->light( viewer );
+    return;
+  }
+  PointLight* pl = dynamic_cast<PointLight*>( light );
+  if ( pl == 0 ) return;
+  Point4 pos = pl->position;
+  if ( manipulator != 0 )
+    {
+      qglviewer::Vec pos2 = manipulator->position();
+      pos[0] = float(pos2.x);
+      pos[1] = float(pos2.y);
+      pos[2] = float(pos2.z);
+      pos[3] = 1.0f;
+      // Only writes a moved light, which a background render may be
+      // reading otherwise (the viewer stops the render beforehand).
+      if ( pos[0] != pl->position[0] || pos[1] != pl->position[1]
+           || pos[2] != pl->position[2] || pos[3] != pl->position[3] )
+        pl->position = pos;
+    }
+  glLightfv( GL_LIGHT0 + pl->number, GL_POSITION, pos);
+}
+
+void
+rt::glDraw( Viewer& viewer, Light* light, qglviewer::ManipulatedFrame* manipulator )
+{
+  if ( Drawable* d = dynamic_cast<Drawable*>( light ) ) {
+    d->draw( viewer );
+    return;
+  }
+  PointLight* pl = dynamic_cast<PointLight*>( light );
+  if ( pl == 0 ) return;
+  if ( manipulator != 0 && manipulator->grabsMouse() )
+    viewer.drawSomeLight( GL_LIGHT0 + pl->number, 1.2f );
+  else
+    viewer.drawSomeLight( GL_LIGHT0 + pl->number );
+}
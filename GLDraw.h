@@ -0,0 +1,65 @@
+/**
+@file GLDraw.h
+*/
+#pragma once
+#ifndef _GL_DRAW_H_
+#define _GL_DRAW_H_
+
+// In order to call opengl commands
+#include "Viewer.h"
+#include "GraphicalObject.h"
+#include "Light.h"
+
+namespace qglviewer {
+  class ManipulatedFrame;
+}
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// The OpenGL side of graphical objects and lights, which is only
+  /// needed by the Viewer. Objects and lights of the ray-tracing core
+  /// are displayed by the functions below; a custom GraphicalObject or
+  /// Light may also inherit from Drawable to display itself.
+  struct Drawable {
+
+    /// Virtual destructor since object contains virtual methods.
+    virtual ~Drawable() {}
+
+    /// This method is called by Viewer::init() at the beginning of the
+    /// display in the OpenGL window. May be useful for some
+    /// precomputations.
+    virtual void init( Viewer& /* viewer */ ) {}
+
+    /// This method is called by Viewer::draw() at each frame to
+    /// set the lights in the OpenGL window.
+    virtual void light( Viewer& /* viewer */ ) {}
+
+    /// This method is called by Viewer::draw() at each frame to
+    /// redisplay objects in the OpenGL window.
+    virtual void draw( Viewer& /* viewer */ ) = 0;
+  };
+
+  /// Called at the beginning of the display of object \a obj.
+  void glInit( Viewer& viewer, GraphicalObject* obj );
+
+  /// Redisplays the object \a obj in the OpenGL window.
+  void glDraw( Viewer& viewer, GraphicalObject* obj );
+
+  /// Called at the beginning of the display of \a light. A manipulator
+  /// may be created in \a manipulator to move the light in space.
+  void glInit( Viewer& viewer, Light* light,
+               qglviewer::ManipulatedFrame*& manipulator );
+
+  /// Sets the OpenGL light corresponding to \a light, after having
+  /// moved it where \a manipulator is.
+  void glLight( Viewer& viewer, Light* light,
+                qglviewer::ManipulatedFrame* manipulator );
+
+  /// Redisplays the light \a light in the OpenGL window.
+  void glDraw( Viewer& viewer, Light* light,
+               qglviewer::ManipulatedFrame* manipulator );
+
+} // namespace rt
+
+#endif // #define _GL_DRAW_H_
@@ -6,18 +6,27 @@
 #ifndef _GRAPHICAL_OBJECT_H_
 #define _GRAPHICAL_OBJECT_H_
 
-// In order to call opengl commands in all graphical objects
-#include "Viewer.h"
 #include "PointVector.h"
 #include "Material.h"
+#include "MaterialTable.h"
 #include "Ray.h"
+#include "RayHit.h"
+#include "RayPacket.h"
+#include "BoundingBox.h"
 
 /// Namespace RayTracer
 namespace rt {
 
+  /// The types of objects that Scene knows, and whose intersections it
+  /// calls without virtual dispatch. Any other object is Custom.
+  enum class ObjectType : unsigned char {
+    Custom, Sphere, SphereSet, PeriodicPlane, TriangleMesh, Instance
+  };
+
   /// This is an interface specifying methods that any graphical
-  /// object should have. It is also drawable to be seen in QGLViewer
-  /// window.
+  /// object should have. It only deals with geometry and shading, so
+  /// that it does not depend on OpenGL: displaying objects in the
+  /// QGLViewer window is done in GLDraw.h.
   /// Concrete exemples of a GraphicalObject include spheres.
   struct GraphicalObject {
 
@@ -27,30 +36,80 @@ namespace rt {
     /// Virtual destructor since object contains virtual methods.
     virtual ~GraphicalObject() {}
 
-    /// This method is called by Scene::init() at the beginning of the
-    /// display in the OpenGL window. May be useful for some
-    /// precomputations.
-    virtual void init( Viewer& /* viewer */ ) = 0;
-
-    /// This method is called by Scene::draw() at each frame to
-    /// redisplay objects in the OpenGL window.
-    virtual void draw( Viewer& /* viewer */ ) = 0;
-
     /// @return the normal vector at point \a p on the object (\a p
     /// should be on or close to the sphere).
     virtual Vector3 getNormal( Point3 p ) = 0;
 
     /// @return the material associated to this part of the object
-    virtual Material getMaterial( Point3 p ) = 0;
+    virtual const Material& getMaterial( Point3 p ) = 0;
+
+    /// @param[in] ray the incoming ray
+    /// @param[in,out] hit only intersections closer than \a hit.t are
+    /// accepted. If there is one, \a hit is filled with its distance,
+    /// point, normal, material and uv coordinates.
+    ///
+    /// @return 'true' if there is an intersection closer than \a hit.t.
+    virtual bool rayIntersection( const Ray& ray, RayHit& hit ) = 0;
 
+    /// Packet version of rayIntersection: for each ray \a i of \a
+    /// packet, if the object is hit closer than \a hit.t[i], sets \a
+    /// hit.t[i] to the distance and \a hit.object[i] to this object.
+    /// The default implementation calls rayIntersection for each ray,
+    /// objects may override it with SIMD kernels, which must give
+    /// exactly the same distances.
+    virtual void packetIntersection( const RayPacket& packet, RayPacketHit& hit )
+    {
+      for ( int i = 0; i < RayPacket::SIZE; ++i ) {
+        RayHit h;
+        h.t = hit.t[ i ];
+        if ( rayIntersection( packet.rays[ i ], h ) ) {
+          hit.t[ i ]      = h.t;
+          hit.object[ i ] = this;
+        }
+      }
+    }
+
+    /// @return the type of the object, read by Scene::prepare(). A
+    /// type other than Custom means that the intersection methods are
+    /// exactly the ones of that class, which Scene calls directly.
+    virtual ObjectType objectType() const { return ObjectType::Custom; }
+
+    /// Called by Scene::prepare() before prepare(): the object adds its
+    /// materials to the table \a materials of the scene and then refers
+    /// to the shared copies, which stay valid until the next call.
+    /// Objects that do not override it keep their own materials.
+    virtual void internMaterials( MaterialTable& /* materials */ ) {}
+
+    /// Called by Scene::prepare() before rendering, out of any rendering
+    /// thread. May be useful for some precomputations.
+    virtual void prepare() {}
+
+    /// @param[out] box the bounding box of the object.
+    /// @return 'false' if the object is unbounded (e.g. an infinite
+    /// plane), in which case \a box is left unchanged.
+    virtual bool getBoundingBox( BoundingBox& /* box */ ) { return false; }
+
+    /// Any-hit query for shadow rays, which does not need to find the
+    /// closest intersection.
+    ///
     /// @param[in] ray the incoming ray
-    /// @param[out] returns the point of intersection with the object
-    /// (if any), or the closest point to it.
+    /// @param[in] tMax only intersections closer than \a tMax count.
+    /// @param[out] transparent set to 'true' if the ray crosses a
+    /// transparent part of the object before \a tMax (left unchanged
+    /// otherwise).
     ///
-    /// @return either a real < 0.0 if there is an intersection, or a
-    /// kind of distance to the closest point of intersection.
-    virtual Real rayIntersection( const Ray& ray, Point3& p ) = 0;
-                    
+    /// @return 'true' if the ray hits an opaque part of the object
+    /// before \a tMax.
+    virtual bool occluded( const Ray& ray, Real tMax, bool& transparent )
+    {
+      RayHit hit;
+      hit.t = tMax;
+      if ( ! rayIntersection( ray, hit ) ) return false;
+      if ( hit.material->coef_refraction == 0.0f ) return true;
+      transparent = true;
+      return false;
+    }
+
 
   };
 
@@ -0,0 +1,89 @@
+/**
+@file Instance.cpp
+*/
+#include <cmath>
+#include "Instance.h"
+
+rt::Instance::Instance( std::shared_ptr<GraphicalObject> geometry, const Transform& transform )
+  : GraphicalObject(), myGeometry( geometry ),
+    myTransform( transform ), myInverse( transform.inverse() ),
+    myIsRigid( transform.isRigid() )
+{}
+
+void
+rt::Instance::setTransform( const Transform& transform )
+{
+  myTransform = transform;
+  myInverse   = transform.inverse();
+  myIsRigid   = transform.isRigid();
+}
+
+rt::Ray
+rt::Instance::toGeometry( const Ray& ray, Real& scale ) const
+{
+  const Vector3 d = myInverse.vector( ray.direction );
+  if ( ! myIsRigid ) {
+    scale = d.norm();
+    return Ray( myInverse.point( ray.origin ), d, ray.depth ); // normalizes d
+  }
+  // d is already unitary (up to rounding, as the rays of the scene).
+  Ray r;
+  r.origin    = myInverse.point( ray.origin );
+  r.direction = d;
+  r.depth     = ray.depth;
+  scale = 1.0f;
+  return r;
+}
+
+rt::Vector3
+rt::Instance::getNormal( Point3 p )
+{
+  Vector3 n = myInverse.transposedVector( myGeometry->getNormal( myInverse.point( p ) ) );
+  return n.normalized();
+}
+
+const rt::Material&
+rt::Instance::getMaterial( Point3 p )
+{
+  return myGeometry->getMaterial( myInverse.point( p ) );
+}
+
+bool
+rt::Instance::rayIntersection( const Ray& ray, RayHit& hit )
+{
+  Real scale;
+  const Ray r = toGeometry( ray, scale );
+  RayHit h;
+  h.t = hit.t * scale;
+  if ( ! myGeometry->rayIntersection( r, h ) ) return false;
+  hit.t        = h.t / scale;
+  hit.point    = madd( ray.origin, hit.t, ray.direction );
+  // normals are transformed by the inverse transposed matrix.
+  hit.normal   = myInverse.transposedVector( h.normal );
+  if ( ! myIsRigid ) hit.normal = hit.normal.normalized();
+  hit.material = h.material;
+  hit.uv       = h.uv;
+  hit.object   = this;
+  return true;
+}
+
+bool
+rt::Instance::getBoundingBox( BoundingBox& box )
+{
+  BoundingBox b;
+  if ( ! myGeometry->getBoundingBox( b ) ) return false;
+  box = BoundingBox();
+  for ( int i = 0; i < 8; ++i )
+    box.extend( myTransform.point( Point3( ( i & 1 ) ? b.hi[ 0 ] : b.lo[ 0 ],
+                                           ( i & 2 ) ? b.hi[ 1 ] : b.lo[ 1 ],
+                                           ( i & 4 ) ? b.hi[ 2 ] : b.lo[ 2 ] ) ) );
+  return true;
+}
+
+bool
+rt::Instance::occluded( const Ray& ray, Real tMax, bool& transparent )
+{
+  Real scale;
+  const Ray r = toGeometry( ray, scale );
+  return myGeometry->occluded( r, tMax * scale, transparent );
+}
@@ -0,0 +1,85 @@
+/**
+@file Instance.h
+*/
+#pragma once
+#ifndef _INSTANCE_H_
+#define _INSTANCE_H_
+
+#include <memory>
+#include "GraphicalObject.h"
+#include "Transform.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A placement of a geometry shared by several instances (e.g. a
+  /// TriangleMesh or a SphereSet of repeated props), moved by an affine
+  /// transform. The rays are transformed into the space of the
+  /// geometry, whose own acceleration structure is traversed: with the
+  /// hierarchy of the scene over the instances, this forms a two-level
+  /// hierarchy, and the memory grows with the number of geometries, not
+  /// with the number of placements.
+  ///
+  /// The geometry is prepared and shares its materials only once for
+  /// all its instances, by Scene::prepare().
+  struct Instance final : public GraphicalObject {
+
+    /// Virtual destructor since object contains virtual methods.
+    virtual ~Instance() {}
+
+    /// Places \a geometry with the transform \a transform.
+    Instance( std::shared_ptr<GraphicalObject> geometry, const Transform& transform );
+
+    /// @return the geometry placed by this instance.
+    const std::shared_ptr<GraphicalObject>& geometry() const { return myGeometry; }
+
+    /// @return the transform from the space of the geometry to the scene.
+    const Transform& transform() const { return myTransform; }
+
+    /// Moves the instance with the transform \a transform. The scene
+    /// must then update its hierarchy (see Scene::moveObject).
+    void setTransform( const Transform& transform );
+
+    // ---------------- GraphicalObject services ----------------------------
+  public:
+
+    /// @return ObjectType::Instance.
+    ObjectType objectType() const { return ObjectType::Instance; }
+
+    /// @return the normal vector of the geometry at point \a p.
+    Vector3 getNormal( Point3 p );
+
+    /// @return the material of the geometry at point \a p.
+    const Material& getMaterial( Point3 p );
+
+    /// @param[in] ray the incoming ray
+    /// @param[in,out] hit filled if the geometry is hit closer than \a hit.t.
+    ///
+    /// @return 'true' if there is an intersection closer than \a hit.t.
+    bool rayIntersection( const Ray& ray, RayHit& hit );
+
+    /// @param[out] box the bounding box of the transformed geometry.
+    /// @return 'false' if the geometry is unbounded.
+    bool getBoundingBox( BoundingBox& box );
+
+    /// Any-hit query for shadow rays, see GraphicalObject::occluded.
+    bool occluded( const Ray& ray, Real tMax, bool& transparent );
+
+  private:
+    /// The shared geometry.
+    std::shared_ptr<GraphicalObject> myGeometry;
+    /// From the space of the geometry to the scene, and its inverse.
+    Transform myTransform, myInverse;
+    /// 'true' if the transform keeps the lengths, so that the directions
+    /// of the rays stay unitary in the space of the geometry.
+    bool myIsRigid;
+
+    /// @return \a ray in the space of the geometry, with a unit
+    /// direction, and in \a scale the length in this space of a unit
+    /// length of the scene along the ray.
+    Ray toGeometry( const Ray& ray, Real& scale ) const;
+  };
+
+} // namespace rt
+
+#endif // #define _INSTANCE_H_
@@ -6,14 +6,15 @@
 #ifndef _LIGHT_H_
 #define _LIGHT_H_
 
-// In order to call opengl commands in all graphical objects
-#include "Viewer.h"
+#include <limits>
 #include "PointVector.h"
+#include "Color.h"
 
 /// Namespace RayTracer
 namespace rt {
 
-  /// Lights are used to give lights in a scene.
+  /// Lights are used to give lights in a scene. Like GraphicalObject,
+  /// this interface does not depend on OpenGL (see GLDraw.h).
   struct Light {
 
     /// Default constructor. Nothing to do.
@@ -22,18 +23,6 @@ namespace rt {
     /// Virtual destructor since object contains virtual methods.
     virtual ~Light() {}
     
-    /// This method is called by Scene::init() at the beginning of the
-    /// display in the OpenGL window.
-    virtual void init( Viewer& /* viewer */ ) = 0;
-
-    /// This method is called by Scene::light() at each frame to
-    /// set the lights in the OpenGL window.
-    virtual void light( Viewer& /* viewer */ ) = 0;
-
-    /// This method is called by Scene::draw() at each frame to
-    /// redisplay objects in the OpenGL window.
-    virtual void draw( Viewer& /* viewer */) = 0;
-
     /// Given the point \a p, returns the normalized direction to this
     /// light.
     virtual Vector3 direction( const Vector3& /* p */ ) const = 0;
@@ -42,6 +31,13 @@ namespace rt {
     /// p.
     virtual Color color( const Vector3& /* p */ ) const = 0;
 
+    /// @return the distance from the point \a p to this light (infinite
+    /// by default, i.e. for lights at infinity).
+    virtual Real distance( const Vector3& /* p */ ) const
+    {
+      return std::numeric_limits<Real>::infinity();
+    }
+
   };
 
 } // namespace rt
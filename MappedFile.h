@@ -0,0 +1,80 @@
+/**
+@file MappedFile.h
+*/
+#pragma once
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#if defined( _WIN32 )
+#include <fstream>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A read-only file mapped in memory, or read at once where mmap is
+  /// not available. The pages are loaded on demand by the system, and
+  /// shared by the processes that map the same file.
+  struct MappedFile {
+    /// The content of the file, or 0 if it could not be read.
+    const char* data;
+    /// The size of the file, in bytes.
+    std::size_t size;
+
+    /// Maps the file \a file_name (data is 0 in case of error).
+    explicit MappedFile( const std::string& file_name ) : data( nullptr ), size( 0 )
+    {
+#if defined( _WIN32 )
+      std::ifstream input( file_name.c_str(), std::ifstream::binary );
+      if ( ! input.good() ) return;
+      input.seekg( 0, std::ifstream::end );
+      myBuffer.resize( (std::size_t) input.tellg() );
+      input.seekg( 0, std::ifstream::beg );
+      input.read( myBuffer.data(), myBuffer.size() );
+      if ( ! input.good() || myBuffer.empty() ) return;
+      data = myBuffer.data();
+      size = myBuffer.size();
+#else
+      int fd = open( file_name.c_str(), O_RDONLY );
+      if ( fd < 0 ) return;
+      struct stat st;
+      if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+        void* p = mmap( nullptr, (std::size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( p != MAP_FAILED ) {
+          data = static_cast<const char*>( p );
+          size = (std::size_t) st.st_size;
+        }
+      }
+      close( fd );
+#endif
+    }
+
+    /// Unmaps the file.
+    ~MappedFile()
+    {
+#if ! defined( _WIN32 )
+      if ( data != nullptr ) munmap( const_cast<char*>( data ), size );
+#endif
+    }
+
+  private:
+#if defined( _WIN32 )
+    std::vector<char> myBuffer;
+#endif
+    /// Copy constructor is forbidden.
+    MappedFile( const MappedFile& ) = delete;
+    /// Assigment is forbidden.
+    MappedFile& operator=( const MappedFile& ) = delete;
+  };
+
+} // namespace rt
+
+#endif // #define _MAPPED_FILE_H_
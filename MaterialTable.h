@@ -0,0 +1,93 @@
+/**
+@file MaterialTable.h
+*/
+#pragma once
+#ifndef _MATERIAL_TABLE_H_
+#define _MATERIAL_TABLE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <tuple>
+#include "Material.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// Index of a material in a MaterialTable.
+  typedef std::uint16_t MaterialID;
+
+  /// The materials of a scene, stored once and designated by a compact
+  /// MaterialID. Equal materials are stored only once, so that objects
+  /// of the same material share it, and the materials mixed by
+  /// patterns are computed once (see mix()).
+  ///
+  /// The table is filled out of any rendering thread (see
+  /// Scene::prepare). The materials never move in memory, so objects
+  /// may keep references to them, which rendering threads read.
+  struct MaterialTable {
+
+    /// Removes all the materials: their references become invalid.
+    void clear()
+    {
+      myMaterials.clear();
+      myMixes.clear();
+    }
+
+    /// @return the number of materials.
+    std::size_t size() const { return myMaterials.size(); }
+
+    /// Adds the material \a m, unless the table already has an equal
+    /// material (scenes have few materials, they are compared one by one).
+    /// @return the index of the material.
+    MaterialID add( const Material& m )
+    {
+      for ( std::size_t i = 0; i < myMaterials.size(); ++i )
+        if ( equal( myMaterials[ i ], m ) ) return (MaterialID) i;
+      assert( myMaterials.size() < 0xffff );
+      myMaterials.push_back( m );
+      return (MaterialID) ( myMaterials.size() - 1 );
+    }
+
+    /// @return the material of index \a id.
+    const Material& operator[]( MaterialID id ) const { return myMaterials[ id ]; }
+
+    /// @return the index of Material::mix( t, [id1], [id2] ), which is
+    /// computed only the first time.
+    MaterialID mix( Real t, MaterialID id1, MaterialID id2 )
+    {
+      std::tuple<Real, MaterialID, MaterialID> key( t, id1, id2 );
+      auto it = myMixes.find( key );
+      if ( it != myMixes.end() ) return it->second;
+      MaterialID id = add( Material::mix( t, myMaterials[ id1 ], myMaterials[ id2 ] ) );
+      myMixes[ key ] = id;
+      return id;
+    }
+
+  private:
+    /// The materials (a deque does not move its elements when growing).
+    std::deque<Material> myMaterials;
+    /// The mixed materials already computed.
+    std::map< std::tuple<Real, MaterialID, MaterialID>, MaterialID > myMixes;
+
+    static bool equal( const Color& c1, const Color& c2 )
+    {
+      return c1.r() == c2.r() && c1.g() == c2.g() && c1.b() == c2.b();
+    }
+
+    static bool equal( const Material& m1, const Material& m2 )
+    {
+      return equal( m1.ambient, m2.ambient ) && equal( m1.diffuse, m2.diffuse )
+        && equal( m1.specular, m2.specular ) && m1.shinyness == m2.shinyness
+        && m1.coef_diffusion == m2.coef_diffusion
+        && m1.coef_reflexion == m2.coef_reflexion
+        && m1.coef_refraction == m2.coef_refraction
+        && m1.in_refractive_index == m2.in_refractive_index
+        && m1.out_refractive_index == m2.out_refractive_index;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _MATERIAL_TABLE_H_
@@ -0,0 +1,71 @@
+/**
+@file NoiseVolume.cpp
+*/
+#include <cmath>
+#include <utility>
+#include "NoiseVolume.h"
+#include "TileScheduler.h"
+#include "worley.h"
+
+void
+rt::NoiseVolume::build( int resolution, int period, int nb_threads )
+{
+  myResolution = std::max( 2, resolution );
+  myPeriod     = std::max( 1, period );
+  myScale      = (Real) ( myResolution * worley_detail::DENSITY_ADJUSTMENT / myPeriod );
+  std::size_t n = (std::size_t) myResolution * myResolution * myResolution;
+  myValues.assign( n, 0.0f );
+  // The volume is seen as an image of resolution x resolution^2 pixels,
+  // whose rows are computed by batches of samples.
+  TileScheduler scheduler( nb_threads );
+  std::vector<Tile> tiles = TileScheduler::split( myResolution, myResolution * myResolution, 64 );
+  Real step = 1.0f / myScale;
+  scheduler.run( tiles, [&] ( const Tile& tile ) {
+      int width = tile.x1 - tile.x0;
+      std::vector<float> xs( width ), ys( width ), zs( width );
+      for ( int row = tile.y0; row < tile.y1; ++row ) {
+        int j = row % myResolution;
+        int k = row / myResolution;
+        for ( int i = 0; i < width; ++i ) {
+          xs[ i ] = step * (Real) ( tile.x0 + i );
+          ys[ i ] = step * (Real) j;
+          zs[ i ] = step * (Real) k;
+        }
+        WorleyBatch( xs.data(), ys.data(), zs.data(),
+                     myValues.data() + (std::size_t) row * myResolution + tile.x0,
+                     width, myPeriod );
+      }
+    }, [] ( int, int ) {} );
+}
+
+void
+rt::NoiseVolume::assign( int resolution, int period, std::vector<float> values )
+{
+  myResolution = resolution;
+  myPeriod     = period;
+  myScale      = (Real) ( myResolution * worley_detail::DENSITY_ADJUSTMENT / myPeriod );
+  myValues     = std::move( values );
+}
+
+rt::Real
+rt::NoiseVolume::value( const Point3& p ) const
+{
+  int   c[ 2 ][ 3 ];
+  Real  f[ 3 ];
+  for ( int a = 0; a < 3; ++a ) {
+    Real u  = p[ a ] * myScale;
+    Real fl = std::floor( u );
+    f[ a ]  = u - fl;
+    int i   = (int) fl % myResolution;
+    if ( i < 0 ) i += myResolution;
+    c[ 0 ][ a ] = i;
+    c[ 1 ][ a ] = i + 1 < myResolution ? i + 1 : 0;
+  }
+  Real v00 = at( c[0][0], c[0][1], c[0][2] ) * ( 1.0f - f[0] ) + at( c[1][0], c[0][1], c[0][2] ) * f[0];
+  Real v10 = at( c[0][0], c[1][1], c[0][2] ) * ( 1.0f - f[0] ) + at( c[1][0], c[1][1], c[0][2] ) * f[0];
+  Real v01 = at( c[0][0], c[0][1], c[1][2] ) * ( 1.0f - f[0] ) + at( c[1][0], c[0][1], c[1][2] ) * f[0];
+  Real v11 = at( c[0][0], c[1][1], c[1][2] ) * ( 1.0f - f[0] ) + at( c[1][0], c[1][1], c[1][2] ) * f[0];
+  Real v0  = v00 * ( 1.0f - f[1] ) + v10 * f[1];
+  Real v1  = v01 * ( 1.0f - f[1] ) + v11 * f[1];
+  return v0 * ( 1.0f - f[2] ) + v1 * f[2];
+}
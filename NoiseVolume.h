@@ -0,0 +1,73 @@
+/**
+@file NoiseVolume.h
+*/
+#pragma once
+#ifndef _NOISE_VOLUME_H_
+#define _NOISE_VOLUME_H_
+
+#include <vector>
+#include "PointVector.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A periodic 3D texture of Worley noise F_1. It is precomputed once
+  /// on a regular grid of resolution^3 samples covering one period, and
+  /// then sampled with trilinear interpolation. It is much cheaper than
+  /// Worley() when the noise is used at a fixed frequency, but smoothes
+  /// the creases of the cellular pattern and repeats itself every
+  /// period.
+  struct NoiseVolume {
+
+    /// Creates an empty volume, see build().
+    NoiseVolume() : myResolution( 0 ), myPeriod( 0 ), myScale( 0.0f ) {}
+
+    /// Computes the samples, with \a nb_threads threads (0 means one per
+    /// core). The volume has \a resolution samples along each axis and
+    /// repeats every \a period cubes of the Worley noise, i.e. every
+    /// period / 0.39815 units. The memory used is 4 * resolution^3 bytes.
+    void build( int resolution, int period = 8, int nb_threads = 0 );
+
+    /// @return 'true' if the volume was not built.
+    bool empty() const { return myValues.empty(); }
+
+    /// Sets the samples \a values computed by build() with the same
+    /// \a resolution and \a period (e.g. read from a SceneCache).
+    void assign( int resolution, int period, std::vector<float> values );
+
+    /// @return the resolution along each axis.
+    int resolution() const { return myResolution; }
+
+    /// @return the period, in cubes of the Worley noise.
+    int period() const { return myPeriod; }
+
+    /// @return the samples, x varying first.
+    const std::vector<float>& samples() const { return myValues; }
+
+    /// @return the memory used by the samples, in bytes.
+    std::size_t memory() const { return myValues.size() * sizeof( float ); }
+
+    /// @return the noise at point \a p, which approximates Worley(p)
+    /// computed with the same period.
+    Real value( const Point3& p ) const;
+
+  private:
+    /// Number of samples along each axis.
+    int myResolution;
+    /// Period of the noise, in cubes of the Worley noise.
+    int myPeriod;
+    /// Number of samples per unit of length.
+    Real myScale;
+    /// The samples, x varying first.
+    std::vector<float> myValues;
+
+    /// @return the sample (i,j,k), which must be in [0,resolution[.
+    float at( int i, int j, int k ) const
+    {
+      return myValues[ ( (std::size_t) k * myResolution + j ) * myResolution + i ];
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _NOISE_VOLUME_H_
@@ -1,47 +1,48 @@
 #include <cmath>
 
 #include "PeriodicPlane.h"
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+#include <emmintrin.h>
+#endif
 
 rt::PeriodicPlane::PeriodicPlane(rt::Point3 _c, rt::Vector3 _u, rt::Vector3 _v, rt::Material _main_m, rt::Material _band_m,
                                  rt::Real w) : c(_c), u(_u), v(_v), band_width(w),
-                                               material_band(_band_m), material_main(_main_m){}
+                                               material_band(_band_m), material_main(_main_m),
+                                               band_blending(0.f), ptrBand(nullptr), ptrMain(nullptr){}
 
 void rt::PeriodicPlane::coordinates(rt::Point3 p, rt::Real& x, rt::Real& y) {
-    auto uNormalized = u / u.norm();
-    auto vNormalized = v / v.norm();
+    auto uNormalized = u.normalized();
+    auto vNormalized = v.normalized();
     x = uNormalized.dot(p);
     y = vNormalized.dot(p);
 }
 
-void rt::PeriodicPlane::draw(rt::Viewer& /* viewer */) {
-    float big = 200.f;
-    Vector3 bigU = u * big;
-    Vector3 bigV = v * big;
-
-    glBegin(GL_QUADS);
-    glColor4fv( material_main.ambient );
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, material_main.diffuse);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, material_main.specular);
-    glMaterialf(GL_FRONT, GL_SHININESS, material_main.shinyness );
-    glVertex3f(bigU[0] + bigV[0] + c[0], bigU[1] + bigV[1] + c[1], bigU[2] + bigV[2] + c[2]);
-    glVertex3f(bigU[0] - bigV[0] + c[0], bigU[1] - bigV[1] + c[1], bigU[2] - bigV[2] + c[2]);
-    glVertex3f(-bigU[0] - bigV[0] + c[0], -bigU[1] - bigV[1] + c[1], -bigU[2] - bigV[2] + c[2]);
-    glVertex3f(-bigU[0] + bigV[0] + c[0], -bigU[1] + bigV[1] + c[1], -bigU[2] + bigV[2] + c[2]);
-
-    glEnd();
-}
-
 rt::Vector3 rt::PeriodicPlane::getNormal(rt::Point3 /* p */) {
-    auto n = u.cross(v);
-    return n / n.norm();
+    return u.cross(v).normalized();
 }
 
-rt::Material rt::PeriodicPlane::getMaterial(rt::Point3 p) {
+const rt::Material& rt::PeriodicPlane::getMaterial(rt::Point3 p) {
     Real x, y;
     this->coordinates(p, x, y);
+    return materialAt(x, y);
+}
 
+void rt::PeriodicPlane::internMaterials(rt::MaterialTable& materials) {
+    MaterialID band = materials.add(material_band);
+    MaterialID main = materials.add(material_main);
+    ptrBand = &materials[band];
+    ptrMain = &materials[main];
+    // the mixes are computed once, whatever the number of planes using them
+    myBlend.clear();
+    if (band_blending > 0.f)
+        for (int k = 0; k < NB_BLEND_LEVELS; ++k)
+            myBlend.push_back(&materials[materials.mix((k + 0.5f) / NB_BLEND_LEVELS, band, main)]);
+}
+
+const rt::Material& rt::PeriodicPlane::materialAt(rt::Real x, rt::Real y) {
     // on récupère les entiers les plus proches et on fais la différence
     int closest_x = static_cast<int>(round(x));
     float d_x = std::fabs(closest_x - x);
@@ -50,29 +51,95 @@ rt::Material rt::PeriodicPlane::getMaterial(rt::Point3 p) {
 
     // si le point est proche de la grille de valeur entière on renvoie le matériaux correspondant
     if(d_x < band_width || d_y < band_width)
-        return material_band;
-    return material_main;
+        return bandMaterial();
+    // fondu entre les deux matériaux au bord de la bande
+    Real d = std::min(d_x, d_y) - band_width;
+    if(!myBlend.empty() && d < band_blending)
+        return *myBlend[std::min(static_cast<int>(d / band_blending * NB_BLEND_LEVELS), NB_BLEND_LEVELS - 1)];
+    return mainMaterial();
 }
 
-rt::Real rt::PeriodicPlane::rayIntersection(const rt::Ray& ray, rt::Point3& p) {
+rt::Real rt::PeriodicPlane::intersectionDistance(const rt::Ray& ray) {
     float epsilon = std::numeric_limits<float>::epsilon();
-    Vector3 n = getNormal(Point3());
+    Vector3 n = PeriodicPlane::getNormal(Point3());
     Real c = n.dot(ray.direction);
     Real d = (this->c - ray.origin).dot(n);
 
     if(fabs(c) <= epsilon){
-        if(fabs(d) <= epsilon){
-            p = ray.origin;
-            return -1.0f;
-        }
-        return 1.f;  // no intersection
+        if(fabs(d) <= epsilon)
+            return 0.f;  // the ray lies in the plane
+        return -1.f;  // no intersection
     }
 
     Real gamma = d / c;
 
     if(gamma <= epsilon)
-        return 1.f; // no intersection, the ray is pointing the other way
+        return -1.f; // no intersection, the ray is pointing the other way
+    return gamma;
+}
+
+bool rt::PeriodicPlane::rayIntersection(const rt::Ray& ray, rt::RayHit& hit) {
+    Real gamma = intersectionDistance(ray);
+    if(gamma < 0.f || gamma >= hit.t)
+        return false;
 
-    p = ray.origin + gamma * ray.direction;
-    return -1.f;
+    Real x, y;
+    hit.t = gamma;
+    hit.point = madd(ray.origin, gamma, ray.direction);
+    hit.normal = getNormal(hit.point);
+    this->coordinates(hit.point, x, y);
+    hit.material = &materialAt(x, y);
+    hit.uv = Vector2(x, y);
+    hit.object = this;
+    return true;
+}
+
+void rt::PeriodicPlane::packetIntersection(const rt::RayPacket& packet, rt::RayPacketHit& hit) {
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+    // Same computations as intersectionDistance, in the same order.
+    const __m128 epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    Vector3 n = PeriodicPlane::getNormal(Point3());
+    __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n[0]), _mm_load_ps(packet.dx)),
+                                     _mm_mul_ps(_mm_set1_ps(n[1]), _mm_load_ps(packet.dy))),
+                          _mm_mul_ps(_mm_set1_ps(n[2]), _mm_load_ps(packet.dz)));
+    __m128 ocx = _mm_sub_ps(_mm_set1_ps(this->c[0]), _mm_load_ps(packet.ox));
+    __m128 ocy = _mm_sub_ps(_mm_set1_ps(this->c[1]), _mm_load_ps(packet.oy));
+    __m128 ocz = _mm_sub_ps(_mm_set1_ps(this->c[2]), _mm_load_ps(packet.oz));
+    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, _mm_set1_ps(n[0])),
+                                     _mm_mul_ps(ocy, _mm_set1_ps(n[1]))),
+                          _mm_mul_ps(ocz, _mm_set1_ps(n[2])));
+    __m128 parallel = _mm_cmple_ps(_mm_and_ps(c, abs_mask), epsilon);
+    __m128 in_plane = _mm_cmple_ps(_mm_and_ps(d, abs_mask), epsilon);
+    __m128 gamma = _mm_div_ps(d, c);
+    // -1 where there is no intersection, 0 for the rays lying in the plane.
+    gamma = _mm_or_ps(_mm_andnot_ps(_mm_cmple_ps(gamma, epsilon), gamma),
+                      _mm_and_ps(_mm_cmple_ps(gamma, epsilon), _mm_set1_ps(-1.f)));
+    __m128 in_plane_gamma = _mm_andnot_ps(in_plane, _mm_set1_ps(-1.f));
+    gamma = _mm_or_ps(_mm_andnot_ps(parallel, gamma), _mm_and_ps(parallel, in_plane_gamma));
+    __m128 t = _mm_load_ps(hit.t);
+    __m128 mask = _mm_and_ps(_mm_cmpnlt_ps(gamma, _mm_setzero_ps()), _mm_cmpnge_ps(gamma, t));
+    int bits = _mm_movemask_ps(mask);
+    if (bits == 0)
+        return;
+    _mm_store_ps(hit.t, _mm_or_ps(_mm_and_ps(mask, gamma), _mm_andnot_ps(mask, t)));
+    for (int i = 0; i < RayPacket::SIZE; ++i)
+        if (bits & (1 << i))
+            hit.object[i] = this;
+#else
+    GraphicalObject::packetIntersection(packet, hit);
+#endif
+}
+
+bool rt::PeriodicPlane::occluded(const rt::Ray& ray, rt::Real tMax, bool& transparent) {
+    Real gamma = intersectionDistance(ray);
+    if(gamma < 0.f || gamma >= tMax)
+        return false;
+
+    Real x, y;
+    this->coordinates(madd(ray.origin, gamma, ray.direction), x, y);
+    if(materialAt(x, y).coef_refraction == 0.f)
+        return true;
+    transparent = true;
+    return false;
 }
@@ -3,6 +3,7 @@
 #define TP2_PERIODICPLANE_H
 
 /// Namespace RayTracer
+#include <vector>
 #include "GraphicalObject.h"
 
 namespace rt {
@@ -20,6 +21,13 @@ namespace rt {
         Material material_band;
         Material material_main;
 
+        /// Width, beyond band_width, where material_band fades into
+        /// material_main (0 for sharp band edges). The fading uses
+        /// NB_BLEND_LEVELS mixes of both materials, computed once in the
+        /// material table of the scene (see internMaterials).
+        Real band_blending;
+        static const int NB_BLEND_LEVELS = 8;
+
         /// Creates a periodic infinite plane passing through \a c and
         /// tangent to \a u and \a v. Then \a w defines the width of the
         /// band around (0,0) and its period to put material \a band_m,
@@ -32,30 +40,55 @@ namespace rt {
 
         // ---------------- GraphicalObject services ----------------------------
 
-        /// This method is called by Scene::init() at the beginning of the
-        /// display in the OpenGL window. May be useful for some
-        /// precomputations.
-        void init(Viewer& /* viewer */ ) override {}
-
-        /// This method is called by Scene::draw() at each frame to
-        /// redisplay objects in the OpenGL window.
-        void draw(Viewer& viewer) override;
-
+        /// @return ObjectType::PeriodicPlane. A subclass that changes the
+        /// intersection methods must return ObjectType::Custom.
+        ObjectType objectType() const override { return ObjectType::PeriodicPlane; }
 
         /// @return the normal vector at point \a p on the sphere (\a p
         /// should be on or close to the sphere).
         Vector3 getNormal(Point3 p) override;
 
         /// @return the material associated to this part of the object
-        Material getMaterial(Point3 p) override;
+        const Material& getMaterial(Point3 p) override;
+
+        /// Shares its materials and their mixes through the table \a materials.
+        void internMaterials(MaterialTable& materials) override;
+
+        /// @return the material at the point of coordinates \a x and \a y
+        /// (see coordinates).
+        virtual const Material& materialAt(Real x, Real y);
 
         /// @param[in] ray the incoming ray
-        /// @param[out] returns the point of intersection with the object
-        /// (if any), or the closest point to it.
+        /// @param[in,out] hit filled if the plane is hit closer than \a hit.t.
         ///
-        /// @return either a real < 0.0 if there is an intersection, or a
-        /// kind of distance to the closest point of intersection.
-        Real rayIntersection(const Ray& ray, Point3& p) override;
+        /// @return 'true' if there is an intersection closer than \a hit.t.
+        bool rayIntersection(const Ray& ray, RayHit& hit) override;
+
+        /// SSE version of rayIntersection for a packet of rays, see
+        /// GraphicalObject::packetIntersection.
+        void packetIntersection(const RayPacket& packet, RayPacketHit& hit) override;
+
+        /// Any-hit query for shadow rays, see GraphicalObject::occluded.
+        bool occluded(const Ray& ray, Real tMax, bool& transparent) override;
+
+    protected:
+        /// @return the materials used for rendering, i.e. their copies in
+        /// the table of the scene once shared.
+        const Material& bandMaterial() const { return ptrBand != nullptr ? *ptrBand : material_band; }
+        const Material& mainMaterial() const { return ptrMain != nullptr ? *ptrMain : material_main; }
+
+    private:
+        /// The copies of material_band and material_main in the table of
+        /// the scene, or 0 before internMaterials.
+        const Material* ptrBand;
+        const Material* ptrMain;
+        /// The mixes from material_band to material_main, empty without
+        /// band_blending or before internMaterials.
+        std::vector<const Material*> myBlend;
+
+        /// @return the distance along \a ray to the plane, or a negative
+        /// value if the ray does not hit it.
+        Real intersectionDistance(const Ray& ray);
     };
 }
 
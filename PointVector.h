@@ -9,6 +9,7 @@
 #include <cassert>
 #include <cmath>
 #include <array>
+#include <iostream>
 
 /// Namespace RayTracer
 namespace rt {
@@ -139,10 +140,42 @@ namespace rt {
       return result;
     }
 
+    /// component-wise product.
+    Self mul( const Self& other ) const
+    {
+      Self result;
+      for ( Size i = 0; i < N; ++i ) result[ i ] = (*this)[ i ] * other[ i ];
+      return result;
+    }
+    /// component-wise minimum.
+    Self inf( const Self& other ) const
+    {
+      Self result;
+      for ( Size i = 0; i < N; ++i )
+        result[ i ] = (*this)[ i ] < other[ i ] ? (*this)[ i ] : other[ i ];
+      return result;
+    }
+    /// component-wise maximum.
+    Self sup( const Self& other ) const
+    {
+      Self result;
+      for ( Size i = 0; i < N; ++i )
+        result[ i ] = (*this)[ i ] > other[ i ] ? (*this)[ i ] : other[ i ];
+      return result;
+    }
+
     T norm() const
     {
       return sqrt( dot( *this ) );
     }
+    /// @return the vector divided by its norm, without temporary.
+    Self normalized() const
+    {
+      Self result;
+      T n = norm();
+      for ( Size i = 0; i < N; ++i ) result[ i ] = (*this)[ i ] / n;
+      return result;
+    }
   };
 
   ///////////////////////////////////////////////////////////////////////////////
@@ -206,6 +239,30 @@ namespace rt {
   {
     return sqrt( distance2( p1, p2 ) );
   } 
+
+  /// Linear interpolation: @return (1-t) * p1 + t * p2.
+  template <typename T, std::size_t N>
+  inline
+  PointVector<T,N> lerp( const PointVector<T,N>& p1, const PointVector<T,N>& p2, T t )
+  {
+    return ( 1 - t ) * p1 + t * p2;
+  }
+
+  /// Multiply-add: @return p + s * v, e.g. the point at distance s on a ray.
+  template <typename T, std::size_t N>
+  inline
+  PointVector<T,N> madd( const PointVector<T,N>& p, T s, const PointVector<T,N>& v )
+  {
+    return p + s * v;
+  }
+} // namespace rt
+
+// Vectorized 3d and 4d vectors of floats.
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+#include "PointVectorSIMD.h"
+#endif
+
+namespace rt {
   ///////////////////////////////////////////////////////////////////////////////
   // Used types
   ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,285 @@
+/**
+@file PointVectorSIMD.h
+
+SSE specializations of PointVector<float,3> and PointVector<float,4>. It
+is included by PointVector.h when the compiler targets SSE2 (always the
+case on x86-64), unless RT_NO_SIMD is defined.
+*/
+#pragma once
+#ifndef _POINT_VECTOR_SIMD_H_
+#define _POINT_VECTOR_SIMD_H_
+
+#include <stdexcept>
+#include <type_traits>
+#include <emmintrin.h>
+#ifdef __FMA__
+#include <immintrin.h>
+#endif
+
+/// Namespace RayTracer
+namespace rt {
+
+  /**
+  Common part of PointVector<float,3> and PointVector<float,4>. The
+  coordinates are stored in an aligned float[4], i.e. in one SSE
+  register. For N = 3, the last float is padding: it is kept at zero and
+  ignored by dot() and norm().
+
+  The interface is the one of the generic PointVector (including its
+  std::array part), and every operation rounds exactly as the scalar
+  loops do, except madd() when the compiler targets FMA.
+  */
+  template <std::size_t N>
+  struct PackedPointVector {
+    typedef PointVector<float, N> Self;
+    typedef float                 T;
+    typedef std::size_t           Size;
+    typedef float                 value_type;
+    typedef std::size_t           size_type;
+    typedef float&                reference;
+    typedef const float&          const_reference;
+    typedef float*                iterator;
+    typedef const float*          const_iterator;
+
+    PackedPointVector() { store( _mm_setzero_ps() ); }
+
+    PackedPointVector( std::initializer_list<T> L )
+    {
+      store( _mm_setzero_ps() );
+      Size i = 0;
+      for ( auto v : L ) if ( i < N ) (*this)[ i++ ] = v;
+    }
+    PackedPointVector( T val0 )
+    {
+      store( _mm_setr_ps( val0, 0.0f, 0.0f, 0.0f ) );
+    }
+    PackedPointVector( T val0, T val1 )
+    {
+      store( _mm_setr_ps( val0, val1, 0.0f, 0.0f ) );
+    }
+    PackedPointVector( T val0, T val1, T val2 )
+    {
+      store( _mm_setr_ps( val0, val1, val2, 0.0f ) );
+    }
+    PackedPointVector( T val0, T val1, T val2, T val3 )
+    {
+      assert( 3 < N );
+      store( _mm_setr_ps( val0, val1, val2, val3 ) );
+    }
+    PackedPointVector( const T* vals )
+    {
+      store( _mm_setr_ps( vals[ 0 ], vals[ 1 ], vals[ 2 ], N > 3 ? vals[ 3 ] : 0.0f ) );
+    }
+    /// Builds the vector from the lanes of \a x.
+    explicit PackedPointVector( __m128 x ) { store( x ); }
+
+    /// @return the coordinates as an SSE register.
+    __m128 load() const { return _mm_load_ps( my_coords ); }
+    /// Sets the coordinates from the lanes of \a x.
+    void store( __m128 x ) { _mm_store_ps( my_coords, x ); }
+
+    // std::array part
+    T*       begin()       { return my_coords; }
+    const T* begin() const { return my_coords; }
+    T*       end()         { return my_coords + N; }
+    const T* end()   const { return my_coords + N; }
+    constexpr Size size()     const { return N; }
+    constexpr Size max_size() const { return N; }
+    T&       operator[]( Size i )       { return my_coords[ i ]; }
+    const T& operator[]( Size i ) const { return my_coords[ i ]; }
+    T& at( Size i )
+    {
+      if ( i >= N ) throw std::out_of_range( "PointVector::at" );
+      return my_coords[ i ];
+    }
+    const T& at( Size i ) const
+    {
+      if ( i >= N ) throw std::out_of_range( "PointVector::at" );
+      return my_coords[ i ];
+    }
+    T&       front()       { return my_coords[ 0 ]; }
+    const T& front() const { return my_coords[ 0 ]; }
+    T&       back()        { return my_coords[ N - 1 ]; }
+    const T& back()  const { return my_coords[ N - 1 ]; }
+    T*       data()        { return my_coords; }
+    const T* data()  const { return my_coords; }
+
+    // Useful for conversion to OpenGL vectors
+    operator T*()             { return my_coords; }
+    // Useful for conversion to OpenGL vectors
+    operator const T*() const { return my_coords; }
+
+    void selfDisplay( std::ostream& out ) const
+    {
+      out << "(";
+      for ( Size i = 0; i < N; i++ )
+        out << (*this)[ i ] << ( ( i < N-1 ) ? ',' : ')' );
+    }
+
+    Self operator-() const
+    {
+      return Self( _mm_sub_ps( _mm_setzero_ps(), load() ) );
+    }
+
+    Self& operator+=( const Self& other )
+    {
+      store( _mm_add_ps( load(), other.load() ) );
+      return self();
+    }
+    Self& operator-=( const Self& other )
+    {
+      store( _mm_sub_ps( load(), other.load() ) );
+      return self();
+    }
+    Self& operator*=( T val )
+    {
+      store( _mm_mul_ps( load(), _mm_set1_ps( val ) ) );
+      return self();
+    }
+    Self& operator/=( T val )
+    {
+      store( padding( _mm_div_ps( load(), _mm_set1_ps( val ) ) ) );
+      return self();
+    }
+
+    /// dot product (produit scalaire).
+    T dot( const Self& other ) const
+    {
+      // Sums the products from left to right, as the scalar loop.
+      __m128 m = _mm_mul_ps( load(), other.load() );
+      __m128 s = _mm_add_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+      s = _mm_add_ss( s, _mm_movehl_ps( m, m ) );
+      if ( N > 3 ) s = _mm_add_ss( s, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+      return _mm_cvtss_f32( s );
+    }
+    /// cross product (produit vectoriel).
+    Self cross( const Self& other ) const
+    {
+      assert( N == 3 );
+      __m128 a = load();
+      __m128 b = other.load();
+      __m128 a_yzx = _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 0, 2, 1 ) );
+      __m128 b_yzx = _mm_shuffle_ps( b, b, _MM_SHUFFLE( 3, 0, 2, 1 ) );
+      __m128 a_zxy = _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 1, 0, 2 ) );
+      __m128 b_zxy = _mm_shuffle_ps( b, b, _MM_SHUFFLE( 3, 1, 0, 2 ) );
+      return Self( _mm_sub_ps( _mm_mul_ps( a_yzx, b_zxy ), _mm_mul_ps( a_zxy, b_yzx ) ) );
+    }
+
+    Self operator+( const Self& other ) const
+    {
+      return Self( _mm_add_ps( load(), other.load() ) );
+    }
+
+    Self operator-( const Self& other ) const
+    {
+      return Self( _mm_sub_ps( load(), other.load() ) );
+    }
+
+    /// component-wise product.
+    Self mul( const Self& other ) const
+    {
+      return Self( _mm_mul_ps( load(), other.load() ) );
+    }
+    /// component-wise minimum.
+    Self inf( const Self& other ) const
+    {
+      return Self( _mm_min_ps( load(), other.load() ) );
+    }
+    /// component-wise maximum.
+    Self sup( const Self& other ) const
+    {
+      return Self( _mm_max_ps( load(), other.load() ) );
+    }
+
+    T norm() const
+    {
+      return _mm_cvtss_f32( _mm_sqrt_ss( _mm_set_ss( dot( self() ) ) ) );
+    }
+    /// @return the vector divided by its norm, in one register.
+    Self normalized() const
+    {
+      __m128 v = load();
+      return Self( padding( _mm_div_ps( v, _mm_set1_ps( norm() ) ) ) );
+    }
+
+    /// Resets the padding lane of \a x (for N = 3), which a division may
+    /// have turned into a NaN.
+    static __m128 padding( __m128 x )
+    {
+      if ( N > 3 ) return x;
+      return _mm_and_ps( x, _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) ) );
+    }
+
+  private:
+    alignas( 16 ) T my_coords[ 4 ];
+
+    Self&       self()       { return static_cast<Self&>( *this ); }
+    const Self& self() const { return static_cast<const Self&>( *this ); }
+  };
+
+  /// A 3d point or vector of floats, stored in one SSE register.
+  template <>
+  struct PointVector<float, 3> : public PackedPointVector<3> {
+    using PackedPointVector<3>::PackedPointVector;
+    PointVector() {}
+  };
+
+  /// A 4d point or vector of floats, stored in one SSE register.
+  template <>
+  struct PointVector<float, 4> : public PackedPointVector<4> {
+    using PackedPointVector<4>::PackedPointVector;
+    PointVector() {}
+  };
+
+  /// The return type of the operators below, which exist only for the
+  /// packed vectors.
+  template <std::size_t N>
+  using PackedPointVectorIf =
+    typename std::enable_if< N == 3 || N == 4, PointVector<float, N> >::type;
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> operator*( float val, const PointVector<float,N>& PV )
+  {
+    return PointVector<float,N>( _mm_mul_ps( _mm_set1_ps( val ), PV.load() ) );
+  }
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> operator*( const PointVector<float,N>& PV, float val )
+  {
+    return PointVector<float,N>( _mm_mul_ps( PV.load(), _mm_set1_ps( val ) ) );
+  }
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> operator/( float val, const PointVector<float,N>& PV )
+  {
+    return PointVector<float,N>( PV.padding( _mm_div_ps( _mm_set1_ps( val ), PV.load() ) ) );
+  }
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> operator/( const PointVector<float,N>& PV, float val )
+  {
+    return PointVector<float,N>( PV.padding( _mm_div_ps( PV.load(), _mm_set1_ps( val ) ) ) );
+  }
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> lerp( const PointVector<float,N>& p1,
+                                      const PointVector<float,N>& p2, float t )
+  {
+    return PointVector<float,N>( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 1.0f - t ), p1.load() ),
+                                             _mm_mul_ps( _mm_set1_ps( t ), p2.load() ) ) );
+  }
+
+  template <std::size_t N>
+  inline PackedPointVectorIf<N> madd( const PointVector<float,N>& p, float s,
+                                      const PointVector<float,N>& v )
+  {
+#ifdef __FMA__
+    return PointVector<float,N>( _mm_fmadd_ps( _mm_set1_ps( s ), v.load(), p.load() ) );
+#else
+    return PointVector<float,N>( _mm_add_ps( p.load(), _mm_mul_ps( _mm_set1_ps( s ), v.load() ) ) );
+#endif
+  }
+
+} // namespace rt
+
+#endif // _POINT_VECTOR_SIMD_H_
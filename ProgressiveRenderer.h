@@ -0,0 +1,258 @@
+/**
+@file ProgressiveRenderer.h
+*/
+#pragma once
+#ifndef _PROGRESSIVE_RENDERER_H_
+#define _PROGRESSIVE_RENDERER_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Renderer.h"
+#include "GBuffer.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// Renders an image in a background thread, pass after pass, so that
+  /// an interface stays responsive and may display the image while it
+  /// converges. A quick preview (one ray per block of PREVIEW_BLOCK^2
+  /// pixels) comes first, then each pass adds one sample to every
+  /// pixel: the pixel center first in deterministic mode, then jittered
+  /// samples (see Renderer::sample). The render may be cancelled at any
+  /// time, e.g. when the camera moves.
+  ///
+  /// With adaptive antialiasing (see Renderer::setAntialiasing), the
+  /// first passes give its minimum number of samples to every pixel,
+  /// then the pixels that Renderer::needsRefinement selects get one more
+  /// sample per pass up to its maximum number, the others are left as
+  /// they are.
+  ///
+  /// The primary hits of the deterministic pass are kept in a GBuffer:
+  /// the next render with the same camera and resolution, after the
+  /// lights or the materials only have changed, shades them again
+  /// without tracing the primary rays. The jittered samples of the
+  /// antialiased and stochastic passes are always traced.
+  ///
+  /// The scene must not be modified while the render is running.
+  struct ProgressiveRenderer {
+
+    /// Size in pixels of the blocks of the preview.
+    static const int PREVIEW_BLOCK = 8;
+
+    ProgressiveRenderer()
+      : myMaxDepth( 0 ), myNbPasses( 0 ), myReuseHits( false ),
+        myCancel( false ), myRunning( false ),
+        myPasses( 0 ), mySamplesSpent( 0 ), myNbRefined( 0 ), myUpdated( false ) {}
+
+    /// Cancels the render, if any.
+    ~ProgressiveRenderer() { cancel(); }
+
+    /// Starts rendering a \a width x \a height image with a copy of \a
+    /// renderer (whose scene and background must outlive the render),
+    /// in \a nb_passes passes, or in as many passes as the maximum
+    /// number of samples of its antialiasing if it is enabled. The
+    /// previous render is cancelled. The
+    /// scene is prepared by the calling thread, and the primary hits of
+    /// the previous render are reused if they are still valid.
+    void start( const Renderer& renderer, int width, int height,
+                int max_depth, int nb_passes )
+    {
+      cancel();
+      myRenderer = renderer;
+      myRenderer.setResolution( width, height );
+      myRenderer.prepare();
+      myReuseHits = myGBuffer.reset( myRenderer );
+      myMaxDepth = max_depth;
+      myNbPasses = myRenderer.myAAMinSamples > 0 ? myRenderer.myAAMaxSamples
+                                                 : std::max( 1, nb_passes );
+      myImage    = Image2D<Color>( width, height );
+      myUpdated  = false;
+      myPasses   = 0;
+      mySamplesSpent = 0;
+      myNbRefined    = 0;
+      myCancel   = false;
+      myRunning  = true;
+      myThread   = std::thread( &ProgressiveRenderer::run, this );
+    }
+
+    /// Stops the render as soon as possible and waits for its thread.
+    void cancel()
+    {
+      myCancel = true;
+      if ( myThread.joinable() ) myThread.join();
+      myRunning = false;
+    }
+
+    /// @return 'true' while the render is neither finished nor cancelled.
+    bool isRunning() const { return myRunning; }
+
+    /// @return 'true' if the current render reuses the primary hits of
+    /// the previous one.
+    bool reusesHits() const { return myReuseHits; }
+
+    /// @return the number of passes completed so far.
+    int passes() const { return myPasses; }
+
+    /// @return the number of passes of the whole render.
+    int nbPasses() const { return myNbPasses; }
+
+    /// @return 'true' if the render uses adaptive antialiasing.
+    bool isAdaptive() const { return myRenderer.myAAMinSamples > 0; }
+
+    /// @return the number of camera rays shot by the completed passes.
+    long samplesSpent() const { return mySamplesSpent; }
+
+    /// @return the number of pixels refined by the adaptive
+    /// antialiasing (0 until its first passes are completed).
+    long nbRefined() const { return myNbRefined; }
+
+    /// Copies the current image into \a image if it has changed since
+    /// the last call.
+    /// @return 'true' if \a image was updated.
+    bool fetch( Image2D<Color>& image )
+    {
+      std::lock_guard<std::mutex> lock( myMutex );
+      if ( ! myUpdated ) return false;
+      image     = myImage;
+      myUpdated = false;
+      return true;
+    }
+
+    /// @return a copy of the current image.
+    Image2D<Color> image()
+    {
+      std::lock_guard<std::mutex> lock( myMutex );
+      return myImage;
+    }
+
+  private:
+    /// The settings, scene and camera of the render.
+    Renderer myRenderer;
+    /// Maximum depth of the rays.
+    int myMaxDepth;
+    /// The number of passes of the render.
+    int myNbPasses;
+    /// The primary hits of the pixel centers.
+    GBuffer myGBuffer;
+    /// 'true' if myGBuffer holds the hits of this render, 'false' if the
+    /// deterministic pass fills it.
+    bool myReuseHits;
+    /// The thread computing the image.
+    std::thread myThread;
+    /// Set to stop the render.
+    std::atomic<bool> myCancel;
+    /// 'true' until the render is finished or cancelled.
+    std::atomic<bool> myRunning;
+    /// The number of completed passes.
+    std::atomic<int> myPasses;
+    /// The number of camera rays of the completed passes.
+    std::atomic<long> mySamplesSpent;
+    /// The number of pixels refined by the antialiasing.
+    std::atomic<long> myNbRefined;
+    /// Protects myImage and myUpdated.
+    std::mutex myMutex;
+    /// The image displayed, i.e. the mean of the samples computed so far.
+    Image2D<Color> myImage;
+    /// 'true' when myImage changed since the last fetch.
+    bool myUpdated;
+
+    /// @return the clamped color of the ray through the center of pixel
+    /// (\a x, \a y), as Renderer::render computes it in deterministic mode.
+    /// The primary hit is read from myGBuffer if it is reused, otherwise
+    /// it is stored there if \a store is 'true'.
+    Color center( int x, int y, bool store = false )
+    {
+      Ray eye_ray( myRenderer.myOrigin, myRenderer.direction( (Real) x, (Real) y ), myMaxDepth );
+      if ( myReuseHits )
+        return ( myGBuffer.found( x, y ) ? myRenderer.shade( eye_ray, myGBuffer.hit( x, y ) )
+                 : myRenderer.background( eye_ray ) ).clamp();
+      RayHit hit;
+      const bool found = myRenderer.ptrScene->rayIntersection( eye_ray, hit );
+      if ( store ) myGBuffer.set( x, y, found, hit );
+      return ( found ? myRenderer.shade( eye_ray, hit )
+               : myRenderer.background( eye_ray ) ).clamp();
+    }
+
+    /// The body of the rendering thread.
+    void run()
+    {
+      const int w = myRenderer.myWidth;
+      const int h = myRenderer.myHeight;
+      const int B = PREVIEW_BLOCK;
+      TileScheduler scheduler( myRenderer.myNbThreads );
+      // Preview: one ray per block, tiles are multiples of blocks.
+      scheduler.run( TileScheduler::split( w, h, 4 * B ), [&] ( const Tile& tile ) {
+          if ( myCancel ) return;
+          std::vector<Color> colors;
+          for ( int y = tile.y0; y < tile.y1; y += B )
+            for ( int x = tile.x0; x < tile.x1; x += B )
+              colors.push_back( center( std::min( x + B / 2, tile.x1 - 1 ),
+                                        std::min( y + B / 2, tile.y1 - 1 ) ) );
+          std::lock_guard<std::mutex> lock( myMutex );
+          for ( int y = tile.y0; y < tile.y1; ++y )
+            for ( int x = tile.x0; x < tile.x1; ++x )
+              myImage.at( x, y ) = colors[ ( ( y - tile.y0 ) / B ) * ( ( tile.x1 - tile.x0 + B - 1 ) / B )
+                                           + ( x - tile.x0 ) / B ];
+          myUpdated = true;
+        }, [] ( int, int ) {} );
+      // Passes: one more sample per pixel each time (per refined pixel
+      // after the first passes of the antialiasing). A tile is shown as
+      // soon as it is done.
+      const std::size_t nb_pixels = (std::size_t) w * h;
+      const int aa_min = myRenderer.myAAMinSamples;
+      std::vector<Color> sum( nb_pixels ), sum2( aa_min > 0 ? nb_pixels : 0 );
+      std::vector<int> count( nb_pixels, 0 );
+      std::vector<char> refine;
+      std::vector<Tile> tiles = TileScheduler::split( w, h, myRenderer.myTileSize );
+      for ( int s = 0; s < myNbPasses && ! myCancel; ++s ) {
+        if ( aa_min > 0 && s == aa_min ) {
+          refine.resize( nb_pixels );
+          long nb_refined = 0;
+          for ( int y = 0; y < h; ++y )
+            for ( int x = 0; x < w; ++x ) {
+              const bool noisy = myRenderer.needsRefinement( sum, sum2, count, x, y );
+              refine[ (std::size_t) y * w + x ] = noisy;
+              nb_refined += noisy ? 1 : 0;
+            }
+          myNbRefined = nb_refined;
+          if ( nb_refined == 0 ) {
+            myPasses = myNbPasses;
+            break;
+          }
+        }
+        const bool at_center = s == 0 && ! myRenderer.myStochastic;
+        scheduler.run( tiles, [&] ( const Tile& tile ) {
+            for ( int y = tile.y0; y < tile.y1; ++y ) {
+              if ( myCancel ) return;
+              for ( int x = tile.x0; x < tile.x1; ++x ) {
+                const std::size_t i = (std::size_t) y * w + x;
+                if ( ! refine.empty() && ! refine[ i ] ) continue;
+                const Color c = at_center ? center( x, y, true )
+                  : myRenderer.sample( x, y, s, myMaxDepth );
+                sum[ i ] += c;
+                if ( aa_min > 0 ) sum2[ i ] += c * c;
+                count[ i ] += 1;
+              }
+            }
+            std::lock_guard<std::mutex> lock( myMutex );
+            for ( int y = tile.y0; y < tile.y1; ++y )
+              for ( int x = tile.x0; x < tile.x1; ++x ) {
+                const std::size_t i = (std::size_t) y * w + x;
+                myImage.at( x, y ) = sum[ i ] * ( 1.0f / (Real) count[ i ] );
+              }
+            myUpdated = true;
+          }, [] ( int, int ) {} );
+        if ( myCancel ) break;
+        if ( at_center ) myGBuffer.setComplete();
+        mySamplesSpent += refine.empty() ? (long) nb_pixels : (long) myNbRefined;
+        myPasses = s + 1;
+      }
+      myRunning = false;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _PROGRESSIVE_RENDERER_H_
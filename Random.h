@@ -0,0 +1,57 @@
+/**
+@file Random.h
+*/
+#pragma once
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <cstdint>
+#include "PointVector.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A small and fast pseudo-random number generator (xorshift64*).
+  /// Each pixel gets its own generator, seeded from its coordinates,
+  /// so that stochastic renders do not depend on the order in which
+  /// threads process the tiles.
+  struct Random {
+    /// The state of the generator, never 0.
+    std::uint64_t state;
+
+    /// Creates a generator from any 64 bit \a seed.
+    explicit Random( std::uint64_t seed ) : state( mix( seed ) | 1 ) {}
+
+    /// Creates the generator of the sample \a s of pixel (\a x, \a y).
+    Random( int x, int y, int s )
+      : Random( ( (std::uint64_t) (std::uint32_t) y << 32 | (std::uint32_t) x )
+                ^ ( (std::uint64_t) s * 0x9E3779B97F4A7C15ULL ) )
+    {}
+
+    /// @return the next 32 random bits.
+    std::uint32_t next()
+    {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return (std::uint32_t) ( ( state * 0x2545F4914F6CDD1DULL ) >> 32 );
+    }
+
+    /// @return a random number uniformly distributed in [0,1[.
+    Real uniform()
+    {
+      return (Real) ( next() >> 8 ) * ( 1.0f / 16777216.0f );
+    }
+
+    /// The splitmix64 finalizer, which spreads the bits of close seeds.
+    static std::uint64_t mix( std::uint64_t z )
+    {
+      z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+      z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+      return z ^ ( z >> 31 );
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _RANDOM_H_
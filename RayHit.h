@@ -0,0 +1,46 @@
+/**
+@file RayHit.h
+*/
+#pragma once
+#ifndef _RAY_HIT_H_
+#define _RAY_HIT_H_
+
+#include <limits>
+#include "PointVector.h"
+#include "Material.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// Forward declaration of struct GraphicalObject.
+  struct GraphicalObject;
+
+  /// This structure stores everything the renderer needs to know about
+  /// the intersection of a ray with an object. It is filled once by
+  /// GraphicalObject::rayIntersection.
+  struct RayHit {
+    /// Distance from the ray origin to the intersection. Before the
+    /// query, only intersections closer than \a t are accepted.
+    Real t;
+    /// The point of intersection.
+    Point3 point;
+    /// The normal vector of the object at the point of intersection.
+    Vector3 normal;
+    /// The material of the object at the point of intersection (it
+    /// belongs to the object).
+    const Material* material;
+    /// Coordinates of the point in the parameterization of the object.
+    Vector2 uv;
+    /// The intersected object.
+    GraphicalObject* object;
+
+    /// Default constructor. Any intersection is accepted.
+    RayHit()
+      : t( std::numeric_limits<Real>::infinity() ), material( nullptr ),
+        object( nullptr )
+    {}
+  };
+
+} // namespace rt
+
+#endif // #define _RAY_HIT_H_
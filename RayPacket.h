@@ -0,0 +1,132 @@
+/**
+@file RayPacket.h
+*/
+#pragma once
+#ifndef _RAY_PACKET_H_
+#define _RAY_PACKET_H_
+
+#include <algorithm>
+#include <limits>
+#include "PointVector.h"
+#include "Ray.h"
+#include "BoundingBox.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// Forward declaration of struct GraphicalObject.
+  struct GraphicalObject;
+
+  /// A packet of neighbouring rays (typically primary rays of adjacent
+  /// pixels), traced together with SSE kernels. The rays are kept as is
+  /// for the scalar fallback, and their coordinates are also stored
+  /// lane by lane (structure of arrays). The packet also stores the
+  /// ranges of its origins and inverted directions, which bound the
+  /// frustum of the rays for traversals.
+  struct RayPacket {
+    /// Number of rays of a packet (one SSE register of floats).
+    static const int SIZE = 4;
+
+    /// The rays.
+    Ray rays[ SIZE ];
+    /// The coordinates of the origins, lane by lane.
+    alignas( 16 ) float ox[ SIZE ], oy[ SIZE ], oz[ SIZE ];
+    /// The coordinates of the (unit) directions, lane by lane.
+    alignas( 16 ) float dx[ SIZE ], dy[ SIZE ], dz[ SIZE ];
+    /// The lowest and highest coordinates of the origins.
+    Point3 org_lo, org_hi;
+    /// The lowest and highest inverted coordinates of the directions.
+    Vector3 inv_lo, inv_hi;
+    /// For each axis, 'true' if the directions go towards increasing
+    /// coordinates.
+    bool positive[ 3 ];
+    /// 'true' if, along each axis, all the directions have the same
+    /// (non zero) sign. Otherwise the frustum is not bounded and the
+    /// rays must be traced one by one.
+    bool coherent;
+
+    /// Creates the packet of the \a SIZE rays of \a r.
+    explicit RayPacket( const Ray* r )
+    {
+      coherent = true;
+      for ( int i = 0; i < SIZE; ++i ) {
+        rays[ i ] = r[ i ];
+        ox[ i ] = r[ i ].origin[ 0 ];
+        oy[ i ] = r[ i ].origin[ 1 ];
+        oz[ i ] = r[ i ].origin[ 2 ];
+        dx[ i ] = r[ i ].direction[ 0 ];
+        dy[ i ] = r[ i ].direction[ 1 ];
+        dz[ i ] = r[ i ].direction[ 2 ];
+      }
+      for ( int a = 0; a < 3; ++a ) {
+        positive[ a ] = r[ 0 ].direction[ a ] > 0.0f;
+        org_lo[ a ] = org_hi[ a ] = r[ 0 ].origin[ a ];
+        inv_lo[ a ] = inv_hi[ a ] = 1.0f / r[ 0 ].direction[ a ];
+        for ( int i = 0; i < SIZE; ++i ) {
+          Real d = r[ i ].direction[ a ];
+          if ( ! ( positive[ a ] ? d > 0.0f : d < 0.0f ) ) coherent = false;
+          org_lo[ a ] = std::min( org_lo[ a ], r[ i ].origin[ a ] );
+          org_hi[ a ] = std::max( org_hi[ a ], r[ i ].origin[ a ] );
+          inv_lo[ a ] = std::min( inv_lo[ a ], 1.0f / d );
+          inv_hi[ a ] = std::max( inv_hi[ a ], 1.0f / d );
+        }
+      }
+    }
+
+    /// Conservative slab test between \a box and the frustum of a
+    /// coherent packet, with interval arithmetic: it may accept a box
+    /// that no ray enters, but never rejects a box entered by one of
+    /// the rays before \a t_max.
+    bool intersects( const BoundingBox& box, Real t_max ) const
+    {
+      Real t0 = 0.0f;
+      Real t1 = t_max;
+      for ( int a = 0; a < 3; ++a ) {
+        const Real near_plane = positive[ a ] ? box.lo[ a ] : box.hi[ a ];
+        const Real far_plane  = positive[ a ] ? box.hi[ a ] : box.lo[ a ];
+        Real n0 = near_plane - org_hi[ a ], n1 = near_plane - org_lo[ a ];
+        Real f0 = far_plane  - org_hi[ a ], f1 = far_plane  - org_lo[ a ];
+        Real t_near = std::min( std::min( n0 * inv_lo[ a ], n0 * inv_hi[ a ] ),
+                                std::min( n1 * inv_lo[ a ], n1 * inv_hi[ a ] ) );
+        Real t_far  = std::max( std::max( f0 * inv_lo[ a ], f0 * inv_hi[ a ] ),
+                                std::max( f1 * inv_lo[ a ], f1 * inv_hi[ a ] ) );
+        t0 = t_near > t0 ? t_near : t0;
+        t1 = t_far < t1 ? t_far : t1;
+        if ( t0 > t1 ) return false;
+      }
+      return true;
+    }
+  };
+
+  /// The closest intersections found so far for the rays of a packet.
+  /// Only the distance and the object are known, the caller computes
+  /// the other data of the hits (see Scene::rayIntersection).
+  struct RayPacketHit {
+    /// Distance of the closest intersection of each ray, only closer
+    /// intersections are accepted.
+    alignas( 16 ) float t[ RayPacket::SIZE ];
+    /// The intersected objects (0 for none).
+    GraphicalObject* object[ RayPacket::SIZE ];
+
+    /// Default constructor. Any intersection is accepted.
+    RayPacketHit()
+    {
+      for ( int i = 0; i < RayPacket::SIZE; ++i ) {
+        t[ i ]      = std::numeric_limits<Real>::infinity();
+        object[ i ] = nullptr;
+      }
+    }
+
+    /// @return the largest distance of the rays, which bounds the
+    /// traversal of the packet.
+    Real maxDistance() const
+    {
+      Real m = t[ 0 ];
+      for ( int i = 1; i < RayPacket::SIZE; ++i ) m = std::max( m, t[ i ] );
+      return m;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _RAY_PACKET_H_
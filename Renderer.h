@@ -7,26 +7,37 @@
 #define _RENDERER_H_
 
 #include <cmath>
+#include <cstring>
 #include "Color.h"
 #include "Image2D.h"
 #include "Ray.h"
-#include "Viewer.h"
+#include "RayPacket.h"
 #include "GraphicalObject.h"
 #include "PointVector.h"
 #include "Scene.h"
+#include "TileScheduler.h"
+#include "Random.h"
+#include "Light.h"
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 
 
 /// Namespace RayTracer
 namespace rt {
 
+    /// Displays a progress bar. It may be called from several threads.
     inline void progressBar(std::ostream& output,
                             const double currentValue, const double maximumValue) {
         static const int PROGRESSBARWIDTH = 60;
         static int myProgressBarRotation = 0;
         static int myProgressBarCurrent = 0;
+        static std::mutex myProgressBarMutex;
+        std::lock_guard<std::mutex> lock(myProgressBarMutex);
         // how wide you want the progress meter to be
         double fraction = currentValue / maximumValue;
 
@@ -54,6 +65,7 @@ namespace rt {
     }
 
     struct Background {
+        virtual ~Background() {}
         virtual Color backgroundColor(const Ray& ray) = 0;
     };
 
@@ -109,12 +121,105 @@ namespace rt {
         // On rajoute un pointeur vers un objet Background
         Background *ptrBackground;
 
-        Renderer() : ptrScene(0) {}
-
-        Renderer(Scene& scene, Background *background) : ptrScene(&scene), ptrBackground(background) {}
+        /// The number of threads used by render (0 means one per core).
+        int myNbThreads;
+        /// The size in pixels of the square tiles distributed to the threads.
+        int myTileSize;
+        /// When 'true', each ray follows only one of the reflected and
+        /// refracted rays (see traceStochastic).
+        bool myStochastic;
+        /// The number of stochastic samples averaged in each pixel.
+        int mySamplesPerPixel;
+        /// Number of samples per pixel of the first pass of the adaptive
+        /// antialiasing (0 disables it).
+        int myAAMinSamples;
+        /// Number of samples of the pixels refined by the second pass.
+        int myAAMaxSamples;
+        /// Pixels whose standard deviation, or difference with a
+        /// neighbour, is above this threshold are refined.
+        Real myAAThreshold;
+        /// The number of camera rays shot by the last render.
+        long mySamplesSpent;
+        /// When 'true', the primary rays of deterministic renders are
+        /// traced by packets of neighbouring pixels.
+        bool myPackets;
+        /// Number of shadow rays per shading point when lights are
+        /// sampled (0 casts one towards every light), see setLightSampling.
+        int myShadowRays;
+        /// Lights whose unshadowed contribution is below this threshold
+        /// are skipped.
+        Real myLightThreshold;
+
+        /// A light as seen by background(), built by prepare().
+        struct LightGlow {
+            Light* light;
+            /// Its position, or its direction if it is at infinity.
+            Vector3 position;
+            bool at_infinity;
+        };
+        /// The lights as seen by background().
+        std::vector<LightGlow> myLightGlows;
+
+        Renderer() : ptrScene(0), ptrBackground(0), myNbThreads(0), myTileSize(16),
+                     myStochastic(false), mySamplesPerPixel(1),
+                     myAAMinSamples(0), myAAMaxSamples(0), myAAThreshold(0.0f),
+                     mySamplesSpent(0), myPackets(true),
+                     myShadowRays(0), myLightThreshold(0.0f) {}
+
+        Renderer(Scene& scene, Background *background)
+            : ptrScene(&scene), ptrBackground(background), myNbThreads(0), myTileSize(16),
+              myStochastic(false), mySamplesPerPixel(1),
+              myAAMinSamples(0), myAAMaxSamples(0), myAAThreshold(0.0f),
+              mySamplesSpent(0), myPackets(true),
+              myShadowRays(0), myLightThreshold(0.0f) {}
 
         void setScene(rt::Scene& aScene) { ptrScene = &aScene; }
 
+        /// Sets the number of rendering threads (0 means one per core).
+        void setNbThreads(int nb_threads) { myNbThreads = nb_threads; }
+
+        /// Sets the size of the tiles distributed to the rendering threads.
+        void setTileSize(int tile_size) { myTileSize = std::max(1, tile_size); }
+
+        /// Chooses between the deterministic ray tree (default) and
+        /// stochastic paths, whose cost is linear in the depth.
+        void setStochastic(bool stochastic) { myStochastic = stochastic; }
+
+        /// Sets the number of samples per pixel of stochastic renders.
+        void setSamplesPerPixel(int spp) { mySamplesPerPixel = std::max(1, spp); }
+
+        /// Enables adaptive antialiasing: every pixel gets \a min_samples
+        /// jittered samples, then pixels that are noisy or contrast with
+        /// a neighbour by more than \a threshold (colors are in [0,1])
+        /// get \a max_samples in all. Each sample is one camera ray
+        /// (one path in stochastic mode, whose samples per pixel are
+        /// then chosen by the antialiasing). 0 \a min_samples disables it.
+        void setAntialiasing(int min_samples, int max_samples, Real threshold) {
+            myAAMinSamples = std::max(0, min_samples);
+            myAAMaxSamples = std::max(myAAMinSamples, max_samples);
+            myAAThreshold = threshold;
+        }
+
+        /// Chooses between packets of primary rays (default) and rays
+        /// traced one by one. Both give the same image.
+        void setPackets(bool packets) { myPackets = packets; }
+
+        /// Sets how the lights are sampled at each shading point. Lights
+        /// whose unshadowed contribution (its largest channel) is below
+        /// \a threshold are skipped. If more than \a shadow_rays lights
+        /// remain, only \a shadow_rays of them get a shadow ray: they are
+        /// chosen in proportion to their contribution, which is divided
+        /// by their probability, so that the image is noisier but not
+        /// darker. 0 \a shadow_rays casts a shadow ray towards every
+        /// light (default, exact when \a threshold is 0).
+        void setLightSampling(int shadow_rays, Real threshold) {
+            myShadowRays = std::max(0, shadow_rays);
+            myLightThreshold = std::max(0.0f, threshold);
+        }
+
+        /// @return the number of camera rays shot by the last render.
+        long samplesSpent() const { return mySamplesSpent; }
+
         void setViewBox(Point3 origin,
                         Vector3 dirUL, Vector3 dirUR, Vector3 dirLL, Vector3 dirLR) {
             myOrigin = origin;
@@ -129,43 +234,215 @@ namespace rt {
             myHeight = height;
         }
 
+        /// Prepares the scene and the lights seen by background(). Must be
+        /// called (out of any rendering thread) before rendering, as
+        /// render() does.
+        void prepare() {
+            ptrScene->prepare();
+            myLightGlows.clear();
+            for (Light* light : ptrScene->myLights) {
+                LightGlow glow;
+                glow.light = light;
+                Real d = light->distance(myOrigin);
+                glow.at_infinity = std::isinf(d);
+                glow.position = glow.at_infinity ? light->direction(myOrigin)
+                                                 : myOrigin + light->direction(myOrigin) * d;
+                myLightGlows.push_back(glow);
+            }
+        }
+
         // Affiche les sources de lumières avant d'appeler la fonction qui
         // donne la couleur de fond.
         Color background(const Ray& ray) {
             Color result = Color(0.0, 0.0, 0.0);
-            for (Light *light : ptrScene->myLights) {
-                Real cos_a = light->direction(ray.origin).dot(ray.direction);
-                if (cos_a > 0.99f) {
-                    Real a = acos(cos_a) * 360.0 / M_PI / 8.0;
-                    a = std::max(1.0f - a, 0.0f);
-                    result += light->color(ray.origin) * a * a;
+            if (myLightGlows.size() == ptrScene->myLights.size()) {
+                // Cheap test first (an angle of 11 degrees instead of 8),
+                // without virtual call nor square root.
+                for (const LightGlow& glow : myLightGlows) {
+                    Vector3 d = glow.at_infinity ? glow.position : glow.position - ray.origin;
+                    Real cos_d = d.dot(ray.direction);
+                    if (cos_d > 0.0f && cos_d * cos_d > 0.96f * d.dot(d))
+                        addGlow(result, glow.light, ray);
                 }
-            }
+            } else
+                for (Light *light : ptrScene->myLights)
+                    addGlow(result, light, ray);
             if (ptrBackground != 0)
                 result += ptrBackground->backgroundColor(ray);
             return result;
         }
 
-        /// The main rendering routine
+        /// Adds to \a c the glow of \a light around its direction, if
+        /// \a ray looks at it.
+        void addGlow(Color& c, Light* light, const Ray& ray) const {
+            Real cos_a = light->direction(ray.origin).dot(ray.direction);
+            if (cos_a > 0.99f) {
+                Real a = acos(cos_a) * 360.0 / M_PI / 8.0;
+                a = std::max(1.0f - a, 0.0f);
+                c += light->color(ray.origin) * a * a;
+            }
+        }
+
+        /// The main rendering routine. The image is split into tiles
+        /// which are rendered by several threads.
         void render(Image2D<Color>& image, int max_depth) {
             std::cout << "Rendering into image ... might take a while." << std::endl;
             image = Image2D<Color>(myWidth, myHeight);
-            for (int y = 0; y < myHeight; ++y) {
-                Real ty = (Real) y / (Real) (myHeight - 1);
-                progressBar(std::cout, ty, 1.0);
-                Vector3 dirL = (1.0f - ty) * myDirUL + ty * myDirLL;
-                Vector3 dirR = (1.0f - ty) * myDirUR + ty * myDirLR;
-                dirL /= dirL.norm();
-                dirR /= dirR.norm();
+            prepare();
+            if (myAAMinSamples > 0) {
+                renderAdaptive(image, max_depth);
+                return;
+            }
+            TileScheduler scheduler(myNbThreads);
+            scheduler.run(TileScheduler::split(myWidth, myHeight, myTileSize),
+                          [&](const Tile& tile) { renderTile(image, tile, max_depth); },
+                          [](int done, int total) { progressBar(std::cout, done, total); });
+            mySamplesSpent = (long) myWidth * myHeight * (myStochastic ? mySamplesPerPixel : 1);
+            std::cout << "Done." << std::endl;
+        }
+
+        /// The rendering routine with adaptive antialiasing, in two
+        /// passes over the tiles (see setAntialiasing).
+        void renderAdaptive(Image2D<Color>& image, int max_depth) {
+            std::size_t nb_pixels = (std::size_t) myWidth * myHeight;
+            std::vector<Color> sum(nb_pixels), sum2(nb_pixels);
+            std::vector<int> count(nb_pixels, 0);
+            std::vector<char> refine(nb_pixels, 0);
+            auto addSamples = [&](int x, int y, int nb) {
+                std::size_t i = (std::size_t) y * myWidth + x;
+                for (int s = count[i]; s < nb; ++s) {
+                    Color c = sample(x, y, s, max_depth);
+                    sum[i] += c;
+                    sum2[i] += c * c;
+                }
+                count[i] = std::max(count[i], nb);
+            };
+            std::vector<Tile> tiles = TileScheduler::split(myWidth, myHeight, myTileSize);
+            int nb_tiles = (int) tiles.size();
+            TileScheduler scheduler(myNbThreads);
+            // First pass: a few samples everywhere.
+            scheduler.run(tiles, [&](const Tile& tile) {
+                    for (int y = tile.y0; y < tile.y1; ++y)
+                        for (int x = tile.x0; x < tile.x1; ++x)
+                            addSamples(x, y, myAAMinSamples);
+                },
+                [&](int done, int) { progressBar(std::cout, done, 2 * nb_tiles); });
+            // Selects the noisy pixels and the pixels on edges.
+            long nb_refined = 0;
+            for (int y = 0; y < myHeight; ++y)
                 for (int x = 0; x < myWidth; ++x) {
+                    bool noisy = needsRefinement(sum, sum2, count, x, y);
+                    refine[(std::size_t) y * myWidth + x] = noisy;
+                    nb_refined += noisy ? 1 : 0;
+                }
+            // Second pass: more samples where needed.
+            scheduler.run(tiles, [&](const Tile& tile) {
+                    for (int y = tile.y0; y < tile.y1; ++y)
+                        for (int x = tile.x0; x < tile.x1; ++x)
+                            if (refine[(std::size_t) y * myWidth + x])
+                                addSamples(x, y, myAAMaxSamples);
+                },
+                [&](int done, int) { progressBar(std::cout, nb_tiles + done, 2 * nb_tiles); });
+            mySamplesSpent = 0;
+            for (int y = 0; y < myHeight; ++y)
+                for (int x = 0; x < myWidth; ++x) {
+                    std::size_t i = (std::size_t) y * myWidth + x;
+                    image.at(x, y) = (sum[i] * (1.0f / count[i])).clamp();
+                    mySamplesSpent += count[i];
+                }
+            std::cout << "Done." << std::endl;
+            std::cout << "Antialiasing: " << mySamplesSpent << " samples ("
+                      << (double) mySamplesSpent / nb_pixels << " per pixel), "
+                      << nb_refined << " pixels refined." << std::endl;
+        }
+
+        /// @return 'true' if pixel (\a x, \a y) needs more samples
+        /// according to the adaptive antialiasing, i.e. if the standard
+        /// deviation of its samples, or the difference of its mean with
+        /// the mean of a neighbour, is above myAAThreshold. \a sum, \a
+        /// sum2 and \a count are the sums of the samples, of their
+        /// squares and their numbers, row by row.
+        bool needsRefinement(const std::vector<Color>& sum, const std::vector<Color>& sum2,
+                             const std::vector<int>& count, int x, int y) const {
+            std::size_t i = (std::size_t) y * myWidth + x;
+            Color mean = sum[i] * (1.0f / count[i]);
+            Color mean2 = sum2[i] * (1.0f / count[i]);
+            Real variance = std::max(std::max(mean2.r() - mean.r() * mean.r(),
+                                              mean2.g() - mean.g() * mean.g()),
+                                     mean2.b() - mean.b() * mean.b());
+            bool noisy = variance > myAAThreshold * myAAThreshold;
+            const int nx[4] = { x - 1, x + 1, x, x }, ny[4] = { y, y, y - 1, y + 1 };
+            for (int k = 0; k < 4 && !noisy; ++k) {
+                if (nx[k] < 0 || nx[k] >= myWidth || ny[k] < 0 || ny[k] >= myHeight) continue;
+                std::size_t j = (std::size_t) ny[k] * myWidth + nx[k];
+                noisy = distance(mean, sum[j] * (1.0f / count[j])) > myAAThreshold;
+            }
+            return noisy;
+        }
+
+        /// @return the direction of the ray through the point (\a x, \a
+        /// y) of the image, in pixels (pixel centers have integer
+        /// coordinates).
+        Vector3 direction(Real x, Real y) const {
+            Real ty = y / (Real) (myHeight - 1);
+            Vector3 dirL = lerp(myDirUL, myDirLL, ty).normalized();
+            Vector3 dirR = lerp(myDirUR, myDirLR, ty).normalized();
+            return lerp(dirL, dirR, x / (Real) (myWidth - 1));
+        }
+
+        /// @return the clamped color of the sample \a s of pixel (\a x, \a
+        /// y), through a random point of the pixel.
+        Color sample(int x, int y, int s, int max_depth) {
+            Random random(x, y, s);
+            Real fx = (Real) x + random.uniform() - 0.5f;
+            Real fy = (Real) y + random.uniform() - 0.5f;
+            Ray eye_ray(myOrigin, direction(fx, fy), max_depth);
+            Color c = myStochastic ? traceStochastic(eye_ray, random, Color(1.0, 1.0, 1.0))
+                                   : trace(eye_ray);
+            return c.clamp();
+        }
+
+        /// Renders the pixels of the given \a tile into \a image.
+        void renderTile(Image2D<Color>& image, const Tile& tile, int max_depth) {
+            for (int y = tile.y0; y < tile.y1; ++y) {
+                Real ty = (Real) y / (Real) (myHeight - 1);
+                Vector3 dirL = lerp(myDirUL, myDirLL, ty).normalized();
+                Vector3 dirR = lerp(myDirUR, myDirLR, ty).normalized();
+                int x = tile.x0;
+                // Packets of neighbouring primary rays, then the pixels
+                // left one by one.
+                const int N = RayPacket::SIZE;
+                for (; myPackets && !myStochastic && x + N <= tile.x1; x += N) {
+                    Ray eye_rays[N];
+                    for (int i = 0; i < N; ++i)
+                        eye_rays[i] = Ray(myOrigin,
+                                          lerp(dirL, dirR, (Real) (x + i) / (Real) (myWidth - 1)),
+                                          max_depth);
+                    RayPacket packet(eye_rays);
+                    RayHit hits[N];
+                    int found = ptrScene->rayIntersection(packet, hits);
+                    for (int i = 0; i < N; ++i) {
+                        Color result = (found & (1 << i)) ? shade(eye_rays[i], hits[i])
+                                                          : background(eye_rays[i]);
+                        image.at(x + i, y) = result.clamp();
+                    }
+                }
+                for (; x < tile.x1; ++x) {
                     Real tx = (Real) x / (Real) (myWidth - 1);
-                    Vector3 dir = (1.0f - tx) * dirL + tx * dirR;
+                    Vector3 dir = lerp(dirL, dirR, tx);
                     Ray eye_ray = Ray(myOrigin, dir, max_depth);
-                    Color result = trace(eye_ray);
+                    Color result;
+                    if (myStochastic) {
+                        for (int s = 0; s < mySamplesPerPixel; ++s) {
+                            Random random(x, y, s);
+                            result += traceStochastic(eye_ray, random, Color(1.0, 1.0, 1.0));
+                        }
+                        result = result * (1.0f / (Real) mySamplesPerPixel);
+                    } else
+                        result = trace(eye_ray);
                     image.at(x, y) = result.clamp();
                 }
             }
-            std::cout << "Done." << std::endl;
         }
 
 
@@ -173,27 +450,30 @@ namespace rt {
         /// @return the color for the given ray.
         Color trace(const Ray& ray) {
             assert(ptrScene != nullptr);
-            GraphicalObject *obj_i = nullptr; // pointer to intersected object
-            Point3 p_i;       // point of intersection
-            Color res(0, 0, 0);
+            RayHit hit;       // intersection with the closest object
 
             // Look for intersection in this direction.
-            Real ri = ptrScene->rayIntersection(ray, obj_i, p_i);
             // Nothing was intersected
-            if (ri >= 0.0f)
+            if (!ptrScene->rayIntersection(ray, hit))
                 return background(ray);
-            
+            return shade(ray, hit);
+        }
+
+        /// @return the color of the given ray, which intersects the
+        /// scene at \a hit.
+        Color shade(const Ray& ray, const RayHit& hit) {
+            Color res(0, 0, 0);
             // gestion de la réflexion et de la refraction
-            const Material& m = obj_i->getMaterial(p_i);
+            const Material& m = *hit.material;
             if(ray.depth > 0){
                 if(m.coef_reflexion != 0){
-                    Vector3 direction_refl = reflect(ray.direction, obj_i->getNormal(p_i));
-                    Ray ray_refl(p_i + direction_refl * 0.001f, direction_refl, ray.depth - 1);
+                    Vector3 direction_refl = reflect(ray.direction, hit.normal);
+                    Ray ray_refl(hit.point + direction_refl * 0.001f, direction_refl, ray.depth - 1);
                     Color C_refl = trace(ray_refl);
                     res += C_refl * m.specular * m.coef_reflexion;
                 }
                 if(m.coef_refraction != 0){
-                    Ray ray_refraction = refractionRay(ray, p_i, obj_i->getNormal(p_i), m);
+                    Ray ray_refraction = refractionRay(ray, hit.point, hit.normal, m);
                     if(ray_refraction.depth > 0){
                         Color C_refraction = trace(ray_refraction);
                         res += C_refraction * m.diffuse * m.coef_refraction;
@@ -201,13 +481,62 @@ namespace rt {
                 }
             }
 
-            res += illumination(ray, obj_i, p_i);
+            res += illumination(ray, hit);
+            return res;
+        }
+
+        /// The stochastic version of trace: at each hit, only one of the
+        /// reflected and refracted rays is followed, chosen in proportion
+        /// to its weight, and the path is stopped by Russian roulette
+        /// once its \a throughput (the weight of this ray in the pixel)
+        /// becomes small. The result is noisy but its expectation is the
+        /// color given by trace.
+        Color traceStochastic(const Ray& ray, Random& random, Color throughput) {
+            assert(ptrScene != nullptr);
+            RayHit hit;
+            if (!ptrScene->rayIntersection(ray, hit))
+                return background(ray);
+
+            const Material& m = *hit.material;
+            Color res = illumination(ray, hit, &random);
+            if (ray.depth == 0)
+                return res;
+            // the two possible branches and their weights
+            Ray ray_refl, ray_refraction;
+            Color w_refl, w_refraction;
+            Real p_refl = 0.0f, p_refraction = 0.0f;
+            if (m.coef_reflexion != 0) {
+                Vector3 direction_refl = reflect(ray.direction, hit.normal);
+                ray_refl = Ray(hit.point + direction_refl * 0.001f, direction_refl, ray.depth - 1);
+                w_refl = m.specular * m.coef_reflexion;
+                p_refl = w_refl.max();
+            }
+            if (m.coef_refraction != 0) {
+                ray_refraction = refractionRay(ray, hit.point, hit.normal, m);
+                if (ray_refraction.depth > 0) {
+                    w_refraction = m.diffuse * m.coef_refraction;
+                    p_refraction = w_refraction.max();
+                }
+            }
+            Real sum = p_refl + p_refraction;
+            if (sum <= 0.0f)
+                return res;
+            // the chosen branch is weighted by the inverse of its probability
+            bool is_refl = random.uniform() * sum < p_refl;
+            Color w = is_refl ? w_refl * (sum / p_refl) : w_refraction * (sum / p_refraction);
+            // Russian roulette: the path survives with probability q.
+            Color t = throughput * w;
+            Real q = std::min(1.0f, t.max());
+            if (random.uniform() >= q)
+                return res;
+            w = w * (1.0f / q);
+            res += traceStochastic(is_refl ? ray_refl : ray_refraction, random, t * (1.0f / q)) * w;
             return res;
         }
 
         /// Calcule le vecteur réfléchi à W selon la normale N.
         Vector3 reflect(const Vector3& W, Vector3 N) const {
-            return W - 2 * (W.dot(N)) * N;
+            return madd(W, -2 * (W.dot(N)), N);
         }
 
         Ray refractionRay( const Ray& aRay, const Point3& p, Vector3 N, const Material& m ){
@@ -226,59 +555,152 @@ namespace rt {
             if(x < 0)
                 return Ray(Point3(), Vector3(), -1);  // no refraction ray
 
-            Vector3 v_refract = r * V + ((Real) (r * c - (sqrt(x)))) * N;
-            v_refract = v_refract / v_refract.norm();
+            Vector3 v_refract = madd(r * V, (Real) (r * c - (sqrt(x))), N).normalized();
             return Ray(p + v_refract * 0.01f, v_refract, aRay.depth - 1);
         }
 
-        /// Calcule l'illumination de l'objet \a obj au point \a p, sachant que l'observateur est le rayon \a ray.
-        Color illumination(const Ray& ray, GraphicalObject *obj, Point3 p) {
-            Material m = obj->getMaterial(p);
+        /// Calcule l'illumination du point d'intersection \a hit, sachant que l'observateur est le rayon \a ray.
+        /// \a random choisit les lumieres echantillonnees (voir sampleLights).
+        Color illumination(const Ray& ray, const RayHit& hit, Random* random = nullptr) {
+            const Material& m = *hit.material;
+            const Point3& p = hit.point;
+            const Vector3& n = hit.normal;
+            Vector3 w = reflect(ray.direction, n);
             Color c;
-            for (auto l : ptrScene->myLights) {
-                Vector3 direction = l->direction(p);
-                Vector3 n = obj->getNormal(p);
-                Vector3 w = reflect(ray.direction, n);
-
+            sampleLights(ray, hit, random, [&](const Vector3& direction, const Color& light_color, Real d) {
                 //handle shadows
-                Color light_color = l->color(p);
-                light_color = shadow(Ray(p, direction), light_color);
+                addLight(c, ray, m, n, w, direction, shadow(Ray(p, direction), light_color, d));
+            });
+            c += m.ambient;
+            return c;
+        }
 
-                Real beta = w.dot(direction); // FIXME ? normalize vectors
-                if (beta >= 0.f) {
-                    // there is a specular color
-                    Real k_s = std::pow(beta, m.shinyness);
-                    c += light_color * m.specular * m.coef_reflexion * k_s;
+        /// Calls \a f( direction, color, distance ) for each light that
+        /// gets a shadow ray from the point of \a hit seen by \a ray (see
+        /// setLightSampling), where color is the color of the light
+        /// divided by the probability of choosing it. The lights behind
+        /// the point and its reflection, which add nothing, are skipped.
+        /// The choice is drawn with \a random, or with a generator seeded
+        /// from the point if 0.
+        template <typename F>
+        void sampleLights(const Ray& ray, const RayHit& hit, Random* random, F f) {
+            const Material& m = *hit.material;
+            const Point3& p = hit.point;
+            const Vector3& n = hit.normal;
+            Vector3 w = reflect(ray.direction, n);
+            const std::vector<Light*>& lights = ptrScene->myLights;
+            if (myShadowRays == 0 && myLightThreshold == 0.0f) {
+                for (Light* l : lights) {
+                    Vector3 direction = l->direction(p);
+                    if (w.dot(direction) < 0.f && direction.dot(n) <= 0.f) continue;
+                    f(direction, l->color(p), l->distance(p));
                 }
-                Real k_d = direction.dot(n); // FIXME ? normalize vectors
-                k_d = std::max(0.f, k_d);
-                if(ray.depth == 0){
-                    c += light_color * m.diffuse * k_d;
-                } else {
-                    c += light_color * m.diffuse * m.coef_diffusion * k_d;
+                return;
+            }
+            // @return the unshadowed contribution of the light, or 0 if culled.
+            auto weight = [&](const Vector3& direction, const Color& light_color) {
+                Color c;
+                addLight(c, ray, m, n, w, direction, light_color);
+                Real v = c.max();
+                return v > myLightThreshold ? v : 0.0f;
+            };
+            // The directions and contributions are kept for the choice.
+            static thread_local std::vector<std::pair<Vector3, Real>> evaluated;
+            evaluated.resize(lights.size());
+            Real total = 0.0f;
+            int nb = 0;
+            for (std::size_t i = 0; i < lights.size(); ++i) {
+                Vector3 direction = lights[i]->direction(p);
+                Real v = weight(direction, lights[i]->color(p));
+                evaluated[i] = std::make_pair(direction, v);
+                if (v > 0.0f) { total += v; ++nb; }
+            }
+            const bool all = myShadowRays == 0 || nb <= myShadowRays;
+            // Stratified choice: the samples are evenly spaced by step
+            // along the cumulated contributions, from a random offset.
+            const Real step = total / (Real) myShadowRays;
+            Real next = 0.0f;
+            if (!all)
+                next = step * (random != nullptr ? random->uniform() : Random(pointSeed(p)).uniform());
+            Real sum = 0.0f;
+            int k = 0;
+            for (std::size_t i = 0; i < lights.size() && nb > 0; ++i) {
+                const Vector3& direction = evaluated[i].first;
+                const Real v = evaluated[i].second;
+                if (v <= 0.0f) continue;
+                Light* l = lights[i];
+                Color light_color = l->color(p);
+                const bool last = --nb == 0;
+                if (all) {
+                    f(direction, light_color, l->distance(p));
+                    continue;
                 }
+                sum += v;
+                int count = 0;
+                for (; k < myShadowRays && (last || next < sum); ++k, next += step)
+                    ++count;
+                if (count > 0)
+                    f(direction, light_color * ((Real) count * step / v), l->distance(p));
+            }
+        }
+
+        /// @return a seed made of the bits of the coordinates of \a p.
+        static std::uint64_t pointSeed(const Point3& p) {
+            std::uint32_t b[3];
+            std::memcpy(b, &p[0], sizeof(b));
+            return ((std::uint64_t) b[0] << 32 | b[1]) ^ ((std::uint64_t) b[2] * 0x9E3779B97F4A7C15ULL);
+        }
+
+        /// Adds to \a c the specular and diffuse colors of material \a m,
+        /// of normal \a n, lit by \a light_color from \a direction, where
+        /// \a w is the reflection of \a ray (see illumination).
+        void addLight(Color& c, const Ray& ray, const Material& m, const Vector3& n,
+                      const Vector3& w, const Vector3& direction, const Color& light_color) const {
+            Real beta = w.dot(direction); // FIXME ? normalize vectors
+            if (beta >= 0.f) {
+                // there is a specular color
+                Real k_s = std::pow(beta, m.shinyness);
+                c += light_color * m.specular * m.coef_reflexion * k_s;
+            }
+            Real k_d = direction.dot(n); // FIXME ? normalize vectors
+            k_d = std::max(0.f, k_d);
+            if(ray.depth == 0){
+                c += light_color * m.diffuse * k_d;
+            } else {
+                c += light_color * m.diffuse * m.coef_diffusion * k_d;
             }
-            c += m.ambient;
-            return c;
         }
 
         /// Calcule la couleur de la lumière (donnée par light_color) dans la
-        /// direction donnée par le rayon. Si aucun objet n'est traversé,
-        /// retourne light_color, sinon si un des objets traversés est opaque,
-        /// retourne du noir, et enfin si les objets traversés sont
-        /// transparents, attenue la couleur.
-        Color shadow(const Ray& ray, Color light_color) {
+        /// direction donnée par le rayon, jusqu'à la distance tMax de la
+        /// lumière. Si aucun objet n'est traversé, retourne light_color,
+        /// sinon si un des objets traversés est opaque, retourne du noir,
+        /// et enfin si les objets traversés sont transparents, attenue la
+        /// couleur.
+        Color shadow(const Ray& ray, Color light_color,
+                     Real tMax = std::numeric_limits<Real>::infinity()) {
             Ray rayTmp = ray;
+            rayTmp.origin = madd(rayTmp.origin, 0.0001f, rayTmp.direction);  // on évite d'intersecter l'objet de départ
+            // Cas rapide : n'importe quel objet opaque suffit à faire de l'ombre.
+            bool transparent = false;
+            if (ptrScene->occluded(rayTmp, tMax, transparent))
+                return Color(0.0, 0.0, 0.0);
+            if (!transparent)
+                return light_color;
+            // Cas lent : on atténue la lumière par les objets transparents traversés.
             Color c = light_color;
+            bool first = true;
             while (c.max() > 0.003f) {  // tant que la couleur n'est pas noire
-                rayTmp.origin = rayTmp.origin + 0.0001f * rayTmp.direction;  // on évite d'intersecter l'objet de départ
-                GraphicalObject *obj_i = nullptr;  // pointer to intersected object
-                Point3 p_i;   // point of intersection
-
-                if (ptrScene->rayIntersection(rayTmp, obj_i, p_i) < 0.f) {
-                    Material m = obj_i->getMaterial(p_i);
+                if (!first)
+                    rayTmp.origin = madd(rayTmp.origin, 0.0001f, rayTmp.direction);
+                first = false;
+                RayHit hit;   // intersection with the closest object
+
+                if (ptrScene->rayIntersection(rayTmp, hit)
+                    && distance2(ray.origin, hit.point) < tMax * tMax) {
+                    const Material& m = *hit.material;
                     c = c * m.diffuse * m.coef_refraction;
-                    rayTmp.origin = p_i;
+                    rayTmp.origin = hit.point;
                 } else {
                     return c; // le rayon n'intersecte pas avec un objet
                 }
@@ -6,18 +6,36 @@
 #ifndef _SCENE_H_
 #define _SCENE_H_
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <set>
 #include <vector>
 #include "GraphicalObject.h"
+#include "Sphere.h"
+#include "SphereSet.h"
+#include "PeriodicPlane.h"
+#include "TriangleMesh.h"
+#include "Instance.h"
 #include "Light.h"
+#include "BVH.h"
 
 /// Namespace RayTracer
 namespace rt {
 
 /**
-  Models a scene, i.e. a collection of lights and graphical objects
-  (could be a tree, but we keep a list for now for the sake of
-  simplicity).
+  Models a scene, i.e. a collection of lights and graphical objects.
+  Once prepare() has been called, bounded objects are searched through
+  a bounding volume hierarchy while unbounded ones (planes) are kept in
+  a small list tested separately. The objects of the types listed in
+  ObjectType are called without virtual dispatch (see intersect()).
+  The geometries shared by Instance objects have their own structures,
+  below the hierarchy of the scene.
+
+  Once prepared, the scene may still be edited between two renders by
+  addObject(), moveObject() (or updateObject()) and removeObject(): the
+  hierarchy is refit and only partly rebuilt (see BVH::update). The
+  lights are not in the hierarchy and may be moved freely.
 
   @note Once the scene receives a new object, it owns the object and
   is thus responsible for its deallocation.
@@ -28,9 +46,29 @@ struct Scene {
     std::vector< Light* > myLights;
     /// The list of objects modelled as a vector.
     std::vector< GraphicalObject* > myObjects;
+    /// The objects with a bounding box, in the order of myBVH primitives.
+    std::vector< GraphicalObject* > myBoundedObjects;
+    /// The objects without bounding box, tested one by one.
+    std::vector< GraphicalObject* > myUnboundedObjects;
+    /// The types of myBoundedObjects and myUnboundedObjects.
+    std::vector< ObjectType > myBoundedTypes, myUnboundedTypes;
+    /// The materials of the objects, shared by prepare().
+    MaterialTable myMaterials;
+    /// The bounding boxes of myBoundedObjects.
+    std::vector< BoundingBox > myBoxes;
+    /// The hierarchy over myBoundedObjects.
+    BVH myBVH;
+    /// 'true' when the hierarchy is up to date with myObjects.
+    bool myIsPrepared;
+    /// Incremented each time prepare() rebuilds the structures, e.g. to
+    /// know that hits kept by a GBuffer are obsolete.
+    unsigned int myVersion;
+    /// Incremented each time the materials are shared again, by
+    /// prepare() or updateMaterials().
+    unsigned int myMaterialsVersion;
 
     /// Default constructor. Nothing to do.
-    Scene() {}
+    Scene() : myIsPrepared( false ), myVersion( 0 ), myMaterialsVersion( 0 ) {}
 
     /// Destructor. Frees objects.
     ~Scene()
@@ -42,33 +80,178 @@ struct Scene {
         // The vector is automatically deleted.
     }
 
-    /// This function calls the init method of each of its objects.
-    void init( Viewer& viewer )
+    /// Adds a new object to the scene. If the scene is prepared, the
+    /// object is prepared and inserted in the hierarchy, which is not
+    /// rebuilt.
+    void addObject( GraphicalObject* anObject )
     {
-        for ( GraphicalObject* obj : myObjects )
-            obj->init( viewer );
-        for ( Light* light : myLights )
-            light->init( viewer );
+        myObjects.push_back( anObject );
+        if ( ! myIsPrepared ) return;
+        ++myVersion;
+        std::set< GraphicalObject* > geometries;
+        prepareGeometry( anObject, geometries );
+        anObject->internMaterials( myMaterials );
+        anObject->prepare();
+        BoundingBox box;
+        if ( anObject->getBoundingBox( box ) ) {
+            myBoundedObjects.push_back( anObject );
+            myBoundedTypes.push_back( anObject->objectType() );
+            myBoxes.push_back( box );
+            myBVH.insert( myBoxes );
+        } else {
+            myUnboundedObjects.push_back( anObject );
+            myUnboundedTypes.push_back( anObject->objectType() );
+        }
     }
-    /// This function calls the draw method of each of its objects.
-    void draw( Viewer& viewer )
+
+    /// Moves the instance \a anInstance with the transform \a transform
+    /// and updates the hierarchy, see updateObject().
+    void moveObject( Instance* anInstance, const Transform& transform )
     {
-        for ( GraphicalObject* obj : myObjects )
-            obj->draw( viewer );
-        for ( Light* light : myLights )
-            light->draw( viewer );
+        anInstance->setTransform( transform );
+        updateObject( anInstance );
     }
-    /// This function calls the light method of each of its lights
-    void light(Viewer& viewer )
+
+    /// Updates the scene once \a anObject has been moved or resized
+    /// (e.g. the center of a Sphere changed): the object is prepared
+    /// again, then the hierarchy is refit, and only its subtrees that
+    /// degraded too much are rebuilt (see BVH::update).
+    void updateObject( GraphicalObject* anObject )
     {
-        for ( Light* light : myLights )
-            light->light( viewer );
+        if ( ! myIsPrepared ) return;
+        ++myVersion;
+        anObject->prepare();
+        auto it = std::find( myBoundedObjects.begin(), myBoundedObjects.end(), anObject );
+        if ( it == myBoundedObjects.end() ) return;
+        const int i = (int) ( it - myBoundedObjects.begin() );
+        anObject->getBoundingBox( myBoxes[ i ] );
+        myBVH.update( myBoxes, i );
     }
 
-    /// Adds a new object to the scene.
-    void addObject( GraphicalObject* anObject )
+    /// Same as updateObject() for all the objects at once, e.g. after
+    /// moving many of them for the next frame of an animation.
+    void updateObjects()
     {
-        myObjects.push_back( anObject );
+        if ( ! myIsPrepared ) return;
+        ++myVersion;
+        for ( std::size_t i = 0; i < myBoundedObjects.size(); ++i ) {
+            myBoundedObjects[ i ]->prepare();
+            myBoundedObjects[ i ]->getBoundingBox( myBoxes[ i ] );
+        }
+        for ( GraphicalObject* obj : myUnboundedObjects )
+            obj->prepare();
+        myBVH.update( myBoxes );
+    }
+
+    /// Removes \a anObject from the scene and deletes it. If the scene
+    /// is prepared, the object is removed from the hierarchy, which is
+    /// not rebuilt (its materials stay in myMaterials until the next
+    /// preparation).
+    void removeObject( GraphicalObject* anObject )
+    {
+        auto it = std::find( myObjects.begin(), myObjects.end(), anObject );
+        if ( it == myObjects.end() ) return;
+        myObjects.erase( it );
+        if ( myIsPrepared ) {
+            ++myVersion;
+            auto b = std::find( myBoundedObjects.begin(), myBoundedObjects.end(), anObject );
+            if ( b != myBoundedObjects.end() ) {
+                // the last object takes its place, as in BVH::remove.
+                const std::size_t i = b - myBoundedObjects.begin();
+                myBoundedObjects[ i ] = myBoundedObjects.back();
+                myBoundedTypes[ i ]   = myBoundedTypes.back();
+                myBoxes[ i ]          = myBoxes.back();
+                myBoundedObjects.pop_back();
+                myBoundedTypes.pop_back();
+                myBoxes.pop_back();
+                myBVH.remove( myBoxes, (int) i );
+            } else {
+                auto u = std::find( myUnboundedObjects.begin(), myUnboundedObjects.end(), anObject );
+                myUnboundedTypes.erase( myUnboundedTypes.begin() + ( u - myUnboundedObjects.begin() ) );
+                myUnboundedObjects.erase( u );
+            }
+        }
+        delete anObject;
+    }
+
+    /// Shares the materials of the objects through myMaterials, prepares
+    /// the objects (and once each geometry of the instances) and builds
+    /// the acceleration structures.
+    /// Must be called (out of any rendering thread) once objects have
+    /// been added, otherwise rayIntersection falls back to testing every
+    /// object.
+    /// @param hierarchy if not 0, the hierarchy over the bounded objects
+    /// built by a previous preparation of the same scene (e.g. read from
+    /// a SceneCache), used instead of building it.
+    void prepare( const BVH* hierarchy = nullptr )
+    {
+        if ( myIsPrepared ) return;
+        myBoundedObjects.clear();
+        myUnboundedObjects.clear();
+        myBoundedTypes.clear();
+        myUnboundedTypes.clear();
+        myMaterials.clear();
+        myBoxes.clear();
+        ++myVersion;
+        ++myMaterialsVersion;
+        std::set< GraphicalObject* > geometries;
+        for ( GraphicalObject* obj : myObjects ) {
+            prepareGeometry( obj, geometries );
+            obj->internMaterials( myMaterials );
+            obj->prepare();
+            BoundingBox box;
+            if ( obj->getBoundingBox( box ) ) {
+                myBoundedObjects.push_back( obj );
+                myBoundedTypes.push_back( obj->objectType() );
+                myBoxes.push_back( box );
+            } else {
+                myUnboundedObjects.push_back( obj );
+                myUnboundedTypes.push_back( obj->objectType() );
+            }
+        }
+        if ( hierarchy != nullptr )
+            myBVH = *hierarchy;
+        else
+            myBVH.build( myBoxes );
+        myIsPrepared = true;
+    }
+
+    /// Prepares the geometry of \a obj if it is an Instance (and
+    /// recursively), unless it is in \a geometries, which lists the
+    /// geometries already prepared.
+    void prepareGeometry( GraphicalObject* obj, std::set< GraphicalObject* >& geometries )
+    {
+        if ( obj->objectType() != ObjectType::Instance ) return;
+        GraphicalObject* geometry = static_cast< Instance* >( obj )->geometry().get();
+        if ( ! geometries.insert( geometry ).second ) return;
+        prepareGeometry( geometry, geometries );
+        geometry->internMaterials( myMaterials );
+        geometry->prepare();
+    }
+
+    /// Shares again the materials of the objects, once they have been
+    /// edited, without rebuilding the hierarchies: the hits kept by a
+    /// GBuffer stay valid, only their materials are read again.
+    void updateMaterials()
+    {
+        if ( ! myIsPrepared ) return;
+        myMaterials.clear();
+        ++myMaterialsVersion;
+        std::set< GraphicalObject* > geometries;
+        for ( GraphicalObject* obj : myObjects ) {
+            internGeometryMaterials( obj, geometries );
+            obj->internMaterials( myMaterials );
+        }
+    }
+
+    /// Same as prepareGeometry() for the materials only.
+    void internGeometryMaterials( GraphicalObject* obj, std::set< GraphicalObject* >& geometries )
+    {
+        if ( obj->objectType() != ObjectType::Instance ) return;
+        GraphicalObject* geometry = static_cast< Instance* >( obj )->geometry().get();
+        if ( ! geometries.insert( geometry ).second ) return;
+        internGeometryMaterials( geometry, geometries );
+        geometry->internMaterials( myMaterials );
     }
 
     /// Adds a new light to the scene.
@@ -77,30 +260,162 @@ struct Scene {
         myLights.push_back( aLight );
     }
     
-    /// returns the closest object intersected by the given ray.
-    /// p is the point where intersection happened
-    /// return negative value if an intersection happened else a positive one
-    Real
-    rayIntersection( const Ray& ray,
-                     GraphicalObject*& object, Point3& p )
-    {
-        Real minDistance = 0.0f;
-        Point3 pTmp;
+    /// Looks for the closest object intersected by the given ray.
+    /// Only intersections closer than \a hit.t are considered; the
+    /// intersection found (if any) is stored in \a hit.
+    /// @return 'true' if an intersection was found.
+    bool
+    rayIntersection( const Ray& ray, RayHit& hit )
+    {
+        if ( ! myIsPrepared )
+            return linearRayIntersection( myObjects, ray, hit );
+        // hit.t is the bound of the traversal, and objects update it.
+        bool hasTouch = myBVH.closestHit( ray, hit.t, [&] ( int i, Real& /* t */ ) {
+            return intersect( myBoundedObjects[ i ], myBoundedTypes[ i ], ray, hit );
+        } );
+        for ( std::size_t i = 0; i < myUnboundedObjects.size(); ++i )
+            if ( intersect( myUnboundedObjects[ i ], myUnboundedTypes[ i ], ray, hit ) )
+                hasTouch = true;
+        return hasTouch;
+    }
+
+    /// Packet version of rayIntersection: looks for the closest object
+    /// intersected by each ray of \a packet, and stores its
+    /// intersection in \a hits[i]. Coherent packets are traced
+    /// together, then the hits are completed ray by ray; others are
+    /// traced ray by ray.
+    /// @return a mask whose bit \a i is set if ray \a i hits something.
+    int
+    rayIntersection( const RayPacket& packet, RayHit hits[ RayPacket::SIZE ] )
+    {
+        int found = 0;
+        if ( ! myIsPrepared || ! packet.coherent ) {
+            for ( int i = 0; i < RayPacket::SIZE; ++i )
+                if ( rayIntersection( packet.rays[ i ], hits[ i ] ) )
+                    found |= 1 << i;
+            return found;
+        }
+        RayPacketHit packet_hit;
+        for ( int i = 0; i < RayPacket::SIZE; ++i )
+            packet_hit.t[ i ] = hits[ i ].t;
+        myBVH.closestHit( packet, packet_hit, [&] ( int i ) {
+            packetIntersect( myBoundedObjects[ i ], myBoundedTypes[ i ], packet, packet_hit );
+        } );
+        for ( std::size_t i = 0; i < myUnboundedObjects.size(); ++i )
+            packetIntersect( myUnboundedObjects[ i ], myUnboundedTypes[ i ], packet, packet_hit );
+        // Only the closest object computes the point, normal, etc.
+        for ( int i = 0; i < RayPacket::SIZE; ++i ) {
+            GraphicalObject* obj = packet_hit.object[ i ];
+            if ( obj == nullptr ) continue;
+            if ( obj->rayIntersection( packet.rays[ i ], hits[ i ] )
+                 || rayIntersection( packet.rays[ i ], hits[ i ] ) )
+                found |= 1 << i;
+        }
+        return found;
+    }
+
+    /// Any-hit query for shadow rays: returns 'true' as soon as an
+    /// opaque object is hit before \a tMax. Sets \a transparent to
+    /// 'true' if transparent objects are crossed before \a tMax, in
+    /// which case the caller has to compute their attenuation.
+    bool occluded( const Ray& ray, Real tMax, bool& transparent )
+    {
+        if ( ! myIsPrepared ) {
+            for ( GraphicalObject* obj : myObjects )
+                if ( obj->occluded( ray, tMax, transparent ) ) return true;
+            return false;
+        }
+        for ( std::size_t i = 0; i < myUnboundedObjects.size(); ++i )
+            if ( occludedBy( myUnboundedObjects[ i ], myUnboundedTypes[ i ], ray, tMax, transparent ) )
+                return true;
+        return myBVH.anyHit( ray, tMax, [&] ( int i ) {
+            return occludedBy( myBoundedObjects[ i ], myBoundedTypes[ i ], ray, tMax, transparent );
+        } );
+    }
+
+    /// Same as above when transparency does not matter.
+    bool occluded( const Ray& ray, Real tMax )
+    {
+        bool transparent = false;
+        return occluded( ray, tMax, transparent );
+    }
+
+    /// Looks for the closest object of \a objects intersected by the
+    /// given ray, by testing all of them. Same conventions as
+    /// rayIntersection.
+    static bool
+    linearRayIntersection( const std::vector< GraphicalObject* >& objects,
+                           const Ray& ray, RayHit& hit )
+    {
         bool hasTouch = false;
+        for ( GraphicalObject* obj : objects )
+            if ( obj->rayIntersection( ray, hit ) )
+                hasTouch = true;
+        return hasTouch;
+    }
 
-        //        std::cout << "wow : " << myObjects.size() << std::endl;
-        for (unsigned long i = 0; i < myObjects.size(); i++) {
-            if (myObjects.at(i)->rayIntersection(ray, pTmp) < 0.f) {
-                Real dTmp = distance2(ray.origin, pTmp);
-                if (!hasTouch || dTmp < minDistance) {
-                    hasTouch = true;
-                    minDistance = dTmp;
-                    object = myObjects.at(i);
-                    p = pTmp;
-                }
-            }
+    /// Calls the rayIntersection method of \a obj, of type \a type,
+    /// directly for the known types (they are final classes, or
+    /// PeriodicPlane whose subclasses keep its intersection).
+    static bool
+    intersect( GraphicalObject* obj, ObjectType type, const Ray& ray, RayHit& hit )
+    {
+        switch ( type ) {
+        case ObjectType::Sphere:
+            return static_cast< Sphere* >( obj )->Sphere::rayIntersection( ray, hit );
+        case ObjectType::SphereSet:
+            return static_cast< SphereSet* >( obj )->SphereSet::rayIntersection( ray, hit );
+        case ObjectType::PeriodicPlane:
+            return static_cast< PeriodicPlane* >( obj )->PeriodicPlane::rayIntersection( ray, hit );
+        case ObjectType::TriangleMesh:
+            return static_cast< TriangleMesh* >( obj )->TriangleMesh::rayIntersection( ray, hit );
+        case ObjectType::Instance:
+            return static_cast< Instance* >( obj )->Instance::rayIntersection( ray, hit );
+        default:
+            return obj->rayIntersection( ray, hit );
+        }
+    }
+
+    /// Same as intersect() for the occluded method.
+    static bool
+    occludedBy( GraphicalObject* obj, ObjectType type, const Ray& ray, Real tMax, bool& transparent )
+    {
+        switch ( type ) {
+        case ObjectType::Sphere:
+            return static_cast< Sphere* >( obj )->Sphere::occluded( ray, tMax, transparent );
+        case ObjectType::SphereSet:
+            return static_cast< SphereSet* >( obj )->SphereSet::occluded( ray, tMax, transparent );
+        case ObjectType::PeriodicPlane:
+            return static_cast< PeriodicPlane* >( obj )->PeriodicPlane::occluded( ray, tMax, transparent );
+        case ObjectType::TriangleMesh:
+            return static_cast< TriangleMesh* >( obj )->TriangleMesh::occluded( ray, tMax, transparent );
+        case ObjectType::Instance:
+            return static_cast< Instance* >( obj )->Instance::occluded( ray, tMax, transparent );
+        default:
+            return obj->occluded( ray, tMax, transparent );
+        }
+    }
+
+    /// Same as intersect() for the packetIntersection method.
+    static void
+    packetIntersect( GraphicalObject* obj, ObjectType type, const RayPacket& packet, RayPacketHit& hit )
+    {
+        switch ( type ) {
+        case ObjectType::Sphere:
+            static_cast< Sphere* >( obj )->Sphere::packetIntersection( packet, hit );
+            break;
+        case ObjectType::SphereSet:
+            static_cast< SphereSet* >( obj )->SphereSet::packetIntersection( packet, hit );
+            break;
+        case ObjectType::PeriodicPlane:
+            static_cast< PeriodicPlane* >( obj )->PeriodicPlane::packetIntersection( packet, hit );
+            break;
+        case ObjectType::TriangleMesh:
+            static_cast< TriangleMesh* >( obj )->TriangleMesh::packetIntersection( packet, hit );
+            break;
+        default:
+            obj->packetIntersection( packet, hit );
         }
-        return hasTouch ? -1.0f : 1.0f;
     }
 
         private:
@@ -0,0 +1,330 @@
+/**
+@file SceneCache.cpp
+*/
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <type_traits>
+#include "SceneCache.h"
+#include "MappedFile.h"
+#include "WaterPlane.h"
+
+namespace {
+  using namespace rt;
+
+  /// The first bytes of a cache (the last one is its version).
+  const char MAGIC[ 8 ] = { 'R', 'T', 'C', 'A', 'C', 'H', 'E', 2 };
+
+  /// The kinds of sections. Those of a mesh or a water plane exist once
+  /// per mesh or plane, numbered by CacheSection::index.
+  enum class SectionKind : std::uint32_t {
+    Description,     ///< SceneDescription::writeBinary
+    MeshOfRecord,    ///< int32: the mesh of each record of the description
+    Vertices,        ///< Point3
+    Normals,         ///< Vector3
+    Triangles,       ///< TriangleMesh::Triangle
+    MeshNodes,       ///< BVHNode
+    MeshIndices,     ///< int
+    Corners,         ///< Point3, see TriangleMesh::corners
+    TriangleIndex,   ///< int, see TriangleMesh::triangleIndex
+    NoiseParameters, ///< int32: resolution and period
+    NoiseSamples,    ///< float
+    SceneNodes,      ///< BVHNode
+    SceneIndices     ///< int
+  };
+
+  /// @return the sizes of the elements of the arrays copied bytewise,
+  /// which depend on the build (e.g. a Point3 has 4 floats with SSE, 3
+  /// with RT_NO_SIMD): a cache is only read by a build of same layout.
+  std::uint32_t arrayLayout()
+  {
+    return (std::uint32_t) ( sizeof( Point3 ) | sizeof( BVHNode ) << 8
+                             | sizeof( TriangleMesh::Triangle ) << 16 );
+  }
+
+  struct CacheHeader {
+    char magic[ 8 ];
+    std::uint32_t nb_sections;
+    /// The layout of the arrays, see arrayLayout().
+    std::uint32_t layout;
+  };
+
+  struct CacheSection {
+    SectionKind kind;
+    std::uint32_t index;
+    /// From the start of the file, in bytes.
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  /// Alignment of the arrays in the file.
+  const std::uint64_t ALIGNMENT = 16;
+
+  static_assert( std::is_trivially_copyable< BVHNode >::value
+                 && std::is_trivially_copyable< Point3 >::value
+                 && std::is_trivially_copyable< TriangleMesh::Triangle >::value,
+                 "the arrays of the cache are copied bytewise" );
+
+  /// The sections of a cache being written, pointing to their data.
+  struct CacheWriter {
+    std::vector< CacheSection > sections;
+    std::vector< const void* > data;
+
+    template <typename T>
+    void add( SectionKind kind, std::uint32_t index, const std::vector< T >& v )
+    {
+      CacheSection s = { kind, index, 0, v.size() * sizeof( T ) };
+      sections.push_back( s );
+      data.push_back( v.data() );
+    }
+
+    bool write( const std::string& file_name )
+    {
+      CacheHeader h;
+      std::memcpy( h.magic, MAGIC, sizeof( MAGIC ) );
+      h.nb_sections = (std::uint32_t) sections.size();
+      h.layout      = arrayLayout();
+      std::uint64_t offset = sizeof( h ) + sections.size() * sizeof( CacheSection );
+      for ( CacheSection& s : sections ) {
+        offset   = ( offset + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+        s.offset = offset;
+        offset  += s.size;
+      }
+      std::ofstream output( file_name.c_str(), std::ofstream::binary );
+      output.write( reinterpret_cast<const char*>( &h ), sizeof( h ) );
+      output.write( reinterpret_cast<const char*>( sections.data() ),
+                    sections.size() * sizeof( CacheSection ) );
+      std::uint64_t position = sizeof( h ) + sections.size() * sizeof( CacheSection );
+      const char padding[ ALIGNMENT ] = { 0 };
+      for ( std::size_t i = 0; i < sections.size(); ++i ) {
+        output.write( padding, sections[ i ].offset - position );
+        output.write( static_cast<const char*>( data[ i ] ), sections[ i ].size );
+        position = sections[ i ].offset + sections[ i ].size;
+      }
+      return output.good();
+    }
+  };
+
+  /// The sections of a mapped cache.
+  struct CacheReader {
+    const MappedFile& file;
+    std::map< std::pair< SectionKind, std::uint32_t >, CacheSection > sections;
+
+    explicit CacheReader( const MappedFile& f ) : file( f ) {}
+
+    /// Reads the table of sections. @return 'false' if it is not valid.
+    bool open()
+    {
+      CacheHeader h;
+      if ( file.data == nullptr || file.size < sizeof( h ) ) return false;
+      std::memcpy( &h, file.data, sizeof( h ) );
+      if ( std::memcmp( h.magic, MAGIC, sizeof( MAGIC ) ) != 0 || h.layout != arrayLayout()
+           || h.nb_sections > ( file.size - sizeof( h ) ) / sizeof( CacheSection ) )
+        return false;
+      for ( std::uint32_t i = 0; i < h.nb_sections; ++i ) {
+        CacheSection s;
+        std::memcpy( &s, file.data + sizeof( h ) + i * sizeof( CacheSection ), sizeof( s ) );
+        if ( s.offset > file.size || s.size > file.size - s.offset ) return false;
+        sections[ std::make_pair( s.kind, s.index ) ] = s;
+      }
+      return true;
+    }
+
+    /// Copies the section ( \a kind, \a index ) into \a v.
+    /// @return 'false' if there is no such section or its size is wrong.
+    template <typename T>
+    bool get( SectionKind kind, std::uint32_t index, std::vector< T >& v ) const
+    {
+      auto it = sections.find( std::make_pair( kind, index ) );
+      if ( it == sections.end() || it->second.size % sizeof( T ) != 0 ) return false;
+      v.resize( it->second.size / sizeof( T ) );
+      if ( ! v.empty() ) std::memcpy( v.data(), file.data + it->second.offset, it->second.size );
+      return true;
+    }
+  };
+
+  /// @return the water planes of \a scene, in the order of its objects.
+  std::vector< WaterPlane* > waterPlanes( const Scene& scene )
+  {
+    std::vector< WaterPlane* > planes;
+    for ( GraphicalObject* obj : scene.myObjects )
+      if ( WaterPlane* water = dynamic_cast< WaterPlane* >( obj ) )
+        planes.push_back( water );
+    return planes;
+  }
+
+  /// @return 'true' if \a nodes and \a indices form a hierarchy over \a
+  /// n primitives: the nodes are a tree stored depth first, i.e. the
+  /// children of an inner node i are i+1 and its offset, which follows
+  /// the subtree of i+1, so that a traversal ends, and its axis indexes
+  /// the coordinates of a ray.
+  bool validHierarchy( const std::vector< BVHNode >& nodes, const std::vector< int >& indices, int n )
+  {
+    if ( (int) indices.size() != n || ( nodes.empty() && n > 0 ) ) return false;
+    const int size = (int) nodes.size();
+    // the second children still to come, the next one last.
+    std::vector< int > pending;
+    for ( int i = 0; i < size; ++i ) {
+      const BVHNode& node = nodes[ i ];
+      if ( node.count < 0 || node.offset < 0 ) return false;
+      if ( node.count == 0 ) {
+        if ( node.axis < 0 || node.axis >= 3
+             || i + 1 >= size || node.offset <= i + 1 || node.offset >= size
+             || ( ! pending.empty() && node.offset > pending.back() ) )
+          return false;
+        pending.push_back( node.offset );
+      } else {
+        if ( node.offset + node.count > n ) return false;
+        // a leaf ends a subtree, the next node must be a second child.
+        if ( i + 1 < size ) {
+          if ( pending.empty() || pending.back() != i + 1 ) return false;
+          pending.pop_back();
+        }
+      }
+    }
+    if ( ! pending.empty() ) return false;
+    for ( int i : indices )
+      if ( i < 0 || i >= n ) return false;
+    return true;
+  }
+
+} // namespace
+
+bool
+rt::SceneCache::isCache( const std::string& file_name )
+{
+  char magic[ sizeof( MAGIC ) ] = { 0 };
+  std::ifstream input( file_name.c_str(), std::ifstream::binary );
+  input.read( magic, sizeof( magic ) );
+  return input.good() && std::memcmp( magic, MAGIC, sizeof( MAGIC ) ) == 0;
+}
+
+bool
+rt::SceneCache::write( const std::string& file_name, const SceneDescription& description,
+                       const std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects,
+                       Scene& scene )
+{
+  scene.prepare();
+  CacheWriter writer;
+  std::ostringstream text;
+  description.writeBinary( text );
+  const std::string description_data = text.str();
+  const std::vector< char > description_bytes( description_data.begin(), description_data.end() );
+  writer.add( SectionKind::Description, 0, description_bytes );
+  // Each mesh is stored once, numbered in the order of the records.
+  std::map< const TriangleMesh*, std::int32_t > numbers;
+  std::vector< std::int32_t > mesh_of_record;
+  for ( const std::shared_ptr<TriangleMesh>& mesh : mesh_objects ) {
+    auto it = numbers.find( mesh.get() );
+    if ( it == numbers.end() ) {
+      const std::uint32_t k = (std::uint32_t) numbers.size();
+      it = numbers.insert( std::make_pair( mesh.get(), (std::int32_t) k ) ).first;
+      writer.add( SectionKind::Vertices, k, mesh->vertices );
+      writer.add( SectionKind::Normals, k, mesh->normals );
+      writer.add( SectionKind::Triangles, k, mesh->triangles );
+      writer.add( SectionKind::MeshNodes, k, mesh->hierarchy().nodes );
+      writer.add( SectionKind::MeshIndices, k, mesh->hierarchy().indices );
+      writer.add( SectionKind::Corners, k, mesh->corners() );
+      writer.add( SectionKind::TriangleIndex, k, mesh->triangleIndex() );
+    }
+    mesh_of_record.push_back( it->second );
+  }
+  writer.add( SectionKind::MeshOfRecord, 0, mesh_of_record );
+  std::vector< WaterPlane* > planes = waterPlanes( scene );
+  std::vector< std::vector< std::int32_t > > noise_parameters( planes.size() );
+  for ( std::size_t k = 0; k < planes.size(); ++k ) {
+    const NoiseVolume& noise = planes[ k ]->myNoise;
+    if ( noise.empty() ) continue;
+    noise_parameters[ k ] = { noise.resolution(), noise.period() };
+    writer.add( SectionKind::NoiseParameters, (std::uint32_t) k, noise_parameters[ k ] );
+    writer.add( SectionKind::NoiseSamples, (std::uint32_t) k, noise.samples() );
+  }
+  writer.add( SectionKind::SceneNodes, 0, scene.myBVH.nodes );
+  writer.add( SectionKind::SceneIndices, 0, scene.myBVH.indices );
+  if ( ! writer.write( file_name ) ) {
+    std::cerr << "[SceneCache::write] Cannot write " << file_name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+rt::SceneCache::read( const std::string& file_name, SceneDescription& description, Scene& scene )
+{
+  MappedFile file( file_name );
+  CacheReader reader( file );
+  std::vector< char > description_bytes;
+  std::vector< std::int32_t > mesh_of_record;
+  bool ok = reader.open()
+    && reader.get( SectionKind::Description, 0, description_bytes )
+    && description.readBinary( description_bytes.data(), description_bytes.size() )
+    && reader.get( SectionKind::MeshOfRecord, 0, mesh_of_record )
+    && mesh_of_record.size() == description.meshes.size();
+  // The meshes are restored with their hierarchies.
+  std::vector< std::shared_ptr<TriangleMesh> > meshes, mesh_objects;
+  for ( std::size_t i = 0; ok && i < mesh_of_record.size(); ++i ) {
+    const std::int32_t k = mesh_of_record[ i ];
+    ok = k >= 0 && k <= (std::int32_t) meshes.size();
+    if ( ok && k == (std::int32_t) meshes.size() ) {
+      auto mesh = std::make_shared<TriangleMesh>( description.material( description.meshes[ i ].material ) );
+      BVH bvh;
+      std::vector< Point3 > corners;
+      std::vector< int > triangle_index;
+      ok = reader.get( SectionKind::Vertices, k, mesh->vertices )
+        && reader.get( SectionKind::Normals, k, mesh->normals )
+        && reader.get( SectionKind::Triangles, k, mesh->triangles )
+        && reader.get( SectionKind::MeshNodes, k, bvh.nodes )
+        && reader.get( SectionKind::MeshIndices, k, bvh.indices )
+        && reader.get( SectionKind::Corners, k, corners )
+        && reader.get( SectionKind::TriangleIndex, k, triangle_index );
+      const int n = mesh->size();
+      ok = ok && validHierarchy( bvh.nodes, bvh.indices, n )
+        && corners.size() == 3 * (std::size_t) n && triangle_index.size() == (std::size_t) n;
+      // the normals of a triangle are all given (indices of normals) or
+      // none (-1, flat triangle).
+      for ( const TriangleMesh::Triangle& tri : mesh->triangles )
+        for ( int j = 0; ok && j < 3; ++j )
+          ok = tri.v[ j ] >= 0 && tri.v[ j ] < (int) mesh->vertices.size()
+            && ( tri.n[ 0 ] == -1
+                 ? tri.n[ j ] == -1
+                 : tri.n[ j ] >= 0 && tri.n[ j ] < (int) mesh->normals.size() );
+      for ( int i : triangle_index )
+        ok = ok && i >= 0 && i < n;
+      if ( ok ) mesh->setHierarchy( std::move( bvh ), std::move( corners ), std::move( triangle_index ) );
+      meshes.push_back( mesh );
+    }
+    if ( ok ) mesh_objects.push_back( meshes[ k ] );
+  }
+  BVH bvh;
+  ok = ok && reader.get( SectionKind::SceneNodes, 0, bvh.nodes )
+    && reader.get( SectionKind::SceneIndices, 0, bvh.indices );
+  if ( ! ok ) {
+    std::cerr << "[SceneCache::read] Invalid file " << file_name << std::endl;
+    return false;
+  }
+  description.build( scene, mesh_objects );
+  // The noise is kept if its resolution is still the one of the plane.
+  std::vector< WaterPlane* > planes = waterPlanes( scene );
+  for ( std::size_t k = 0; k < planes.size(); ++k ) {
+    std::vector< std::int32_t > parameters;
+    std::vector< float > samples;
+    if ( reader.get( SectionKind::NoiseParameters, (std::uint32_t) k, parameters )
+         && parameters.size() == 2 && parameters[ 0 ] > 0
+         && parameters[ 0 ] == planes[ k ]->myNoiseResolution
+         && parameters[ 1 ] == planes[ k ]->myNoisePeriod
+         && reader.get( SectionKind::NoiseSamples, (std::uint32_t) k, samples )
+         && samples.size() == (std::size_t) parameters[ 0 ] * parameters[ 0 ] * parameters[ 0 ] )
+      planes[ k ]->myNoise.assign( parameters[ 0 ], parameters[ 1 ], std::move( samples ) );
+  }
+  scene.prepare( &bvh );
+  // A hierarchy that does not match the objects is rebuilt.
+  if ( ! validHierarchy( bvh.nodes, bvh.indices, (int) scene.myBoundedObjects.size() ) ) {
+    std::cerr << "[SceneCache::read] Rebuilding the hierarchy of " << file_name << std::endl;
+    scene.myIsPrepared = false;
+    scene.prepare();
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+/**
+@file SceneCache.h
+*/
+#pragma once
+#ifndef _SCENE_CACHE_H_
+#define _SCENE_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Scene.h"
+#include "SceneFile.h"
+#include "TriangleMesh.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A binary file holding a scene once built and prepared: its
+  /// description (materials, lights, objects, camera and settings, see
+  /// SceneDescription), the triangles of its meshes with their
+  /// hierarchies, the precomputed noise of its water planes and the
+  /// hierarchy of the scene. A render worker reads it and renders at
+  /// once, without reading the OBJ files nor building any hierarchy.
+  ///
+  /// The file is a table of sections, located by their offsets from
+  /// the start of the file, followed by the arrays of the sections
+  /// (aligned on 16 bytes, in the byte order of the machine). It is
+  /// mapped in memory and each array is copied at once into the
+  /// objects of the scene.
+  struct SceneCache {
+
+    /// @return 'true' if \a file_name starts like a scene cache.
+    static bool isCache( const std::string& file_name );
+
+    /// Writes the cache of \a scene into \a file_name. The scene must
+    /// have been built by \a description with the meshes \a
+    /// mesh_objects (see SceneDescription::build), it is prepared if
+    /// needed.
+    /// @return 'false' in case of error.
+    static bool write( const std::string& file_name, const SceneDescription& description,
+                       const std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects,
+                       Scene& scene );
+
+    /// Reads the cache \a file_name into \a description, and builds and
+    /// prepares \a scene, which should be empty. The precomputed noise
+    /// is used only if the noise resolution of the description was not
+    /// changed since the cache was written.
+    /// @return 'false' if the file cannot be read or is not valid.
+    static bool read( const std::string& file_name, SceneDescription& description, Scene& scene );
+  };
+
+} // namespace rt
+
+#endif // #define _SCENE_CACHE_H_
@@ -0,0 +1,486 @@
+/**
+@file SceneFile.cpp
+*/
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+#include "SceneFile.h"
+#include "DemoScene.h"
+#include "Instance.h"
+#include "MappedFile.h"
+#include "PointLight.h"
+#include "TriangleMesh.h"
+#include "WaterPlane.h"
+
+namespace {
+  using namespace rt;
+
+  /// The first bytes of the binary form (the last one is its version).
+  const char MAGIC[ 8 ] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', 2 };
+
+  /// The beginning of the binary form, followed by the arrays of
+  /// materials, lights, spheres, planes, meshes and the string table.
+  struct BinaryHeader {
+    char magic[ 8 ];
+    std::uint32_t nb_materials, nb_lights, nb_spheres, nb_planes, nb_meshes, nb_chars;
+    float eye[ 3 ], target[ 3 ], up[ 3 ], fov;
+    std::int32_t width, height, max_depth, spp, aa_min, aa_max;
+    float aa_threshold;
+    std::int32_t stochastic, noise, shadow_rays;
+    float light_threshold;
+    /// Offset of the sky file name in the string table, -1 for none.
+    std::int32_t sky;
+  };
+
+  /// Copies \a n records of type T at \a p into \a v and moves \a p after them.
+  template <typename T>
+  void copyRecords( const char*& p, std::size_t n, std::vector<T>& v )
+  {
+    v.resize( n );
+    if ( n > 0 ) std::memcpy( v.data(), p, n * sizeof( T ) );
+    p += n * sizeof( T );
+  }
+
+  template <typename T>
+  void writeRecords( std::ostream& output, const std::vector<T>& v )
+  {
+    if ( ! v.empty() )
+      output.write( reinterpret_cast<const char*>( v.data() ), v.size() * sizeof( T ) );
+  }
+
+  /// @return 'true' if the radius of \a s is positive, and larger than
+  /// the thickness of the shell for a bubble (see makeBubble).
+  bool validRadius( const SceneDescription::SphereRecord& s )
+  {
+    return s.radius > ( s.bubble ? BUBBLE_THICKNESS : 0.0f );
+  }
+
+  /// Reads \a n numbers of \a line into \a x.
+  bool readReals( std::istringstream& line, float* x, int n )
+  {
+    for ( int i = 0; i < n; ++i )
+      if ( ! ( line >> x[ i ] ) ) return false;
+    return true;
+  }
+
+  Point3 point( const float* x ) { return Point3( x[ 0 ], x[ 1 ], x[ 2 ] ); }
+
+  Color color( const float* x ) { return Color( x[ 0 ], x[ 1 ], x[ 2 ] ); }
+
+} // namespace
+
+rt::SceneDescription::MaterialRecord
+rt::SceneDescription::record( const Material& m )
+{
+  MaterialRecord r;
+  const float* ambient = m.ambient;
+  const float* diffuse = m.diffuse;
+  const float* specular = m.specular;
+  std::copy( ambient, ambient + 3, r.ambient );
+  std::copy( diffuse, diffuse + 3, r.diffuse );
+  std::copy( specular, specular + 3, r.specular );
+  r.shinyness            = m.shinyness;
+  r.coef_diffusion       = m.coef_diffusion;
+  r.coef_reflexion       = m.coef_reflexion;
+  r.coef_refraction      = m.coef_refraction;
+  r.in_refractive_index  = m.in_refractive_index;
+  r.out_refractive_index = m.out_refractive_index;
+  return r;
+}
+
+rt::Material
+rt::SceneDescription::material( int i ) const
+{
+  const MaterialRecord& r = materials[ i ];
+  return Material( color( r.ambient ), color( r.diffuse ), color( r.specular ), r.shinyness,
+                   r.coef_diffusion, r.coef_reflexion, r.coef_refraction,
+                   r.in_refractive_index, r.out_refractive_index );
+}
+
+rt::Material
+rt::SceneDescription::preset( const std::string& name, bool& found )
+{
+  found = true;
+  if ( name == "whitePlastic" )  return Material::whitePlastic();
+  if ( name == "redPlastic" )    return Material::redPlastic();
+  if ( name == "bronze" )        return Material::bronze();
+  if ( name == "emerald" )       return Material::emerald();
+  if ( name == "glass" )         return Material::glass();
+  if ( name == "blueWater" )     return Material::blueWater();
+  if ( name == "silver" )        return Material::silver();
+  if ( name == "black_plastic" ) return Material::black_plastic();
+  found = false;
+  return Material();
+}
+
+std::int32_t
+rt::SceneDescription::addString( const std::string& s )
+{
+  std::int32_t offset = (std::int32_t) strings.size();
+  strings.insert( strings.end(), s.begin(), s.end() );
+  strings.push_back( 0 );
+  return offset;
+}
+
+bool
+rt::SceneDescription::read( const std::string& file_name )
+{
+  char magic[ sizeof( MAGIC ) ] = { 0 };
+  std::ifstream input( file_name.c_str(), std::ifstream::binary );
+  if ( ! input.good() ) {
+    std::cerr << "[SceneDescription::read] Cannot open " << file_name << std::endl;
+    return false;
+  }
+  input.read( magic, sizeof( magic ) );
+  input.close();
+  return std::memcmp( magic, MAGIC, sizeof( MAGIC ) - 1 ) == 0
+    ? readBinary( file_name ) : readText( file_name );
+}
+
+bool
+rt::SceneDescription::readText( const std::string& file_name )
+{
+  std::ifstream input( file_name.c_str() );
+  if ( ! input.good() ) {
+    std::cerr << "[SceneDescription::readText] Cannot open " << file_name << std::endl;
+    return false;
+  }
+  std::map< std::string, int > names;
+  int line_number = 0;
+  std::string text;
+  while ( std::getline( input, text ) ) {
+    ++line_number;
+    std::string::size_type comment = text.find( '#' );
+    if ( comment != std::string::npos ) text.erase( comment );
+    std::istringstream line( text );
+    std::string keyword;
+    if ( ! ( line >> keyword ) ) continue;
+    std::string error;
+    // @return the index of the material called \a name, or -1.
+    auto materialIndex = [&] ( const std::string& name ) {
+      auto it = names.find( name );
+      if ( it != names.end() ) return it->second;
+      bool found;
+      Material m = preset( name, found );
+      if ( ! found ) return -1;
+      materials.push_back( record( m ) );
+      material_names.push_back( name );
+      return names[ name ] = (int) materials.size() - 1;
+    };
+    auto readMaterial = [&] ( std::int32_t& index ) {
+      std::string name;
+      if ( ! ( line >> name ) ) return false;
+      index = materialIndex( name );
+      if ( index < 0 ) error = "unknown material " + name;
+      return index >= 0;
+    };
+    bool ok = true;
+    if ( keyword == "material" ) {
+      std::string name, field;
+      ok = (bool) ( line >> name );
+      Material m( Color( 0, 0, 0 ), Color( 0, 0, 0 ), Color( 0, 0, 0 ) );
+      bool is_preset = false;
+      while ( ok && line >> field ) {
+        float x[ 3 ];
+        bool found;
+        Material p = preset( field, found );
+        if ( found ) { m = p; is_preset = true; }
+        else if ( field == "ambient" )    { ok = readReals( line, x, 3 ); m.ambient  = color( x ); }
+        else if ( field == "diffuse" )    { ok = readReals( line, x, 3 ); m.diffuse  = color( x ); }
+        else if ( field == "specular" )   { ok = readReals( line, x, 3 ); m.specular = color( x ); }
+        else if ( field == "shinyness" )  ok = readReals( line, &m.shinyness, 1 );
+        else if ( field == "diffusion" )  ok = readReals( line, &m.coef_diffusion, 1 );
+        else if ( field == "reflexion" )  ok = readReals( line, &m.coef_reflexion, 1 );
+        else if ( field == "refraction" ) ok = readReals( line, &m.coef_refraction, 1 );
+        else if ( field == "index" )      ok = readReals( line, &m.in_refractive_index, 1 )
+                                             && readReals( line, &m.out_refractive_index, 1 );
+        else { ok = false; error = "unknown material field " + field; }
+        if ( is_preset && ! found ) { ok = false; error = "a preset has no fields"; }
+      }
+      if ( ok ) {
+        names[ name ] = (int) materials.size();
+        materials.push_back( record( m ) );
+        material_names.push_back( name );
+      }
+    } else if ( keyword == "light" ) {
+      LightRecord l;
+      ok = readReals( line, l.position, 4 ) && readReals( line, l.color, 3 );
+      if ( ok ) lights.push_back( l );
+    } else if ( keyword == "sphere" || keyword == "bubble" ) {
+      SphereRecord s;
+      s.bubble = keyword == "bubble" ? 1 : 0;
+      ok = readReals( line, s.center, 3 ) && readReals( line, &s.radius, 1 ) && readMaterial( s.material );
+      if ( ok && ! validRadius( s ) ) {
+        ok = false;
+        error = s.bubble ? "the radius of a bubble must be larger than its shell"
+                         : "the radius of a sphere must be positive";
+      }
+      if ( ok ) spheres.push_back( s );
+    } else if ( keyword == "plane" || keyword == "water" ) {
+      PlaneRecord p;
+      p.water = keyword == "water" ? 1 : 0;
+      p.band = 0;
+      p.band_width = p.band_blending = 0.0f;
+      ok = readReals( line, p.c, 3 ) && readReals( line, p.u, 3 ) && readReals( line, p.v, 3 )
+        && readMaterial( p.main );
+      if ( ok && ! p.water ) {
+        ok = readMaterial( p.band ) && readReals( line, &p.band_width, 1 );
+        std::string field;
+        if ( ok && line >> field )
+          ok = field == "blend" && readReals( line, &p.band_blending, 1 );
+      }
+      if ( ok ) planes.push_back( p );
+    } else if ( keyword == "mesh" ) {
+      MeshRecord m;
+      std::string file;
+      ok = (bool) ( line >> file ) && readMaterial( m.material )
+        && readReals( line, m.center, 3 ) && readReals( line, &m.size, 1 );
+      if ( ok ) {
+        m.file = addString( file );
+        meshes.push_back( m );
+      }
+    } else if ( keyword == "camera" ) {
+      std::string field;
+      RenderSettings& s = settings;
+      while ( ok && line >> field ) {
+        if      ( field == "eye" )    ok = readReals( line, &s.eye[ 0 ], 3 );
+        else if ( field == "target" ) ok = readReals( line, &s.target[ 0 ], 3 );
+        else if ( field == "up" )     ok = readReals( line, &s.up[ 0 ], 3 );
+        else if ( field == "fov" )    ok = readReals( line, &s.fov, 1 );
+        else { ok = false; error = "unknown camera field " + field; }
+      }
+    } else if ( keyword == "render" ) {
+      std::string field, value;
+      RenderSettings& s = settings;
+      while ( ok && line >> field ) {
+        if      ( field == "size" )   ok = (bool) ( line >> s.width >> s.height );
+        else if ( field == "depth" )  ok = (bool) ( line >> s.max_depth );
+        else if ( field == "spp" )    ok = (bool) ( line >> s.spp );
+        else if ( field == "aa" )     ok = (bool) ( line >> s.aa_min >> s.aa_max >> s.aa_threshold );
+        else if ( field == "noise" )  ok = (bool) ( line >> s.noise );
+        else if ( field == "sky" )    ok = (bool) ( line >> s.sky );
+        else if ( field == "shadows" ) ok = (bool) ( line >> s.shadow_rays ) && s.shadow_rays >= 0;
+        else if ( field == "cull" )   ok = (bool) ( line >> s.light_threshold );
+        else if ( field == "stochastic" ) {
+          ok = (bool) ( line >> value ) && ( value == "on" || value == "off" );
+          s.stochastic = value == "on";
+        }
+        else { ok = false; error = "unknown render field " + field; }
+      }
+    } else {
+      ok = false;
+      error = "unknown statement " + keyword;
+    }
+    if ( ! ok ) {
+      std::cerr << file_name << ":" << line_number << ": "
+                << ( error.empty() ? "invalid " + keyword : error ) << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+rt::SceneDescription::readBinary( const std::string& file_name )
+{
+  MappedFile file( file_name );
+  if ( file.data == nullptr ) {
+    std::cerr << "[SceneDescription::readBinary] Cannot read " << file_name << std::endl;
+    return false;
+  }
+  if ( ! readBinary( file.data, file.size ) ) {
+    std::cerr << "[SceneDescription::readBinary] Invalid file " << file_name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+rt::SceneDescription::readBinary( const char* data, std::size_t size )
+{
+  BinaryHeader h;
+  bool ok = size >= sizeof( h );
+  if ( ok ) {
+    std::memcpy( &h, data, sizeof( h ) );
+    ok = std::memcmp( h.magic, MAGIC, sizeof( MAGIC ) ) == 0
+      && size == sizeof( h ) + h.nb_materials * sizeof( MaterialRecord )
+                     + h.nb_lights * sizeof( LightRecord ) + h.nb_spheres * sizeof( SphereRecord )
+                     + h.nb_planes * sizeof( PlaneRecord ) + h.nb_meshes * sizeof( MeshRecord )
+                     + h.nb_chars;
+  }
+  if ( ! ok ) return false;
+  const char* p = data + sizeof( h );
+  copyRecords( p, h.nb_materials, materials );
+  copyRecords( p, h.nb_lights, lights );
+  copyRecords( p, h.nb_spheres, spheres );
+  copyRecords( p, h.nb_planes, planes );
+  copyRecords( p, h.nb_meshes, meshes );
+  copyRecords( p, h.nb_chars, strings );
+  material_names.clear();
+  // Checks the indices, so that build() may trust them.
+  const std::int32_t nb_materials = (std::int32_t) materials.size();
+  const std::int32_t nb_chars     = (std::int32_t) strings.size();
+  auto valid = [&] ( std::int32_t m ) { return m >= 0 && m < nb_materials; };
+  auto validString = [&] ( std::int32_t s ) { return s >= 0 && s < nb_chars; };
+  ok = strings.empty() || strings.back() == 0;
+  for ( const SphereRecord& s : spheres ) ok = ok && valid( s.material ) && validRadius( s );
+  for ( const PlaneRecord& pl : planes )  ok = ok && valid( pl.main ) && ( pl.water || valid( pl.band ) );
+  for ( const MeshRecord& m : meshes )    ok = ok && valid( m.material ) && validString( m.file );
+  ok = ok && ( h.sky < 0 || validString( h.sky ) ) && h.shadow_rays >= 0;
+  if ( ! ok ) return false;
+  RenderSettings& s = settings;
+  s.eye          = point( h.eye );
+  s.target       = point( h.target );
+  s.up           = point( h.up );
+  s.fov          = h.fov;
+  s.width        = h.width;
+  s.height       = h.height;
+  s.max_depth    = h.max_depth;
+  s.spp          = h.spp;
+  s.aa_min       = h.aa_min;
+  s.aa_max       = h.aa_max;
+  s.aa_threshold = h.aa_threshold;
+  s.stochastic   = h.stochastic != 0;
+  s.noise        = h.noise;
+  s.shadow_rays  = h.shadow_rays;
+  s.light_threshold = h.light_threshold;
+  s.sky          = h.sky < 0 ? std::string() : std::string( strings.data() + h.sky );
+  return true;
+}
+
+bool
+rt::SceneDescription::writeBinary( const std::string& file_name ) const
+{
+  std::ofstream output( file_name.c_str(), std::ofstream::binary );
+  writeBinary( output );
+  if ( ! output.good() ) {
+    std::cerr << "[SceneDescription::writeBinary] Cannot write " << file_name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void
+rt::SceneDescription::writeBinary( std::ostream& output ) const
+{
+  std::vector< char > table = strings;
+  BinaryHeader h;
+  std::memcpy( h.magic, MAGIC, sizeof( MAGIC ) );
+  const RenderSettings& s = settings;
+  h.sky = -1;
+  if ( ! s.sky.empty() ) {
+    h.sky = (std::int32_t) table.size();
+    table.insert( table.end(), s.sky.begin(), s.sky.end() );
+    table.push_back( 0 );
+  }
+  h.nb_materials = (std::uint32_t) materials.size();
+  h.nb_lights    = (std::uint32_t) lights.size();
+  h.nb_spheres   = (std::uint32_t) spheres.size();
+  h.nb_planes    = (std::uint32_t) planes.size();
+  h.nb_meshes    = (std::uint32_t) meshes.size();
+  h.nb_chars     = (std::uint32_t) table.size();
+  for ( int i = 0; i < 3; ++i ) {
+    h.eye[ i ]    = s.eye[ i ];
+    h.target[ i ] = s.target[ i ];
+    h.up[ i ]     = s.up[ i ];
+  }
+  h.fov          = s.fov;
+  h.width        = s.width;
+  h.height       = s.height;
+  h.max_depth    = s.max_depth;
+  h.spp          = s.spp;
+  h.aa_min       = s.aa_min;
+  h.aa_max       = s.aa_max;
+  h.aa_threshold = s.aa_threshold;
+  h.stochastic   = s.stochastic ? 1 : 0;
+  h.noise        = s.noise;
+  h.shadow_rays  = s.shadow_rays;
+  h.light_threshold = s.light_threshold;
+  output.write( reinterpret_cast<const char*>( &h ), sizeof( h ) );
+  writeRecords( output, materials );
+  writeRecords( output, lights );
+  writeRecords( output, spheres );
+  writeRecords( output, planes );
+  writeRecords( output, meshes );
+  writeRecords( output, table );
+}
+
+bool
+rt::SceneDescription::loadMeshes( std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects,
+                                  int nb_threads ) const
+{
+  // The meshes of the same file and material are loaded once.
+  std::map< std::pair< int, int >, std::shared_ptr<TriangleMesh> > loaded;
+  mesh_objects.clear();
+  for ( const MeshRecord& m : meshes ) {
+    std::shared_ptr<TriangleMesh>& mesh = loaded[ std::make_pair( (int) m.file, (int) m.material ) ];
+    if ( ! mesh ) {
+      mesh = std::make_shared<TriangleMesh>( material( m.material ) );
+      if ( ! mesh->loadOBJ( strings.data() + m.file, nb_threads ) ) return false;
+    }
+    mesh_objects.push_back( mesh );
+  }
+  return true;
+}
+
+bool
+rt::SceneDescription::build( Scene& scene, int nb_threads ) const
+{
+  std::vector< std::shared_ptr<TriangleMesh> > mesh_objects;
+  if ( ! loadMeshes( mesh_objects, nb_threads ) ) return false;
+  build( scene, mesh_objects );
+  return true;
+}
+
+void
+rt::SceneDescription::build( Scene& scene,
+                             const std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects ) const
+{
+  for ( std::size_t i = 0; i < lights.size(); ++i ) {
+    const LightRecord& l = lights[ i ];
+    scene.addLight( new PointLight( (int) i, Point4( l.position[ 0 ], l.position[ 1 ],
+                                                     l.position[ 2 ], l.position[ 3 ] ),
+                                    color( l.color ) ) );
+  }
+  // The bubbles of the same radius and material share their geometry.
+  std::map< std::pair< float, int >, std::shared_ptr<GraphicalObject> > bubbles;
+  for ( const SphereRecord& s : spheres ) {
+    if ( ! s.bubble ) {
+      scene.addObject( new Sphere( point( s.center ), s.radius, material( s.material ) ) );
+      continue;
+    }
+    std::shared_ptr<GraphicalObject>& bubble = bubbles[ std::make_pair( s.radius, (int) s.material ) ];
+    if ( ! bubble ) bubble = makeBubble( s.radius, material( s.material ) );
+    addBubble( scene, bubble, point( s.center ) );
+  }
+  for ( const PlaneRecord& p : planes ) {
+    if ( p.water ) {
+      WaterPlane* water = new WaterPlane( point( p.c ), point( p.u ), point( p.v ), material( p.main ) );
+      water->setNoiseVolume( settings.noise );
+      scene.addObject( water );
+    } else {
+      PeriodicPlane* plane = new PeriodicPlane( point( p.c ), point( p.u ), point( p.v ),
+                                                material( p.main ), material( p.band ), p.band_width );
+      plane->band_blending = p.band_blending;
+      scene.addObject( plane );
+    }
+  }
+  // The meshes are fitted in their boxes by instances.
+  for ( std::size_t i = 0; i < meshes.size(); ++i ) {
+    const MeshRecord& m = meshes[ i ];
+    const TriangleMesh& mesh = *mesh_objects[ i ];
+    if ( mesh.vertices.empty() ) continue;
+    BoundingBox box;
+    for ( const Point3& v : mesh.vertices ) box.extend( v );
+    Vector3 extent = box.hi - box.lo;
+    Real largest = std::max( extent[ 0 ], std::max( extent[ 1 ], extent[ 2 ] ) );
+    Real scale   = largest > 0.0f ? m.size / largest : 1.0f;
+    Transform T = Transform::translate( point( m.center ) ) * Transform::scale( scale )
+      * Transform::translate( -box.centroid() );
+    scene.addObject( new Instance( mesh_objects[ i ], T ) );
+  }
+}
@@ -0,0 +1,189 @@
+/**
+@file SceneFile.h
+*/
+#pragma once
+#ifndef _SCENE_FILE_H_
+#define _SCENE_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Scene.h"
+#include "Material.h"
+#include "TriangleMesh.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// The camera and render settings of a scene file. The command-line
+  /// renderer starts from them, and its options override them.
+  struct RenderSettings {
+    /// Position of the camera, point looked at and up direction.
+    Point3 eye, target;
+    Vector3 up;
+    /// Vertical field of view in degrees.
+    Real fov;
+    /// Resolution of the image.
+    int width, height;
+    /// Maximum depth of rays.
+    int max_depth;
+    /// Samples per pixel of stochastic renders.
+    int spp;
+    /// Adaptive antialiasing (see Renderer::setAntialiasing), off if aa_min is 0.
+    int aa_min, aa_max;
+    Real aa_threshold;
+    /// 'true' for stochastic renders.
+    bool stochastic;
+    /// Resolution of the precomputed noise of the water planes (0 for
+    /// the exact Worley noise).
+    int noise;
+    /// PPM image of the sky (empty for none).
+    std::string sky;
+    /// Light sampling (see Renderer::setLightSampling).
+    int shadow_rays;
+    Real light_threshold;
+
+    /// The settings of the demo scene.
+    RenderSettings()
+      : eye( -14, -16, 8 ), target( 0, 2, -1 ), up( 0, 0, 1 ), fov( 45.0f ),
+        width( 640 ), height( 480 ), max_depth( 6 ), spp( 1 ),
+        aa_min( 0 ), aa_max( 0 ), aa_threshold( 0.0f ), stochastic( false ),
+        noise( 0 ), sky( "sky.ppm" ), shadow_rays( 0 ), light_threshold( 0.0f )
+    {}
+  };
+
+  /// The description of a scene (materials, lights, objects, camera and
+  /// render settings), read from a file and instantiated by build().
+  ///
+  /// The text format has one statement per line, '#' starts a comment:
+  /// @code
+  /// material NAME PRESET                     # a copy of a preset (bronze, glass, ...)
+  /// material NAME ambient R G B diffuse R G B specular R G B shinyness S
+  ///               diffusion D reflexion R refraction T index IN OUT
+  ///                                          # all fields optional, from black
+  /// light X Y Z W R G B                      # point light, W = 0 at infinity
+  /// sphere X Y Z RADIUS MAT                  # RADIUS > 0
+  /// bubble X Y Z RADIUS MAT                  # see makeBubble, RADIUS > BUBBLE_THICKNESS
+  /// plane CX CY CZ UX UY UZ VX VY VZ MAIN BAND WIDTH [blend B]  # PeriodicPlane
+  /// water CX CY CZ UX UY UZ VX VY VZ MAT     # WaterPlane
+  /// mesh FILE MAT X Y Z SIZE                 # OBJ file, fitted in a box
+  /// camera eye X Y Z target X Y Z up X Y Z fov DEG
+  /// render size W H depth N spp N stochastic on|off aa MIN MAX T noise N sky FILE
+  ///        shadows N cull T                  # light sampling
+  /// @endcode
+  /// where MAT is a preset or a name given by a previous material line,
+  /// and camera and render fields are optional.
+  ///
+  /// The binary form holds the same data as arrays of fixed-size
+  /// records (in the byte order of the machine). It is mapped in memory
+  /// and copied at once, without any parsing.
+  struct SceneDescription {
+
+    /// A material in the binary form.
+    struct MaterialRecord {
+      float ambient[ 3 ], diffuse[ 3 ], specular[ 3 ];
+      float shinyness, coef_diffusion, coef_reflexion, coef_refraction;
+      float in_refractive_index, out_refractive_index;
+    };
+    /// A point light.
+    struct LightRecord {
+      float position[ 4 ];
+      float color[ 3 ];
+    };
+    /// A sphere or a bubble.
+    struct SphereRecord {
+      float center[ 3 ];
+      float radius;
+      std::int32_t material;
+      /// 1 for a bubble.
+      std::int32_t bubble;
+    };
+    /// A periodic plane or a water plane.
+    struct PlaneRecord {
+      float c[ 3 ], u[ 3 ], v[ 3 ];
+      std::int32_t main, band;
+      float band_width, band_blending;
+      /// 1 for a water plane (band is ignored).
+      std::int32_t water;
+    };
+    /// A mesh read from an OBJ file.
+    struct MeshRecord {
+      /// Offset of the file name in the string table.
+      std::int32_t file;
+      std::int32_t material;
+      float center[ 3 ];
+      float size;
+    };
+
+    /// The materials and their names (empty if read from the binary form).
+    std::vector< MaterialRecord > materials;
+    std::vector< std::string > material_names;
+    std::vector< LightRecord > lights;
+    std::vector< SphereRecord > spheres;
+    std::vector< PlaneRecord > planes;
+    std::vector< MeshRecord > meshes;
+    /// File names, each one ended by a 0.
+    std::vector< char > strings;
+    /// The camera and render settings.
+    RenderSettings settings;
+
+    /// Reads the text or binary file \a file_name (the binary form is
+    /// recognized by its first bytes).
+    /// @return 'false' if it cannot be read, errors are printed on std::cerr.
+    bool read( const std::string& file_name );
+
+    /// Reads the text form from \a file_name, see read().
+    bool readText( const std::string& file_name );
+
+    /// Reads the binary form from \a file_name, see read().
+    bool readBinary( const std::string& file_name );
+
+    /// Reads the binary form from the \a size bytes at \a data.
+    /// @return 'false' if they are not valid.
+    bool readBinary( const char* data, std::size_t size );
+
+    /// Writes the binary form into \a file_name.
+    /// @return 'false' in case of error.
+    bool writeBinary( const std::string& file_name ) const;
+
+    /// Writes the binary form into \a output.
+    void writeBinary( std::ostream& output ) const;
+
+    /// Adds the lights and objects of the description to \a scene. The
+    /// bubbles of the same size and material share their geometry, as
+    /// do the meshes of the same file and material.
+    /// @return 'false' if a mesh cannot be loaded.
+    bool build( Scene& scene, int nb_threads = 0 ) const;
+
+    /// Same as above, with the meshes given by \a mesh_objects (see
+    /// loadMeshes) instead of being loaded.
+    void build( Scene& scene,
+                const std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects ) const;
+
+    /// Loads the OBJ files of the meshes, with \a nb_threads threads.
+    /// @param[out] mesh_objects the mesh of each record of meshes; the
+    /// records of the same file and material share it.
+    /// @return 'false' if a file cannot be loaded.
+    bool loadMeshes( std::vector< std::shared_ptr<TriangleMesh> >& mesh_objects,
+                     int nb_threads = 0 ) const;
+
+    /// @return the material \a i.
+    Material material( int i ) const;
+
+    /// @return the record of \a m.
+    static MaterialRecord record( const Material& m );
+
+    /// @return the preset material called \a name (e.g. "bronze").
+    /// @param[out] found 'false' if there is no such preset.
+    static Material preset( const std::string& name, bool& found );
+
+  private:
+    /// @return the index of the string \a s in strings, added if needed.
+    std::int32_t addString( const std::string& s );
+  };
+
+} // namespace rt
+
+#endif // #define _SCENE_FILE_H_
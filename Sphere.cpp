@@ -3,63 +3,9 @@
 */
 #include <cmath>
 #include "Sphere.h"
-
-void
-rt::Sphere::draw( Viewer& /* viewer */ )
-{
-  Material m = material;
-  // Taking care of south pole
-  glBegin( GL_TRIANGLE_FAN );
-  glColor4fv( m.ambient );
-  glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
-  glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
-  Point3 south_pole = localize( -90, 0 );
-  glNormal3fv( getNormal( south_pole ) );
-  glVertex3fv( south_pole );
-  for ( int x = 0; x <= NLON; ++x )
-    {
-      Point3 p = localize( -90 + 180/NLAT, x * 360 / NLON );
-      glNormal3fv( getNormal( p ) );
-      glVertex3fv( p );
-    }
-  glEnd();
-  // Taking care of in-between poles
-  for ( int y = 1; y < NLAT - 1; ++y )
-    {
-      glBegin( GL_QUAD_STRIP);
-      glColor4fv( m.ambient );
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
-      glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
-      glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
-      for ( int x = 0; x <= NLON; ++x )
-        {
-          Point3 p = localize( -90 + y*180/NLAT,     x * 360 / NLON );
-          Point3 q = localize( -90 + (y+1)*180/NLAT, x * 360 / NLON );
-          glNormal3fv( getNormal( p ) );
-          glVertex3fv( p );
-          glNormal3fv( getNormal( q ) );
-          glVertex3fv( q );
-        }
-      glEnd();
-    }
-  // Taking care of north pole
-  glBegin( GL_TRIANGLE_FAN );
-  glColor4fv( m.ambient );
-  glMaterialfv(GL_FRONT, GL_DIFFUSE, m.diffuse);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, m.specular);
-  glMaterialf(GL_FRONT, GL_SHININESS, m.shinyness );
-  Point3 north_pole = localize( 90, 0 );
-  glNormal3fv( getNormal( north_pole ) );
-  glVertex3fv( north_pole );
-  for ( int x = NLON; x >= 0; --x )
-    {
-      Point3 p = localize( -90 + (NLAT-1)*180/NLAT, x * 360 / NLON );
-      glNormal3fv( getNormal( p ) );
-      glVertex3fv( p );
-    }
-  glEnd();
-}
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+#include <emmintrin.h>
+#endif
 
 rt::Point3
 rt::Sphere::localize( Real latitude, Real longitude ) const
@@ -82,36 +28,73 @@ rt::Sphere::getNormal( Point3 p )
   return u;
 }
 
-rt::Material
+const rt::Material&
 rt::Sphere::getMaterial( Point3 /* p */ )
 {
-  return material; // the material is constant along the sphere.
+  return sharedMaterial(); // the material is constant along the sphere.
 }
 
-rt::Real
-rt::Sphere::rayIntersection( const Ray& ray, Point3& p )
+void
+rt::Sphere::internMaterials( MaterialTable& materials )
 {
-    Vector3 pc = center - ray.origin;
-    Vector3 pq = pc.dot(ray.direction) * ray.direction;
-    Vector3 qc = pc - pq;
-    Real distance2 = qc.dot(qc);
-    Real radius2 = radius * radius;
-    if (distance2 > radius2)
-        return 1.0f;  // no intersect with the sphere
-    Vector3 cp = Vector3(-pc[0], -pc[1], -pc[2]);
-    Real b = 2 * (ray.direction.dot(cp));
-    Real discriminant = b * b - 4 * (pc.dot(pc) - radius2);
-    if(discriminant < 0.f)
-        return 1.0f;
-
-    Real disSqrt = static_cast<Real>(sqrt(discriminant));
+  ptrMaterial = &materials[ materials.add( material ) ];
+}
 
-    Real t1 = (-b - disSqrt) / 2.0f;
-    Real t2 = (-b + disSqrt) / 2.0f;
-    if (t1 < 0.f && t2 < 0.f)
-        return 1.0f;  // the ray start after the sphere
+void
+rt::Sphere::packetIntersection( const RayPacket& packet, RayPacketHit& hit )
+{
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+  // Same computations as rayIntersection, in the same order, so that
+  // the distances are identical.
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 dx   = _mm_load_ps( packet.dx );
+  const __m128 dy   = _mm_load_ps( packet.dy );
+  const __m128 dz   = _mm_load_ps( packet.dz );
+  const __m128 pcx  = _mm_sub_ps( _mm_set1_ps( center[ 0 ] ), _mm_load_ps( packet.ox ) );
+  const __m128 pcy  = _mm_sub_ps( _mm_set1_ps( center[ 1 ] ), _mm_load_ps( packet.oy ) );
+  const __m128 pcz  = _mm_sub_ps( _mm_set1_ps( center[ 2 ] ), _mm_load_ps( packet.oz ) );
+  __m128 pcd = _mm_add_ps( _mm_add_ps( _mm_mul_ps( pcx, dx ), _mm_mul_ps( pcy, dy ) ),
+                           _mm_mul_ps( pcz, dz ) );
+  __m128 qcx = _mm_sub_ps( pcx, _mm_mul_ps( pcd, dx ) );
+  __m128 qcy = _mm_sub_ps( pcy, _mm_mul_ps( pcd, dy ) );
+  __m128 qcz = _mm_sub_ps( pcz, _mm_mul_ps( pcd, dz ) );
+  __m128 distance2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( qcx, qcx ), _mm_mul_ps( qcy, qcy ) ),
+                                 _mm_mul_ps( qcz, qcz ) );
+  const __m128 radius2 = _mm_set1_ps( radius * radius );
+  __m128 mask = _mm_cmpngt_ps( distance2, radius2 );
+  if ( _mm_movemask_ps( mask ) == 0 ) return;
+  __m128 b = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, _mm_sub_ps( zero, pcx ) ),
+                                     _mm_mul_ps( dy, _mm_sub_ps( zero, pcy ) ) ),
+                         _mm_mul_ps( dz, _mm_sub_ps( zero, pcz ) ) );
+  b = _mm_mul_ps( _mm_set1_ps( 2.0f ), b );
+  __m128 pc2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( pcx, pcx ), _mm_mul_ps( pcy, pcy ) ),
+                           _mm_mul_ps( pcz, pcz ) );
+  __m128 discriminant = _mm_sub_ps( _mm_mul_ps( b, b ),
+                                    _mm_mul_ps( _mm_set1_ps( 4.0f ), _mm_sub_ps( pc2, radius2 ) ) );
+  mask = _mm_and_ps( mask, _mm_cmpnlt_ps( discriminant, zero ) );
+  __m128 disSqrt = _mm_sqrt_ps( _mm_max_ps( discriminant, zero ) );
+  __m128 minus_b = _mm_xor_ps( b, _mm_set1_ps( -0.0f ) );
+  __m128 t1 = _mm_div_ps( _mm_sub_ps( minus_b, disSqrt ), _mm_set1_ps( 2.0f ) );
+  __m128 t2 = _mm_div_ps( _mm_add_ps( minus_b, disSqrt ), _mm_set1_ps( 2.0f ) );
+  mask = _mm_andnot_ps( _mm_and_ps( _mm_cmplt_ps( t1, zero ), _mm_cmplt_ps( t2, zero ) ), mask );
+  __m128 front = _mm_cmpgt_ps( t1, zero );
+  __m128 t = _mm_or_ps( _mm_and_ps( front, t1 ), _mm_andnot_ps( front, t2 ) );
+  mask = _mm_and_ps( mask, _mm_cmpnge_ps( t, _mm_load_ps( hit.t ) ) );
+  int bits = _mm_movemask_ps( mask );
+  if ( bits == 0 ) return;
+  _mm_store_ps( hit.t, _mm_or_ps( _mm_and_ps( mask, t ),
+                                  _mm_andnot_ps( mask, _mm_load_ps( hit.t ) ) ) );
+  for ( int i = 0; i < RayPacket::SIZE; ++i )
+    if ( bits & ( 1 << i ) ) hit.object[ i ] = this;
+#else
+  GraphicalObject::packetIntersection( packet, hit );
+#endif
+}
 
-    Real t = t1 > 0 ? t1 : t2;
-    p = ray.origin + t * ray.direction;
-    return -1.0f;
+bool
+rt::Sphere::getBoundingBox( BoundingBox& box )
+{
+  Vector3 r( radius, radius, radius );
+  box = BoundingBox( center - r, center + r );
+  return true;
 }
@@ -6,13 +6,14 @@
 #ifndef _SPHERE_H_
 #define _SPHERE_H_
 
-// In order to call opengl commands in all graphical objects
+#include <algorithm>
+#include <cmath>
 #include "GraphicalObject.h"
 
 /// Namespace RayTracer
 namespace rt {
   /// A sphere is a concrete GraphicalObject that represents a sphere in 3D space.
-  struct Sphere : public GraphicalObject {
+  struct Sphere final : public GraphicalObject {
     
     static const int NLAT = 16; ///< number of different latitudes for display
     static const int NLON = 24; ///< number of different longitudes for display
@@ -22,7 +23,8 @@ namespace rt {
 
     /// Creates a sphere of center \a xc and radius \a r.
     Sphere( Point3 xc, Real r, const Material& m  )
-      : GraphicalObject(), center( xc ), radius( r ), material( m )
+      : GraphicalObject(), center( xc ), radius( r ), material( m ),
+        ptrMaterial( nullptr )
     {}
 
     /// Given latitude and longitude in degrees, returns the point on
@@ -32,30 +34,35 @@ namespace rt {
     // ---------------- GraphicalObject services ----------------------------
   public:
 
-    /// This method is called by Scene::init() at the beginning of the
-    /// display in the OpenGL window. May be useful for some
-    /// precomputations.
-    void init( Viewer& /* viewer */ ) {}
-
-    /// This method is called by Scene::draw() at each frame to
-    /// redisplay objects in the OpenGL window.
-    void draw( Viewer& viewer );
-
+    /// @return ObjectType::Sphere.
+    ObjectType objectType() const { return ObjectType::Sphere; }
 
     /// @return the normal vector at point \a p on the sphere (\a p
     /// should be on or close to the sphere).
     Vector3 getNormal( Point3 p );
 
     /// @return the material associated to this part of the object
-    Material getMaterial( Point3 p );
+    const Material& getMaterial( Point3 p );
+
+    /// Shares its material through the table \a materials.
+    void internMaterials( MaterialTable& materials );
 
     /// @param[in] ray the incoming ray
-    /// @param[out] returns the point of intersection with the object
-    /// (if any), or the closest point to it.
+    /// @param[in,out] hit filled if the sphere is hit closer than \a hit.t.
     ///
-    /// @return either a real < 0.0 if there is an intersection, or a
-    /// kind of distance to the closest point of intersection.
-    Real rayIntersection( const Ray& ray, Point3& p );
+    /// @return 'true' if there is an intersection closer than \a hit.t.
+    bool rayIntersection( const Ray& ray, RayHit& hit );
+
+    /// SSE version of rayIntersection for a packet of rays, see
+    /// GraphicalObject::packetIntersection.
+    void packetIntersection( const RayPacket& packet, RayPacketHit& hit );
+
+    /// @param[out] box the bounding box of the sphere.
+    /// @return 'true' since a sphere is bounded.
+    bool getBoundingBox( BoundingBox& box );
+
+    /// Any-hit query for shadow rays, see GraphicalObject::occluded.
+    bool occluded( const Ray& ray, Real tMax, bool& transparent );
 
   public:
     /// The center of the sphere
@@ -64,8 +71,77 @@ namespace rt {
     Real radius;
     /// The material (global to the sphere).
     Material material;
+
+  private:
+    /// The copy of material in the table of the scene, or 0 before
+    /// internMaterials.
+    const Material* ptrMaterial;
+
+    /// @return the material used for rendering.
+    const Material& sharedMaterial() const
+    { return ptrMaterial != nullptr ? *ptrMaterial : material; }
   };
 
+  // The intersection methods are inline, so that Scene may inline them
+  // in its traversals (see Scene::intersect).
+
+  inline bool
+  Sphere::rayIntersection( const Ray& ray, RayHit& hit )
+  {
+      Vector3 pc = center - ray.origin;
+      Vector3 pq = pc.dot(ray.direction) * ray.direction;
+      Vector3 qc = pc - pq;
+      Real distance2 = qc.dot(qc);
+      Real radius2 = radius * radius;
+      if (distance2 > radius2)
+          return false;  // no intersect with the sphere
+      Vector3 cp = -pc;
+      Real b = 2 * (ray.direction.dot(cp));
+      // b^2 - 4(|pc|^2 - r^2) = 4(r^2 - |qc|^2), which does not cancel
+      // out in float far from the sphere.
+      Real discriminant = 4 * (radius2 - distance2);
+
+      Real disSqrt = static_cast<Real>(sqrt(discriminant));
+
+      Real t1 = (-b - disSqrt) / 2.0f;
+      Real t2 = (-b + disSqrt) / 2.0f;
+      if (t1 < 0.f && t2 < 0.f)
+          return false;  // the ray start after the sphere
+
+      Real t = t1 > 0 ? t1 : t2;
+      if (t >= hit.t)
+          return false;  // something closer was already found
+      hit.t = t;
+      hit.point = madd(ray.origin, t, ray.direction);
+      hit.normal = getNormal(hit.point);
+      hit.material = &sharedMaterial();
+      // longitude and latitude, scaled to [0,1]
+      hit.uv = Vector2(0.5f + static_cast<Real>(atan2(hit.normal[1], hit.normal[0]) / (2.0 * M_PI)),
+                       0.5f + static_cast<Real>(asin(std::max(-1.0f, std::min(1.0f, hit.normal[2]))) / M_PI));
+      hit.object = this;
+      return true;
+  }
+
+  inline bool
+  Sphere::occluded( const Ray& ray, Real tMax, bool& transparent )
+  {
+    // t^2 - 2bt + c = 0 since the ray direction is unitary. b^2 - c is
+    // computed as r^2 - |qc|^2, qc going from the center to the closest
+    // point of the ray, as in rayIntersection.
+    Vector3 pc = center - ray.origin;
+    Real b = pc.dot( ray.direction );
+    Vector3 qc = pc - b * ray.direction;
+    Real discriminant = radius * radius - qc.dot( qc );
+    if ( discriminant < 0.0f ) return false;
+    Real disSqrt = std::sqrt( discriminant );
+    Real t = b - disSqrt;
+    if ( t <= 0.0f ) t = b + disSqrt;
+    if ( t <= 0.0f || t >= tMax ) return false;
+    if ( sharedMaterial().coef_refraction == 0.0f ) return true;
+    transparent = true;
+    return false;
+  }
+
 } // namespace rt
 
 #endif // #define _SPHERE_H_
@@ -0,0 +1,301 @@
+/**
+@file SphereSet.cpp
+*/
+#include <cmath>
+#include <limits>
+#include "SphereSet.h"
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined( __AVX__ ) && ! defined( RT_NO_SIMD )
+  /// The operations of the kernels on 8 floats.
+  struct Lanes {
+    typedef __m256 V;
+    static V zero()                  { return _mm256_setzero_ps(); }
+    static V set1( float x )         { return _mm256_set1_ps( x ); }
+    static V load( const float* p )  { return _mm256_load_ps( p ); }
+    static void store( float* p, V x ) { _mm256_store_ps( p, x ); }
+    static V add( V a, V b )         { return _mm256_add_ps( a, b ); }
+    static V sub( V a, V b )         { return _mm256_sub_ps( a, b ); }
+    static V mul( V a, V b )         { return _mm256_mul_ps( a, b ); }
+    static V div( V a, V b )         { return _mm256_div_ps( a, b ); }
+    static V sqrt( V a )             { return _mm256_sqrt_ps( a ); }
+    static V max( V a, V b )         { return _mm256_max_ps( a, b ); }
+    static V neg( V a )              { return _mm256_xor_ps( a, _mm256_set1_ps( -0.0f ) ); }
+    static V andMask( V a, V b )     { return _mm256_and_ps( a, b ); }
+    static V andNot( V a, V b )      { return _mm256_andnot_ps( a, b ); }
+    static V blend( V mask, V a, V b ) { return _mm256_blendv_ps( b, a, mask ); }
+    static V lt( V a, V b )          { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+    static V le( V a, V b )          { return _mm256_cmp_ps( a, b, _CMP_LE_OQ ); }
+    static V gt( V a, V b )          { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+    static V ngt( V a, V b )         { return _mm256_cmp_ps( a, b, _CMP_NGT_UQ ); }
+    static V nlt( V a, V b )         { return _mm256_cmp_ps( a, b, _CMP_NLT_UQ ); }
+    static V nge( V a, V b )         { return _mm256_cmp_ps( a, b, _CMP_NGE_UQ ); }
+    static int bits( V mask )        { return _mm256_movemask_ps( mask ); }
+  };
+#elif defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+  /// The operations of the kernels on 4 floats.
+  struct Lanes {
+    typedef __m128 V;
+    static V zero()                  { return _mm_setzero_ps(); }
+    static V set1( float x )         { return _mm_set1_ps( x ); }
+    static V load( const float* p )  { return _mm_load_ps( p ); }
+    static void store( float* p, V x ) { _mm_store_ps( p, x ); }
+    static V add( V a, V b )         { return _mm_add_ps( a, b ); }
+    static V sub( V a, V b )         { return _mm_sub_ps( a, b ); }
+    static V mul( V a, V b )         { return _mm_mul_ps( a, b ); }
+    static V div( V a, V b )         { return _mm_div_ps( a, b ); }
+    static V sqrt( V a )             { return _mm_sqrt_ps( a ); }
+    static V max( V a, V b )         { return _mm_max_ps( a, b ); }
+    static V neg( V a )              { return _mm_xor_ps( a, _mm_set1_ps( -0.0f ) ); }
+    static V andMask( V a, V b )     { return _mm_and_ps( a, b ); }
+    static V andNot( V a, V b )      { return _mm_andnot_ps( a, b ); }
+    static V blend( V mask, V a, V b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+    static V lt( V a, V b )          { return _mm_cmplt_ps( a, b ); }
+    static V le( V a, V b )          { return _mm_cmple_ps( a, b ); }
+    static V gt( V a, V b )          { return _mm_cmpgt_ps( a, b ); }
+    static V ngt( V a, V b )         { return _mm_cmpngt_ps( a, b ); }
+    static V nlt( V a, V b )         { return _mm_cmpnlt_ps( a, b ); }
+    static V nge( V a, V b )         { return _mm_cmpnge_ps( a, b ); }
+    static int bits( V mask )        { return _mm_movemask_ps( mask ); }
+  };
+#endif
+
+} // namespace
+
+int
+rt::SphereSet::addMaterial( const Material& m )
+{
+  myMaterials.push_back( m );
+  mySharedMaterials.clear(); // shared again by the next Scene::prepare.
+  return (int) myMaterials.size() - 1;
+}
+
+int
+rt::SphereSet::add( Point3 c, Real r, int material )
+{
+  if ( myNbSpheres == (int) myCX.size() ) {
+    // a new block of padding spheres, which are never hit.
+    std::size_t n = myCX.size() + WIDTH;
+    myCX.resize( n, 0.0f );
+    myCY.resize( n, 0.0f );
+    myCZ.resize( n, 0.0f );
+    myRadius.resize( n, 0.0f );
+    myRadius2.resize( n, -1.0f );
+  }
+  int i = myNbSpheres++;
+  myCX[ i ] = c[ 0 ];
+  myCY[ i ] = c[ 1 ];
+  myCZ[ i ] = c[ 2 ];
+  myRadius[ i ]  = r;
+  myRadius2[ i ] = r * r;
+  myMaterialIndex.push_back( material );
+  return i;
+}
+
+int
+rt::SphereSet::closestSphere( const Ray& ray, Real t_max, Real& t ) const
+{
+  // Same computations as Sphere::rayIntersection, in the same order, so
+  // that the distances are identical. Ties go to the first sphere.
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+  typedef Lanes L;
+  const int W = WIDTH;
+  const L::V zero = L::zero(), two = L::set1( 2.0f ), four = L::set1( 4.0f );
+  const L::V ox = L::set1( ray.origin[ 0 ] ),    oy = L::set1( ray.origin[ 1 ] ),    oz = L::set1( ray.origin[ 2 ] );
+  const L::V dx = L::set1( ray.direction[ 0 ] ), dy = L::set1( ray.direction[ 1 ] ), dz = L::set1( ray.direction[ 2 ] );
+  L::V best_t = L::set1( t_max );
+  L::V best_i = L::set1( -1.0f );
+  alignas( 32 ) float first_index[ W ];
+  for ( int k = 0; k < W; ++k ) first_index[ k ] = (float) k;
+  L::V index = L::load( first_index );
+  const L::V step = L::set1( (float) W );
+  for ( std::size_t j = 0; j < myCX.size(); j += W, index = L::add( index, step ) ) {
+    L::V pcx = L::sub( L::load( &myCX[ j ] ), ox );
+    L::V pcy = L::sub( L::load( &myCY[ j ] ), oy );
+    L::V pcz = L::sub( L::load( &myCZ[ j ] ), oz );
+    L::V pcd = L::add( L::add( L::mul( pcx, dx ), L::mul( pcy, dy ) ), L::mul( pcz, dz ) );
+    L::V qcx = L::sub( pcx, L::mul( pcd, dx ) );
+    L::V qcy = L::sub( pcy, L::mul( pcd, dy ) );
+    L::V qcz = L::sub( pcz, L::mul( pcd, dz ) );
+    L::V distance2 = L::add( L::add( L::mul( qcx, qcx ), L::mul( qcy, qcy ) ), L::mul( qcz, qcz ) );
+    L::V radius2 = L::load( &myRadius2[ j ] );
+    L::V mask = L::ngt( distance2, radius2 );
+    if ( L::bits( mask ) == 0 ) continue;
+    L::V b = L::add( L::add( L::mul( dx, L::sub( zero, pcx ) ), L::mul( dy, L::sub( zero, pcy ) ) ),
+                     L::mul( dz, L::sub( zero, pcz ) ) );
+    b = L::mul( two, b );
+    L::V discriminant = L::mul( four, L::sub( radius2, distance2 ) );
+    L::V disSqrt = L::sqrt( L::max( discriminant, zero ) );
+    L::V minus_b = L::neg( b );
+    L::V t1 = L::div( L::sub( minus_b, disSqrt ), two );
+    L::V t2 = L::div( L::add( minus_b, disSqrt ), two );
+    mask = L::andNot( L::andMask( L::lt( t1, zero ), L::lt( t2, zero ) ), mask );
+    L::V tt = L::blend( L::gt( t1, zero ), t1, t2 );
+    mask = L::andMask( mask, L::nge( tt, best_t ) );
+    best_t = L::blend( mask, tt, best_t );
+    best_i = L::blend( mask, index, best_i );
+  }
+  alignas( 32 ) float lane_t[ W ], lane_i[ W ];
+  L::store( lane_t, best_t );
+  L::store( lane_i, best_i );
+  int found = -1;
+  for ( int k = 0; k < W; ++k ) {
+    if ( lane_i[ k ] < 0.0f ) continue;
+    int i = (int) lane_i[ k ];
+    if ( found < 0 || lane_t[ k ] < t || ( lane_t[ k ] == t && i < found ) ) {
+      found = i;
+      t     = lane_t[ k ];
+    }
+  }
+  return found;
+#else
+  int found = -1;
+  for ( int i = 0; i < myNbSpheres; ++i ) {
+    Vector3 pc = center( i ) - ray.origin;
+    Vector3 pq = pc.dot( ray.direction ) * ray.direction;
+    Vector3 qc = pc - pq;
+    Real radius2 = myRadius2[ i ];
+    Real distance2 = qc.dot( qc );
+    if ( distance2 > radius2 ) continue;
+    Vector3 cp = -pc;
+    Real b = 2 * ( ray.direction.dot( cp ) );
+    Real discriminant = 4 * ( radius2 - distance2 );
+    Real disSqrt = static_cast<Real>( std::sqrt( discriminant ) );
+    Real t1 = ( -b - disSqrt ) / 2.0f;
+    Real t2 = ( -b + disSqrt ) / 2.0f;
+    if ( t1 < 0.f && t2 < 0.f ) continue;
+    Real ti = t1 > 0 ? t1 : t2;
+    if ( ti >= t_max ) continue;
+    t_max = ti;
+    t     = ti;
+    found = i;
+  }
+  return found;
+#endif
+}
+
+bool
+rt::SphereSet::rayIntersection( const Ray& ray, RayHit& hit )
+{
+  Real t;
+  int i = closestSphere( ray, hit.t, t );
+  if ( i < 0 ) return false;
+  // Same as Sphere::rayIntersection.
+  hit.t = t;
+  hit.point = madd( ray.origin, t, ray.direction );
+  Vector3 u = hit.point - center( i );
+  Real   l2 = u.dot( u );
+  if ( l2 != 0.0 ) u /= std::sqrt( (double) l2 );
+  hit.normal = u;
+  hit.material = &material( i );
+  hit.uv = Vector2( 0.5f + static_cast<Real>( atan2( hit.normal[ 1 ], hit.normal[ 0 ] ) / ( 2.0 * M_PI ) ),
+                    0.5f + static_cast<Real>( asin( std::max( -1.0f, std::min( 1.0f, hit.normal[ 2 ] ) ) ) / M_PI ) );
+  hit.object = this;
+  return true;
+}
+
+bool
+rt::SphereSet::occluded( const Ray& ray, Real tMax, bool& transparent )
+{
+  // Same test as Sphere::occluded for each sphere. The lanes test W
+  // spheres at once, the materials are only read for the spheres hit
+  // and the first opaque one ends the query.
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+  typedef Lanes L;
+  const int W = WIDTH;
+  const L::V zero = L::zero(), t_max = L::set1( tMax );
+  const L::V ox = L::set1( ray.origin[ 0 ] ),    oy = L::set1( ray.origin[ 1 ] ),    oz = L::set1( ray.origin[ 2 ] );
+  const L::V dx = L::set1( ray.direction[ 0 ] ), dy = L::set1( ray.direction[ 1 ] ), dz = L::set1( ray.direction[ 2 ] );
+  for ( std::size_t j = 0; j < myCX.size(); j += W ) {
+    L::V pcx = L::sub( L::load( &myCX[ j ] ), ox );
+    L::V pcy = L::sub( L::load( &myCY[ j ] ), oy );
+    L::V pcz = L::sub( L::load( &myCZ[ j ] ), oz );
+    L::V b   = L::add( L::add( L::mul( pcx, dx ), L::mul( pcy, dy ) ), L::mul( pcz, dz ) );
+    L::V qcx = L::sub( pcx, L::mul( b, dx ) );
+    L::V qcy = L::sub( pcy, L::mul( b, dy ) );
+    L::V qcz = L::sub( pcz, L::mul( b, dz ) );
+    L::V distance2 = L::add( L::add( L::mul( qcx, qcx ), L::mul( qcy, qcy ) ), L::mul( qcz, qcz ) );
+    // padding spheres have a negative squared radius.
+    L::V discriminant = L::sub( L::load( &myRadius2[ j ] ), distance2 );
+    L::V mask = L::nlt( discriminant, zero );
+    if ( L::bits( mask ) == 0 ) continue;
+    L::V disSqrt = L::sqrt( L::max( discriminant, zero ) );
+    L::V t1 = L::sub( b, disSqrt );
+    L::V t  = L::blend( L::gt( t1, zero ), t1, L::add( b, disSqrt ) );
+    mask = L::andMask( mask, L::andMask( L::gt( t, zero ), L::lt( t, t_max ) ) );
+    for ( int bits = L::bits( mask ), k = 0; bits != 0; bits >>= 1, ++k ) {
+      if ( ( bits & 1 ) == 0 ) continue;
+      if ( material( (int) j + k ).coef_refraction == 0.0f ) return true;
+      transparent = true;
+    }
+  }
+  return false;
+#else
+  for ( int i = 0; i < myNbSpheres; ++i ) {
+    Vector3 pc = center( i ) - ray.origin;
+    Real b = pc.dot( ray.direction );
+    Vector3 qc = pc - b * ray.direction;
+    Real discriminant = myRadius2[ i ] - qc.dot( qc );
+    if ( discriminant < 0.0f ) continue;
+    Real disSqrt = std::sqrt( discriminant );
+    Real t = b - disSqrt;
+    if ( t <= 0.0f ) t = b + disSqrt;
+    if ( t <= 0.0f || t >= tMax ) continue;
+    if ( material( i ).coef_refraction == 0.0f ) return true;
+    transparent = true;
+  }
+  return false;
+#endif
+}
+
+bool
+rt::SphereSet::getBoundingBox( BoundingBox& box )
+{
+  if ( myNbSpheres == 0 ) return false;
+  box = BoundingBox();
+  for ( int i = 0; i < myNbSpheres; ++i ) {
+    Vector3 r( myRadius[ i ], myRadius[ i ], myRadius[ i ] );
+    box.extend( center( i ) - r );
+    box.extend( center( i ) + r );
+  }
+  return true;
+}
+
+int
+rt::SphereSet::closestSurface( const Point3& p ) const
+{
+  int  closest = 0;
+  Real best    = std::numeric_limits<Real>::infinity();
+  for ( int i = 0; i < myNbSpheres; ++i ) {
+    Real d = std::fabs( distance( p, center( i ) ) - myRadius[ i ] );
+    if ( d < best ) { best = d; closest = i; }
+  }
+  return closest;
+}
+
+rt::Vector3
+rt::SphereSet::getNormal( Point3 p )
+{
+  Vector3 u = p - center( closestSurface( p ) );
+  Real   l2 = u.dot( u );
+  if ( l2 != 0.0 ) u /= std::sqrt( (double) l2 );
+  return u;
+}
+
+const rt::Material&
+rt::SphereSet::getMaterial( Point3 p )
+{
+  return material( closestSurface( p ) );
+}
+
+void
+rt::SphereSet::internMaterials( MaterialTable& materials )
+{
+  mySharedMaterials.clear();
+  for ( const Material& m : myMaterials )
+    mySharedMaterials.push_back( &materials[ materials.add( m ) ] );
+}
@@ -0,0 +1,133 @@
+/**
+@file SphereSet.h
+*/
+#pragma once
+#ifndef _SPHERE_SET_H_
+#define _SPHERE_SET_H_
+
+#include <vector>
+#include "GraphicalObject.h"
+#include "AlignedAllocator.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A set of spheres seen as a single GraphicalObject. The spheres are
+  /// stored as a structure of aligned arrays (centers, radii, squared
+  /// radii and material indices), so that a ray is tested against
+  /// several spheres per SIMD instruction (4 with SSE, 8 with AVX)
+  /// instead of one virtual call per sphere. The intersections are
+  /// exactly the ones of the same spheres given as Sphere objects.
+  ///
+  /// It suits many small spheres of few materials; the set is one
+  /// primitive of the scene hierarchy, so it is better to group
+  /// spheres that are close to each other.
+  struct SphereSet final : public GraphicalObject {
+
+    /// Number of spheres tested together.
+#if defined( __AVX__ ) && ! defined( RT_NO_SIMD )
+    static const int WIDTH = 8;
+#else
+    static const int WIDTH = 4;
+#endif
+
+    /// Aligned array of floats, padded to a multiple of WIDTH.
+    typedef std::vector< float, AlignedAllocator< float, 32 > > FloatArray;
+
+    /// Virtual destructor since object contains virtual methods.
+    virtual ~SphereSet() {}
+
+    /// Creates an empty set.
+    SphereSet() : myNbSpheres( 0 ) {}
+
+    /// Adds the material \a m.
+    /// @return its index, see add().
+    int addMaterial( const Material& m );
+
+    /// Adds a sphere of center \a c and radius \a r with the material
+    /// \a material (an index returned by addMaterial).
+    /// @return the index of the sphere.
+    int add( Point3 c, Real r, int material );
+
+    /// Adds a sphere of center \a c and radius \a r with its own
+    /// material \a m.
+    /// @return the index of the sphere.
+    int add( Point3 c, Real r, const Material& m )
+    {
+      return add( c, r, addMaterial( m ) );
+    }
+
+    /// @return the number of spheres.
+    int size() const { return myNbSpheres; }
+
+    /// @return the center of sphere \a i.
+    Point3 center( int i ) const { return Point3( myCX[ i ], myCY[ i ], myCZ[ i ] ); }
+
+    /// @return the radius of sphere \a i.
+    Real radius( int i ) const { return myRadius[ i ]; }
+
+    /// @return the material of sphere \a i.
+    const Material& material( int i ) const
+    {
+      const int m = myMaterialIndex[ i ];
+      return mySharedMaterials.empty() ? myMaterials[ m ] : *mySharedMaterials[ m ];
+    }
+
+    /// Looks for the closest sphere hit by \a ray before \a t_max.
+    /// @param[out] t the distance of the intersection.
+    /// @return the index of the sphere, or -1 if none is hit.
+    int closestSphere( const Ray& ray, Real t_max, Real& t ) const;
+
+    // ---------------- GraphicalObject services ----------------------------
+  public:
+
+    /// @return ObjectType::SphereSet.
+    ObjectType objectType() const { return ObjectType::SphereSet; }
+
+    /// @return the normal vector at point \a p on the sphere whose
+    /// surface is the closest to \a p.
+    Vector3 getNormal( Point3 p );
+
+    /// @return the material of the sphere whose surface is the closest
+    /// to \a p.
+    const Material& getMaterial( Point3 p );
+
+    /// Shares its materials through the table \a materials.
+    void internMaterials( MaterialTable& materials );
+
+    /// @param[in] ray the incoming ray
+    /// @param[in,out] hit filled if a sphere is hit closer than \a hit.t.
+    ///
+    /// @return 'true' if there is an intersection closer than \a hit.t.
+    bool rayIntersection( const Ray& ray, RayHit& hit );
+
+    /// @param[out] box the bounding box of the spheres.
+    /// @return 'true' unless the set is empty.
+    bool getBoundingBox( BoundingBox& box );
+
+    /// Any-hit query for shadow rays, see GraphicalObject::occluded.
+    bool occluded( const Ray& ray, Real tMax, bool& transparent );
+
+  private:
+    /// Number of spheres (the arrays are padded with spheres that are
+    /// never hit).
+    int myNbSpheres;
+    /// Coordinates of the centers.
+    FloatArray myCX, myCY, myCZ;
+    /// Radii and squared radii (-1 for padding).
+    FloatArray myRadius, myRadius2;
+    /// Index of the material of each sphere.
+    std::vector< int > myMaterialIndex;
+    /// The materials.
+    std::vector< Material > myMaterials;
+    /// Their copies in the table of the scene, empty before
+    /// internMaterials.
+    std::vector< const Material* > mySharedMaterials;
+
+    /// @return the index of the sphere whose surface is the closest to \a p.
+    int closestSurface( const Point3& p ) const;
+  };
+
+} // namespace rt
+
+#endif // #define _SPHERE_SET_H_
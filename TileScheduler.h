@@ -0,0 +1,129 @@
+/**
+@file TileScheduler.h
+*/
+#pragma once
+#ifndef _TILE_SCHEDULER_H_
+#define _TILE_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A rectangular block of pixels [x0,x1[ x [y0,y1[ of the image.
+  struct Tile {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+  };
+
+  /// The queue of tiles of one worker. The owner takes tiles at the
+  /// front (in scan order), idle workers steal them at the back.
+  struct TileQueue {
+    std::mutex mutex;
+    std::deque<Tile> tiles;
+
+    /// Takes the next tile of its owner.
+    /// @return 'false' if the queue is empty.
+    bool pop( Tile& tile )
+    {
+      std::lock_guard<std::mutex> lock( mutex );
+      if ( tiles.empty() ) return false;
+      tile = tiles.front();
+      tiles.pop_front();
+      return true;
+    }
+
+    /// Takes the last tile of this queue for another worker.
+    /// @return 'false' if the queue is empty.
+    bool steal( Tile& tile )
+    {
+      std::lock_guard<std::mutex> lock( mutex );
+      if ( tiles.empty() ) return false;
+      tile = tiles.back();
+      tiles.pop_back();
+      return true;
+    }
+  };
+
+  /// Splits an image into tiles and processes them on a pool of
+  /// threads. Each thread starts with a contiguous range of tiles and,
+  /// once it is done, steals work from the other threads, so that
+  /// expensive regions (glass, bubbles) do not leave cores idle.
+  struct TileScheduler {
+
+    /// Creates a scheduler using \a nb_threads threads (0 means one
+    /// per hardware core).
+    TileScheduler( int nb_threads = 0 )
+      : myNbThreads( nb_threads > 0 ? nb_threads : defaultNbThreads() )
+    {}
+
+    /// @return the number of threads used by the scheduler.
+    int nbThreads() const { return myNbThreads; }
+
+    /// @return the number of hardware cores (at least 1).
+    static int defaultNbThreads()
+    {
+      return std::max( 1, (int) std::thread::hardware_concurrency() );
+    }
+
+    /// @return the tiles of size \a tile_size covering a \a width x \a
+    /// height image, in scan order.
+    static std::vector<Tile> split( int width, int height, int tile_size )
+    {
+      std::vector<Tile> tiles;
+      for ( int y = 0; y < height; y += tile_size )
+        for ( int x = 0; x < width; x += tile_size )
+          tiles.push_back( Tile { x, y, std::min( x + tile_size, width ),
+                                  std::min( y + tile_size, height ) } );
+      return tiles;
+    }
+
+    /// Calls \a fn( tile ) for every tile of \a tiles, on all threads,
+    /// and returns once every tile has been processed. Then \a
+    /// done( nb_done, nb_tiles ) is called each time a tile is
+    /// finished (it is serialized, so it may display some progress).
+    template <typename TileFunction, typename DoneFunction>
+    void run( const std::vector<Tile>& tiles, TileFunction fn, DoneFunction done )
+    {
+      const int nb_tiles = (int) tiles.size();
+      const int nb_workers = std::max( 1, std::min( myNbThreads, nb_tiles ) );
+      std::vector<TileQueue> queues( nb_workers );
+      for ( int i = 0; i < nb_tiles; ++i )
+        queues[ (long) i * nb_workers / nb_tiles ].tiles.push_back( tiles[ i ] );
+      std::atomic<int> nb_done( 0 );
+      std::mutex done_mutex;
+      auto worker = [&] ( int id ) {
+        Tile tile;
+        for ( ;; ) {
+          bool found = queues[ id ].pop( tile );
+          for ( int k = 1; ! found && k < nb_workers; ++k )
+            found = queues[ ( id + k ) % nb_workers ].steal( tile );
+          if ( ! found ) return; // no work left anywhere
+          fn( tile );
+          int n = ++nb_done;
+          std::lock_guard<std::mutex> lock( done_mutex );
+          done( n, nb_tiles );
+        }
+      };
+      std::vector<std::thread> threads;
+      for ( int id = 1; id < nb_workers; ++id )
+        threads.emplace_back( worker, id );
+      worker( 0 );
+      for ( std::thread& t : threads ) t.join();
+    }
+
+  private:
+    /// The number of threads used by the scheduler.
+    int myNbThreads;
+  };
+
+} // namespace rt
+
+#endif // #define _TILE_SCHEDULER_H_
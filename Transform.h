@@ -0,0 +1,124 @@
+/**
+@file Transform.h
+*/
+#pragma once
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#include <cmath>
+#include "PointVector.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// An affine transform p -> M p + t of the 3D space, where M is a 3x3
+  /// matrix stored by rows and t a translation.
+  struct Transform {
+    /// The rows of the linear part M.
+    Vector3 rows[ 3 ];
+    /// The translation t.
+    Vector3 translation;
+
+    /// The identity.
+    Transform() : translation( 0, 0, 0 )
+    {
+      rows[ 0 ] = Vector3( 1, 0, 0 );
+      rows[ 1 ] = Vector3( 0, 1, 0 );
+      rows[ 2 ] = Vector3( 0, 0, 1 );
+    }
+
+    /// @return the translation by \a t.
+    static Transform translate( const Vector3& t )
+    {
+      Transform T;
+      T.translation = t;
+      return T;
+    }
+
+    /// @return the scaling of factors \a s (along x, y and z).
+    static Transform scale( const Vector3& s )
+    {
+      Transform T;
+      for ( int i = 0; i < 3; ++i ) T.rows[ i ][ i ] = s[ i ];
+      return T;
+    }
+
+    /// @return the uniform scaling of factor \a s.
+    static Transform scale( Real s ) { return scale( Vector3( s, s, s ) ); }
+
+    /// @return the rotation of \a degrees around the axis \a axis
+    /// (which passes through the origin).
+    static Transform rotate( Vector3 axis, Real degrees )
+    {
+      axis = axis.normalized();
+      const Real a = degrees * (Real) M_PI / 180.0f;
+      const Real c = std::cos( a ), s = std::sin( a ), k = 1.0f - c;
+      const Real x = axis[ 0 ], y = axis[ 1 ], z = axis[ 2 ];
+      Transform T;
+      T.rows[ 0 ] = Vector3( c + x * x * k,     x * y * k - z * s, x * z * k + y * s );
+      T.rows[ 1 ] = Vector3( y * x * k + z * s, c + y * y * k,     y * z * k - x * s );
+      T.rows[ 2 ] = Vector3( z * x * k - y * s, z * y * k + x * s, c + z * z * k );
+      return T;
+    }
+
+    /// @return the transform applying \a other, then this one.
+    Transform operator*( const Transform& other ) const
+    {
+      Transform T;
+      for ( int i = 0; i < 3; ++i )
+        for ( int j = 0; j < 3; ++j )
+          T.rows[ i ][ j ] = rows[ i ][ 0 ] * other.rows[ 0 ][ j ]
+            + rows[ i ][ 1 ] * other.rows[ 1 ][ j ] + rows[ i ][ 2 ] * other.rows[ 2 ][ j ];
+      T.translation = vector( other.translation ) + translation;
+      return T;
+    }
+
+    /// @return the image of point \a p.
+    Point3 point( const Point3& p ) const { return vector( p ) + translation; }
+
+    /// @return the image of vector \a v (the translation does not apply).
+    Vector3 vector( const Vector3& v ) const
+    {
+      return Vector3( rows[ 0 ].dot( v ), rows[ 1 ].dot( v ), rows[ 2 ].dot( v ) );
+    }
+
+    /// @return the image of \a v by the transposed linear part, e.g. the
+    /// inverse transform maps normals this way.
+    Vector3 transposedVector( const Vector3& v ) const
+    {
+      return v[ 0 ] * rows[ 0 ] + v[ 1 ] * rows[ 1 ] + v[ 2 ] * rows[ 2 ];
+    }
+
+    /// @return the inverse transform (the linear part must be invertible).
+    Transform inverse() const
+    {
+      // the inverse of M is its adjugate over its determinant, and the
+      // adjugate is made of the cross products of the rows.
+      const Vector3 c0 = rows[ 1 ].cross( rows[ 2 ] );
+      const Vector3 c1 = rows[ 2 ].cross( rows[ 0 ] );
+      const Vector3 c2 = rows[ 0 ].cross( rows[ 1 ] );
+      const Real inv_det = 1.0f / rows[ 0 ].dot( c0 );
+      Transform T;
+      for ( int i = 0; i < 3; ++i )
+        T.rows[ i ] = Vector3( c0[ i ], c1[ i ], c2[ i ] ) * inv_det;
+      T.translation = -T.vector( translation );
+      return T;
+    }
+
+    /// @return 'true' if the linear part is a rotation (or the identity),
+    /// i.e. the transform keeps the lengths, up to \a epsilon.
+    bool isRigid( Real epsilon = 1e-6f ) const
+    {
+      for ( int i = 0; i < 3; ++i )
+        for ( int j = 0; j < 3; ++j ) {
+          Real d = rows[ 0 ][ i ] * rows[ 0 ][ j ] + rows[ 1 ][ i ] * rows[ 1 ][ j ]
+            + rows[ 2 ][ i ] * rows[ 2 ][ j ];
+          if ( std::fabs( d - ( i == j ? 1.0f : 0.0f ) ) > epsilon ) return false;
+        }
+      return true;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _TRANSFORM_H_
@@ -0,0 +1,521 @@
+/**
+@file TriangleMesh.cpp
+*/
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include "TriangleMesh.h"
+#include "TileScheduler.h"
+
+namespace {
+  using namespace rt;
+
+  /// A ray prepared for the watertight ray/triangle test: the
+  /// coordinates are permuted so that kz is the dominant axis of the
+  /// direction, and sheared so that the ray becomes the z-axis.
+  struct WatertightRay {
+    Point3 origin;
+    int kx, ky, kz;
+    Real sx, sy, sz;
+
+    explicit WatertightRay( const Ray& ray ) : origin( ray.origin )
+    {
+      const Vector3& d = ray.direction;
+      kz = 0;
+      if ( std::fabs( d[ 1 ] ) > std::fabs( d[ kz ] ) ) kz = 1;
+      if ( std::fabs( d[ 2 ] ) > std::fabs( d[ kz ] ) ) kz = 2;
+      kx = ( kz + 1 ) % 3;
+      ky = ( kx + 1 ) % 3;
+      // keeps the winding of the triangles.
+      if ( d[ kz ] < 0.0f ) std::swap( kx, ky );
+      sx = d[ kx ] / d[ kz ];
+      sy = d[ ky ] / d[ kz ];
+      sz = 1.0f / d[ kz ];
+    }
+  };
+
+  /// Watertight test between \a r and the triangle of vertices \a p[0],
+  /// \a p[1], \a p[2] (Woop, Benthin and Wald 2013). On the edges, the
+  /// 2D edge functions are recomputed in double precision, so that
+  /// neighbouring triangles agree on which one is hit.
+  /// @param[out] t the distance of the intersection, if in ]0,t_max[.
+  /// @param[out] b1,b2 its barycentric coordinates w.r.t. p[1] and p[2].
+  inline bool
+  intersectTriangle( const WatertightRay& r, const Point3* p, Real t_max,
+                     Real& t, Real& b1, Real& b2 )
+  {
+    const Vector3 A = p[ 0 ] - r.origin;
+    const Vector3 B = p[ 1 ] - r.origin;
+    const Vector3 C = p[ 2 ] - r.origin;
+    const Real ax = A[ r.kx ] - r.sx * A[ r.kz ];
+    const Real ay = A[ r.ky ] - r.sy * A[ r.kz ];
+    const Real bx = B[ r.kx ] - r.sx * B[ r.kz ];
+    const Real by = B[ r.ky ] - r.sy * B[ r.kz ];
+    const Real cx = C[ r.kx ] - r.sx * C[ r.kz ];
+    const Real cy = C[ r.ky ] - r.sy * C[ r.kz ];
+    Real u = cx * by - cy * bx;
+    Real v = ax * cy - ay * cx;
+    Real w = bx * ay - by * ax;
+    if ( u == 0.0f || v == 0.0f || w == 0.0f ) {
+      u = (Real) ( (double) cx * (double) by - (double) cy * (double) bx );
+      v = (Real) ( (double) ax * (double) cy - (double) ay * (double) cx );
+      w = (Real) ( (double) bx * (double) ay - (double) by * (double) ax );
+    }
+    if ( ( u < 0.0f || v < 0.0f || w < 0.0f ) && ( u > 0.0f || v > 0.0f || w > 0.0f ) )
+      return false;
+    const Real det = u + v + w;
+    if ( det == 0.0f ) return false;
+    const Real T = u * r.sz * A[ r.kz ] + v * r.sz * B[ r.kz ] + w * r.sz * C[ r.kz ];
+    // t = T / det must be in ]0, t_max[.
+    if ( det > 0.0f ? ( T <= 0.0f || T >= t_max * det )
+                    : ( T >= 0.0f || T <= t_max * det ) )
+      return false;
+    const Real inv_det = 1.0f / det;
+    t = T * inv_det;
+    if ( t >= t_max ) return false;
+    b1 = v * inv_det;
+    b2 = w * inv_det;
+    return true;
+  }
+
+  // ---------------------------- OBJ parsing ----------------------------
+
+  /// Size in bytes of the parts of an OBJ file parsed by each task.
+  const std::size_t OBJ_CHUNK_SIZE = 1 << 20;
+
+  /// A part of an OBJ file made of whole lines, and what it contains.
+  /// Negative (relative) indices of the faces are resolved against the
+  /// vertices of the part, then shifted by the vertices of the previous
+  /// parts once all parts are read.
+  struct ObjChunk {
+    const char* begin;
+    const char* end;
+    std::vector< Point3 > vertices;
+    std::vector< Vector3 > normals;
+    std::vector< TriangleMesh::Triangle > triangles;
+    /// For each triangle, bit k is set if index k (v[0..2], then
+    /// n[0..2]) is relative to the part, and bit 6 if it has normals.
+    std::vector< unsigned char > relative;
+    /// 'false' if the part has a syntax error.
+    bool ok;
+  };
+
+  inline bool isBlank( char c ) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  inline void skipBlanks( const char*& s ) { while ( isBlank( *s ) ) ++s; }
+
+  /// Reads an integer at \a s. @return 'false' if there is none.
+  inline bool readInt( const char*& s, int& value )
+  {
+    bool negative = *s == '-';
+    if ( *s == '-' || *s == '+' ) ++s;
+    if ( *s < '0' || *s > '9' ) return false;
+    int n = 0;
+    while ( *s >= '0' && *s <= '9' ) n = 10 * n + ( *s++ - '0' );
+    value = negative ? -n : n;
+    return true;
+  }
+
+  /// Reads a floating-point number at \a s, much faster than strtod
+  /// (which is also locale dependent). @return 'false' if there is none.
+  inline bool readReal( const char*& s, Real& value )
+  {
+    skipBlanks( s );
+    bool negative = *s == '-';
+    if ( *s == '-' || *s == '+' ) ++s;
+    unsigned long long mantissa = 0;
+    int exponent = 0, nb_digits = 0;
+    for ( ; *s >= '0' && *s <= '9'; ++s, ++nb_digits ) {
+      if ( mantissa < 100000000000000000ULL ) mantissa = 10 * mantissa + ( *s - '0' );
+      else exponent += 1;
+    }
+    if ( *s == '.' )
+      for ( ++s; *s >= '0' && *s <= '9'; ++s, ++nb_digits )
+        if ( mantissa < 100000000000000000ULL ) {
+          mantissa = 10 * mantissa + ( *s - '0' );
+          exponent -= 1;
+        }
+    if ( nb_digits == 0 ) return false;
+    if ( *s == 'e' || *s == 'E' ) {
+      ++s;
+      int e;
+      if ( ! readInt( s, e ) ) return false;
+      exponent += e;
+    }
+    double x = (double) mantissa * std::pow( 10.0, exponent );
+    value = (Real) ( negative ? -x : x );
+    return true;
+  }
+
+  /// Reads the index \a i of a face at \a s, for an array that has \a
+  /// count elements so far in the part.
+  /// @param[out] index the index, relative to the part if \a relative.
+  inline bool readIndex( const char*& s, std::size_t count, int& index, bool& relative )
+  {
+    int i;
+    if ( ! readInt( s, i ) || i == 0 ) return false;
+    relative = i < 0;
+    index = relative ? (int) count + i : i - 1;
+    return true;
+  }
+
+  /// Parses the lines of \a chunk.
+  void parseChunk( ObjChunk& chunk )
+  {
+    chunk.ok = true;
+    std::vector< int > v, n;
+    std::vector< bool > v_rel, n_rel;
+    const char* s = chunk.begin;
+    while ( s < chunk.end ) {
+      skipBlanks( s );
+      if ( s[ 0 ] == 'v' && isBlank( s[ 1 ] ) ) {
+        ++s;
+        Point3 p;
+        if ( ! ( readReal( s, p[ 0 ] ) && readReal( s, p[ 1 ] ) && readReal( s, p[ 2 ] ) ) )
+          chunk.ok = false;
+        chunk.vertices.push_back( p );
+      } else if ( s[ 0 ] == 'v' && s[ 1 ] == 'n' && isBlank( s[ 2 ] ) ) {
+        s += 2;
+        Vector3 nrm;
+        if ( ! ( readReal( s, nrm[ 0 ] ) && readReal( s, nrm[ 1 ] ) && readReal( s, nrm[ 2 ] ) ) )
+          chunk.ok = false;
+        chunk.normals.push_back( nrm );
+      } else if ( s[ 0 ] == 'f' && isBlank( s[ 1 ] ) ) {
+        ++s;
+        v.clear(); n.clear(); v_rel.clear(); n_rel.clear();
+        bool has_normals = true;
+        for ( ;; ) {
+          skipBlanks( s );
+          if ( *s == '\n' || *s == '#' ) break;
+          int vi, ni = -1, ti;
+          bool vr, nr = false;
+          if ( ! readIndex( s, chunk.vertices.size(), vi, vr ) ) { chunk.ok = false; break; }
+          if ( *s == '/' ) {
+            ++s;
+            if ( *s != '/' && ! readInt( s, ti ) ) { chunk.ok = false; break; }
+            if ( *s == '/' ) {
+              ++s;
+              if ( ! readIndex( s, chunk.normals.size(), ni, nr ) ) { chunk.ok = false; break; }
+            }
+          }
+          if ( ni < 0 && ! nr ) has_normals = false;
+          v.push_back( vi ); v_rel.push_back( vr );
+          n.push_back( ni ); n_rel.push_back( nr );
+        }
+        if ( v.size() < 3 ) chunk.ok = false;
+        // polygons are split as fans of triangles.
+        for ( std::size_t k = 2; chunk.ok && k < v.size(); ++k ) {
+          const std::size_t c[ 3 ] = { 0, k - 1, k };
+          TriangleMesh::Triangle tri;
+          unsigned char rel = has_normals ? 64 : 0;
+          for ( int j = 0; j < 3; ++j ) {
+            tri.v[ j ] = v[ c[ j ] ];
+            tri.n[ j ] = has_normals ? n[ c[ j ] ] : -1;
+            if ( v_rel[ c[ j ] ] ) rel |= 1 << j;
+            if ( has_normals && n_rel[ c[ j ] ] ) rel |= 8 << j;
+          }
+          chunk.triangles.push_back( tri );
+          chunk.relative.push_back( rel );
+        }
+      }
+      // other lines (comments, texture coordinates, groups, materials)
+      // are ignored.
+      while ( *s != '\n' ) ++s;
+      ++s;
+    }
+  }
+
+} // namespace
+
+bool
+rt::TriangleMesh::loadOBJ( const std::string& file_name, int nb_threads )
+{
+  std::ifstream input( file_name.c_str(), std::ifstream::binary );
+  if ( ! input.good() ) {
+    std::cerr << "[TriangleMesh::loadOBJ] Cannot open " << file_name << std::endl;
+    return false;
+  }
+  input.seekg( 0, std::ifstream::end );
+  std::size_t size = (std::size_t) input.tellg();
+  input.seekg( 0, std::ifstream::beg );
+  // the file ends with a line end, which stops all the parsing loops.
+  std::vector< char > data( size + 1, '\n' );
+  input.read( data.data(), size );
+  if ( ! input.good() ) {
+    std::cerr << "[TriangleMesh::loadOBJ] Cannot read " << file_name << std::endl;
+    return false;
+  }
+
+  // The file is split in parts of whole lines, parsed in parallel.
+  std::vector< ObjChunk > chunks;
+  for ( std::size_t pos = 0; pos < size; ) {
+    std::size_t end = std::min( pos + OBJ_CHUNK_SIZE, size );
+    while ( end < size && data[ end - 1 ] != '\n' ) ++end;
+    ObjChunk chunk;
+    chunk.begin = data.data() + pos;
+    chunk.end   = data.data() + end;
+    chunks.push_back( chunk );
+    pos = end;
+  }
+  TileScheduler scheduler( nb_threads );
+  scheduler.run( TileScheduler::split( (int) chunks.size(), 1, 1 ),
+                 [&] ( const Tile& tile ) { parseChunk( chunks[ tile.x0 ] ); },
+                 [] ( int, int ) {} );
+
+  // Concatenates the parts and resolves the indices.
+  const int first_vertex = (int) vertices.size();
+  const int first_normal = (int) normals.size();
+  std::size_t nb_vertices = vertices.size(), nb_normals = normals.size(), nb_triangles = 0;
+  for ( const ObjChunk& chunk : chunks ) {
+    if ( ! chunk.ok ) {
+      std::cerr << "[TriangleMesh::loadOBJ] Syntax error in " << file_name << std::endl;
+      return false;
+    }
+    nb_vertices  += chunk.vertices.size();
+    nb_normals   += chunk.normals.size();
+    nb_triangles += chunk.triangles.size();
+  }
+  vertices.reserve( nb_vertices );
+  normals.reserve( nb_normals );
+  std::vector< Triangle > new_triangles;
+  new_triangles.reserve( nb_triangles );
+  for ( const ObjChunk& chunk : chunks ) {
+    const int vertex_offset = (int) vertices.size();
+    const int normal_offset = (int) normals.size();
+    for ( std::size_t i = 0; i < chunk.triangles.size(); ++i ) {
+      Triangle tri = chunk.triangles[ i ];
+      const unsigned char rel = chunk.relative[ i ];
+      for ( int j = 0; j < 3; ++j ) {
+        tri.v[ j ] += ( rel & ( 1 << j ) ) ? vertex_offset : first_vertex;
+        if ( tri.v[ j ] < first_vertex || tri.v[ j ] >= (int) nb_vertices ) {
+          std::cerr << "[TriangleMesh::loadOBJ] Invalid vertex index in " << file_name << std::endl;
+          vertices.resize( first_vertex );
+          normals.resize( first_normal );
+          return false;
+        }
+        if ( ! ( rel & 64 ) ) continue;
+        tri.n[ j ] += ( rel & ( 8 << j ) ) ? normal_offset : first_normal;
+        if ( tri.n[ j ] < first_normal || tri.n[ j ] >= (int) nb_normals ) {
+          std::cerr << "[TriangleMesh::loadOBJ] Invalid normal index in " << file_name << std::endl;
+          vertices.resize( first_vertex );
+          normals.resize( first_normal );
+          return false;
+        }
+      }
+      new_triangles.push_back( tri );
+    }
+    vertices.insert( vertices.end(), chunk.vertices.begin(), chunk.vertices.end() );
+    normals.insert( normals.end(), chunk.normals.begin(), chunk.normals.end() );
+  }
+  triangles.insert( triangles.end(), new_triangles.begin(), new_triangles.end() );
+  myIsPrepared = false;
+  return true;
+}
+
+int
+rt::TriangleMesh::addVertex( const Point3& p )
+{
+  vertices.push_back( p );
+  return (int) vertices.size() - 1;
+}
+
+int
+rt::TriangleMesh::addNormal( const Vector3& n )
+{
+  normals.push_back( n );
+  return (int) normals.size() - 1;
+}
+
+void
+rt::TriangleMesh::addTriangle( int a, int b, int c )
+{
+  Triangle tri = { { a, b, c }, { -1, -1, -1 } };
+  triangles.push_back( tri );
+  myIsPrepared = false;
+}
+
+void
+rt::TriangleMesh::addTriangle( int a, int b, int c, int na, int nb, int nc )
+{
+  Triangle tri = { { a, b, c }, { na, nb, nc } };
+  triangles.push_back( tri );
+  myIsPrepared = false;
+}
+
+void
+rt::TriangleMesh::fit( const Point3& center, Real size )
+{
+  if ( vertices.empty() ) return;
+  BoundingBox box;
+  for ( const Point3& p : vertices ) box.extend( p );
+  Vector3 extent = box.hi - box.lo;
+  Real largest = std::max( extent[ 0 ], std::max( extent[ 1 ], extent[ 2 ] ) );
+  Real scale   = largest > 0.0f ? size / largest : 1.0f;
+  Point3 middle = box.centroid();
+  for ( Point3& p : vertices ) p = center + ( p - middle ) * scale;
+  myIsPrepared = false;
+}
+
+void
+rt::TriangleMesh::setHierarchy( BVH bvh, std::vector< Point3 > corners,
+                                std::vector< int > triangle_index )
+{
+  myBVH           = std::move( bvh );
+  myCorners       = std::move( corners );
+  myTriangleIndex = std::move( triangle_index );
+  myIsPrepared    = true;
+}
+
+rt::Vector3
+rt::TriangleMesh::normal( int i, Real b1, Real b2 ) const
+{
+  const Triangle& tri = triangles[ i ];
+  Vector3 n;
+  if ( tri.n[ 0 ] >= 0 )
+    n = ( 1.0f - b1 - b2 ) * normals[ tri.n[ 0 ] ]
+      + b1 * normals[ tri.n[ 1 ] ] + b2 * normals[ tri.n[ 2 ] ];
+  else {
+    const Point3& p0 = vertices[ tri.v[ 0 ] ];
+    n = ( vertices[ tri.v[ 1 ] ] - p0 ).cross( vertices[ tri.v[ 2 ] ] - p0 );
+  }
+  Real l2 = n.dot( n );
+  if ( l2 != 0.0f ) n /= std::sqrt( l2 );
+  return n;
+}
+
+rt::Vector3
+rt::TriangleMesh::getNormal( Point3 p )
+{
+  int  closest = -1;
+  Real best    = std::numeric_limits<Real>::infinity();
+  Real b1 = 0.0f, b2 = 0.0f;
+  for ( int i = 0; i < size(); ++i ) {
+    const Triangle& tri = triangles[ i ];
+    const Point3& p0 = vertices[ tri.v[ 0 ] ];
+    Vector3 e1 = vertices[ tri.v[ 1 ] ] - p0;
+    Vector3 e2 = vertices[ tri.v[ 2 ] ] - p0;
+    Vector3 w  = p - p0;
+    // barycentric coordinates of the projection of p, clamped.
+    Real d11 = e1.dot( e1 ), d12 = e1.dot( e2 ), d22 = e2.dot( e2 );
+    Real den = d11 * d22 - d12 * d12;
+    if ( den == 0.0f ) continue;
+    Real u = ( d22 * w.dot( e1 ) - d12 * w.dot( e2 ) ) / den;
+    Real v = ( d11 * w.dot( e2 ) - d12 * w.dot( e1 ) ) / den;
+    u = std::max( 0.0f, u );
+    v = std::max( 0.0f, v );
+    if ( u + v > 1.0f ) { Real s = u + v; u /= s; v /= s; }
+    Real d = distance( p, p0 + u * e1 + v * e2 );
+    if ( d < best ) { best = d; closest = i; b1 = u; b2 = v; }
+  }
+  return closest >= 0 ? normal( closest, b1, b2 ) : Vector3( 0, 0, 1 );
+}
+
+const rt::Material&
+rt::TriangleMesh::getMaterial( Point3 /* p */ )
+{
+  return sharedMaterial(); // the material is constant along the mesh.
+}
+
+void
+rt::TriangleMesh::internMaterials( MaterialTable& materials )
+{
+  ptrMaterial = &materials[ materials.add( material ) ];
+}
+
+void
+rt::TriangleMesh::prepare()
+{
+  if ( myIsPrepared ) return;
+  const std::size_t n = triangles.size();
+  std::vector< BoundingBox > boxes( n );
+  for ( std::size_t i = 0; i < n; ++i )
+    for ( int j = 0; j < 3; ++j )
+      boxes[ i ].extend( vertices[ triangles[ i ].v[ j ] ] );
+  myBVH.build( boxes, 4 );
+  // The triangles are stored in the order of the leaves.
+  myCorners.resize( 3 * n );
+  myTriangleIndex.resize( n );
+  for ( std::size_t k = 0; k < n; ++k ) {
+    const int i = myBVH.indices[ k ];
+    myTriangleIndex[ k ] = i;
+    for ( int j = 0; j < 3; ++j )
+      myCorners[ 3 * k + j ] = vertices[ triangles[ i ].v[ j ] ];
+    myBVH.indices[ k ] = (int) k;
+  }
+  myIsPrepared = true;
+}
+
+bool
+rt::TriangleMesh::rayIntersection( const Ray& ray, RayHit& hit )
+{
+  const WatertightRay r( ray );
+  Real t_max = hit.t;
+  int  best  = -1;
+  Real b1 = 0.0f, b2 = 0.0f;
+  myBVH.closestHit( ray, t_max, [&] ( int i, Real& t ) {
+      Real ti, u, v;
+      if ( ! intersectTriangle( r, &myCorners[ 3 * i ], t, ti, u, v ) ) return false;
+      t = ti; best = i; b1 = u; b2 = v;
+      return true;
+    } );
+  if ( best < 0 ) return false;
+  hit.t        = t_max;
+  hit.point    = madd( ray.origin, t_max, ray.direction );
+  hit.normal   = normal( myTriangleIndex[ best ], b1, b2 );
+  hit.material = &sharedMaterial();
+  hit.uv       = Vector2( b1, b2 );
+  hit.object   = this;
+  return true;
+}
+
+void
+rt::TriangleMesh::packetIntersection( const RayPacket& packet, RayPacketHit& hit )
+{
+  if ( ! packet.coherent ) {
+    GraphicalObject::packetIntersection( packet, hit );
+    return;
+  }
+  const WatertightRay r[ RayPacket::SIZE ] = {
+    WatertightRay( packet.rays[ 0 ] ), WatertightRay( packet.rays[ 1 ] ),
+    WatertightRay( packet.rays[ 2 ] ), WatertightRay( packet.rays[ 3 ] ) };
+  myBVH.closestHit( packet, hit, [&] ( int i ) {
+      for ( int k = 0; k < RayPacket::SIZE; ++k ) {
+        Real t, u, v;
+        if ( intersectTriangle( r[ k ], &myCorners[ 3 * i ], hit.t[ k ], t, u, v ) ) {
+          hit.t[ k ]      = t;
+          hit.object[ k ] = this;
+        }
+      }
+    } );
+}
+
+bool
+rt::TriangleMesh::getBoundingBox( BoundingBox& box )
+{
+  if ( triangles.empty() ) return false;
+  if ( ! myBVH.empty() ) {
+    box = myBVH.nodes[ 0 ].box;
+    return true;
+  }
+  box = BoundingBox();
+  for ( const Triangle& tri : triangles )
+    for ( int j = 0; j < 3; ++j ) box.extend( vertices[ tri.v[ j ] ] );
+  return true;
+}
+
+bool
+rt::TriangleMesh::occluded( const Ray& ray, Real tMax, bool& transparent )
+{
+  const WatertightRay r( ray );
+  bool crossed = myBVH.anyHit( ray, tMax, [&] ( int i ) {
+      Real t, u, v;
+      return intersectTriangle( r, &myCorners[ 3 * i ], tMax, t, u, v );
+    } );
+  if ( ! crossed ) return false;
+  if ( sharedMaterial().coef_refraction == 0.0f ) return true;
+  transparent = true;
+  return false;
+}
@@ -0,0 +1,161 @@
+/**
+@file TriangleMesh.h
+*/
+#pragma once
+#ifndef _TRIANGLE_MESH_H_
+#define _TRIANGLE_MESH_H_
+
+#include <string>
+#include <vector>
+#include "GraphicalObject.h"
+#include "BVH.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// A mesh of triangles of one material, with indexed vertices and
+  /// (optional) vertex normals, e.g. loaded from an OBJ file. The mesh
+  /// is a single primitive of the scene, with its own bounding volume
+  /// hierarchy over its triangles, built by prepare().
+  ///
+  /// Rays are intersected with the watertight algorithm of Woop,
+  /// Benthin and Wald (JCGT 2013): a ray that hits an edge or a vertex
+  /// shared by several triangles hits at least one of them, so that no
+  /// ray leaks through a closed mesh.
+  struct TriangleMesh final : public GraphicalObject {
+
+    /// A triangle, given by the indices of its vertices and of their
+    /// normals (n[0] < 0 if the triangle is flat).
+    struct Triangle {
+      int v[ 3 ];
+      int n[ 3 ];
+    };
+
+    /// Virtual destructor since object contains virtual methods.
+    virtual ~TriangleMesh() {}
+
+    /// Creates an empty mesh of material \a m.
+    TriangleMesh( const Material& m )
+      : GraphicalObject(), material( m ), ptrMaterial( nullptr ), myIsPrepared( false ) {}
+
+    /// Reads the vertices, normals and faces of the OBJ file \a
+    /// file_name, with \a nb_threads threads (0 means one per core), and
+    /// adds them to the mesh. Polygons are split into triangles, texture
+    /// coordinates, groups and materials of the file are ignored.
+    /// @return 'false' if the file cannot be read or is not valid.
+    bool loadOBJ( const std::string& file_name, int nb_threads = 0 );
+
+    /// Adds the vertex \a p. @return its index.
+    int addVertex( const Point3& p );
+
+    /// Adds the normal \a n. @return its index.
+    int addNormal( const Vector3& n );
+
+    /// Adds the flat triangle of vertices \a a, \a b, \a c.
+    void addTriangle( int a, int b, int c );
+
+    /// Adds the triangle of vertices \a a, \a b, \a c whose normals are
+    /// \a na, \a nb, \a nc.
+    void addTriangle( int a, int b, int c, int na, int nb, int nc );
+
+    /// Moves and scales the mesh so that its bounding box is centered on
+    /// \a center and its largest side is \a size.
+    void fit( const Point3& center, Real size );
+
+    /// @return the number of triangles.
+    int size() const { return (int) triangles.size(); }
+
+    /// @return the hierarchy built by prepare(), whose leaves refer to
+    /// the triangles of corners().
+    const BVH& hierarchy() const { return myBVH; }
+
+    /// @return the three vertices of each triangle, in the order of the
+    /// leaves of hierarchy().
+    const std::vector< Point3 >& corners() const { return myCorners; }
+
+    /// @return the index in triangles of each triangle of corners().
+    const std::vector< int >& triangleIndex() const { return myTriangleIndex; }
+
+    /// Sets the hierarchy, corners and triangle indices computed by
+    /// prepare() for the same triangles (e.g. read from a SceneCache):
+    /// prepare() then does nothing until the mesh is modified.
+    void setHierarchy( BVH bvh, std::vector< Point3 > corners, std::vector< int > triangle_index );
+
+    // ---------------- GraphicalObject services ----------------------------
+  public:
+
+    /// @return ObjectType::TriangleMesh.
+    ObjectType objectType() const { return ObjectType::TriangleMesh; }
+
+    /// @return the normal vector at point \a p on the triangle closest
+    /// to \a p. It tests all triangles: rendering reads the normals of
+    /// RayHit instead.
+    Vector3 getNormal( Point3 p );
+
+    /// @return the material of the mesh.
+    const Material& getMaterial( Point3 p );
+
+    /// Shares its material through the table \a materials.
+    void internMaterials( MaterialTable& materials );
+
+    /// Builds the hierarchy of the triangles, unless the mesh was not
+    /// modified since. The mesh is hit only once it has been prepared
+    /// (see Scene::prepare).
+    void prepare();
+
+    /// @param[in] ray the incoming ray
+    /// @param[in,out] hit filled if the mesh is hit closer than \a hit.t.
+    ///
+    /// @return 'true' if there is an intersection closer than \a hit.t.
+    bool rayIntersection( const Ray& ray, RayHit& hit );
+
+    /// Traverses the hierarchy once for a coherent packet of rays, see
+    /// GraphicalObject::packetIntersection.
+    void packetIntersection( const RayPacket& packet, RayPacketHit& hit );
+
+    /// @param[out] box the bounding box of the mesh.
+    /// @return 'true' unless the mesh is empty.
+    bool getBoundingBox( BoundingBox& box );
+
+    /// Any-hit query for shadow rays, see GraphicalObject::occluded.
+    bool occluded( const Ray& ray, Real tMax, bool& transparent );
+
+  public:
+    /// The vertices (the mesh must be modified through its methods, or
+    /// prepare() may keep an obsolete hierarchy).
+    std::vector< Point3 > vertices;
+    /// The vertex normals.
+    std::vector< Vector3 > normals;
+    /// The triangles.
+    std::vector< Triangle > triangles;
+    /// The material (global to the mesh).
+    Material material;
+
+  private:
+    /// The copy of material in the table of the scene, or 0 before
+    /// internMaterials.
+    const Material* ptrMaterial;
+    /// The hierarchy over the triangles. Its leaves refer to consecutive
+    /// triangles of myCorners.
+    BVH myBVH;
+    /// The three vertices of each triangle, in the order of the leaves
+    /// of myBVH, so that a leaf is read sequentially.
+    std::vector< Point3 > myCorners;
+    /// The index in triangles of each triangle of myCorners.
+    std::vector< int > myTriangleIndex;
+    /// 'true' when myBVH is up to date with the triangles.
+    bool myIsPrepared;
+
+    /// @return the material used for rendering.
+    const Material& sharedMaterial() const
+    { return ptrMaterial != nullptr ? *ptrMaterial : material; }
+
+    /// @return the normal of triangle \a i (of triangles) at the point of
+    /// barycentric coordinates \a b1, \a b2 w.r.t. its second and third
+    /// vertices.
+    Vector3 normal( int i, Real b1, Real b2 ) const;
+  };
+
+} // namespace rt
+
+#endif // #define _TRIANGLE_MESH_H_
@@ -4,24 +4,173 @@
 */
 #include <fstream>
 #include "Viewer.h"
+#include "GLDraw.h"
 #include "Scene.h"
 #include "Renderer.h"
+#include "ProgressiveRenderer.h"
 #include "Image2D.h"
 #include "Image2DWriter.h"
 #include "Image2DReader.h"
 
 using namespace std;
 
-// Draws a tetrahedron with 4 colors.
+rt::Viewer::~Viewer()
+{
+  delete ptrRender;
+  delete ptrBackground;
+  for ( qglviewer::ManipulatedFrame* manipulator : myLightManipulators )
+    delete manipulator;
+}
+
+// Draws the objects and the lights of the scene.
 void 
 rt::Viewer::draw()
 {
+  if ( ptrScene == 0 ) return;
+  // The render is obsolete as soon as the camera or a light moves. It
+  // is stopped before glLight updates the lights that it uses.
+  if ( myOverlay && viewState() != myRenderState )
+    stopRender();
   // Set up lights
-  if ( ptrScene != 0 )
-    ptrScene->light( *this );
+  for ( std::size_t i = 0; i < ptrScene->myLights.size(); ++i )
+    glLight( *this, ptrScene->myLights[ i ], myLightManipulators[ i ] );
   // Draw all objects
-  if ( ptrScene != 0 )
-    ptrScene->draw( *this );
+  for ( GraphicalObject* obj : ptrScene->myObjects )
+    glDraw( *this, obj );
+  for ( std::size_t i = 0; i < ptrScene->myLights.size(); ++i )
+    glDraw( *this, ptrScene->myLights[ i ], myLightManipulators[ i ] );
+  if ( myOverlay ) drawRender();
+}
+
+// Copies the last image of the render into the texture and draws it
+// over the whole window.
+void
+rt::Viewer::drawRender()
+{
+  Image2D<Color> image;
+  if ( myTexture == 0 ) glGenTextures( 1, &myTexture );
+  glBindTexture( GL_TEXTURE_2D, myTexture );
+  if ( ptrRender->fetch( image ) )
+    {
+      std::vector<unsigned char> bytes;
+      bytes.reserve( 3 * (std::size_t) image.w() * image.h() );
+      for ( int y = 0; y < image.h(); ++y )
+        for ( int x = 0; x < image.w(); ++x )
+          {
+            Color c = image.at( x, y );
+            bytes.push_back( (unsigned char) ( c.r() * 255.0f ) );
+            bytes.push_back( (unsigned char) ( c.g() * 255.0f ) );
+            bytes.push_back( (unsigned char) ( c.b() * 255.0f ) );
+          }
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, image.w(), image.h(), 0,
+                    GL_RGB, GL_UNSIGNED_BYTE, bytes.data() );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    }
+  glPushAttrib( GL_ENABLE_BIT | GL_CURRENT_BIT );
+  glDisable( GL_LIGHTING );
+  glDisable( GL_DEPTH_TEST );
+  glEnable( GL_TEXTURE_2D );
+  glColor3f( 1.0f, 1.0f, 1.0f );
+  startScreenCoordinatesSystem();
+  glBegin( GL_QUADS );
+  glTexCoord2f( 0.0f, 0.0f ); glVertex2i( 0, 0 );
+  glTexCoord2f( 1.0f, 0.0f ); glVertex2i( width(), 0 );
+  glTexCoord2f( 1.0f, 1.0f ); glVertex2i( width(), height() );
+  glTexCoord2f( 0.0f, 1.0f ); glVertex2i( 0, height() );
+  glEnd();
+  stopScreenCoordinatesSystem();
+  glPopAttrib();
+}
+
+// Saves the image once the render is finished. The window itself is
+// redrawn by QGLViewer after each call.
+void
+rt::Viewer::animate()
+{
+  if ( ptrRender == 0 || ptrRender->isRunning() ) return;
+  stopAnimation();
+  if ( ptrRender->passes() < ptrRender->nbPasses() ) return; // cancelled
+  Image2D<Color> image = ptrRender->image();
+  ofstream output( "output.ppm" );
+  Image2DWriter<Color>::write( image, output, true );
+  output.close();
+  std::cout << "Done (" << ptrRender->passes() << " passes), saved in output.ppm." << std::endl;
+  if ( ptrRender->isAdaptive() )
+    std::cout << "Antialiasing: " << ptrRender->samplesSpent() << " samples ("
+              << (double) ptrRender->samplesSpent() / ( image.w() * image.h() ) << " per pixel), "
+              << ptrRender->nbRefined() << " pixels refined." << std::endl;
+}
+
+std::vector<double>
+rt::Viewer::viewState() const
+{
+  std::vector<double> state;
+  qglviewer::Vec p = camera()->position();
+  qglviewer::Quaternion q = camera()->orientation();
+  state.insert( state.end(), { p[ 0 ], p[ 1 ], p[ 2 ], q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ] } );
+  for ( qglviewer::ManipulatedFrame* manipulator : myLightManipulators )
+    if ( manipulator != 0 )
+      {
+        qglviewer::Vec l = manipulator->position();
+        state.insert( state.end(), { l[ 0 ], l[ 1 ], l[ 2 ] } );
+      }
+  return state;
+}
+
+void
+rt::Viewer::startRender( int w, int h )
+{
+  stopRender();
+  Image2D<Color> img;
+
+  std::ifstream input("../TP2/sky.ppm", std::ifstream::binary);
+  bool ok1 = Image2DReader<Color>::read(img, input, false);
+  if (!ok1) {
+      std::cerr << "Error reading input file." << std::endl;
+  }
+  input.close();
+
+  delete ptrBackground;
+  ptrBackground = new MyBackground(img);
+
+  Renderer renderer( *ptrScene, ptrBackground );
+  int sw = camera()->screenWidth();
+  int sh = camera()->screenHeight();
+  qglviewer::Vec orig, dir;
+  camera()->convertClickToLine( QPoint( 0,0 ), orig, dir );
+  Vector3 origin( orig );
+  Vector3 dirUL( dir );
+  camera()->convertClickToLine( QPoint( sw,0 ), orig, dir );
+  Vector3 dirUR( dir );
+  camera()->convertClickToLine( QPoint( 0, sh ), orig, dir );
+  Vector3 dirLL( dir );
+  camera()->convertClickToLine( QPoint( sw, sh ), orig, dir );
+  Vector3 dirLR( dir );
+  renderer.setViewBox( origin, dirUL, dirUR, dirLL, dirLR );
+  renderer.setStochastic( stochastic );
+  // One sample per pixel and per pass, the antialiasing refines the
+  // noisy pixels and the edges after its first 4 passes.
+  if ( antialiasing ) renderer.setAntialiasing( 4, 16, 0.1f );
+  if ( ptrRender == 0 ) ptrRender = new ProgressiveRenderer;
+  ptrRender->start( renderer, w, h, maxDepth, stochastic ? samplesPerPixel : 1 );
+  std::cout << "Rendering " << w << "x" << h << " in " << ptrRender->nbPasses()
+            << " passes in the background." << std::endl;
+  if ( ptrRender->reusesHits() )
+    std::cout << "Same camera: the primary hits are shaded again." << std::endl;
+  myRenderState = viewState();
+  myOverlay = true;
+  setAnimationPeriod( 100 );
+  startAnimation();
+}
+
+void
+rt::Viewer::stopRender()
+{
+  if ( ptrRender != 0 ) ptrRender->cancel();
+  if ( animationIsStarted() ) stopAnimation();
+  myOverlay = false;
 }
 
 
@@ -35,8 +184,13 @@ rt::Viewer::init()
   setKeyDescription(Qt::Key_R, "Renders the scene with a ray-tracer (low resolution)");
   setKeyDescription(Qt::SHIFT+Qt::Key_R, "Renders the scene with a ray-tracer (medium resolution)");
   setKeyDescription(Qt::CTRL+Qt::Key_R, "Renders the scene with a ray-tracer (high resolution)");
+  setKeyDescription(Qt::Key_C, "Cancels the render and hides it");
   setKeyDescription(Qt::Key_D, "Augments the max depth of ray-tracing algorithm");
   setKeyDescription(Qt::SHIFT+Qt::Key_D, "Decreases the max depth of ray-tracing algorithm");
+  setKeyDescription(Qt::Key_T, "Toggles stochastic ray-tracing (one random branch per hit)");
+  setKeyDescription(Qt::Key_N, "Augments the number of samples per pixel of stochastic ray-tracing");
+  setKeyDescription(Qt::SHIFT+Qt::Key_N, "Decreases the number of samples per pixel of stochastic ray-tracing");
+  setKeyDescription(Qt::Key_X, "Toggles adaptive antialiasing");
   
   // Opens help window
   help();
@@ -46,7 +200,13 @@ rt::Viewer::init()
 
   // Inits the scene
   if ( ptrScene != 0 )
-    ptrScene->init( *this );
+    {
+      for ( GraphicalObject* obj : ptrScene->myObjects )
+        glInit( *this, obj );
+      myLightManipulators.assign( ptrScene->myLights.size(), 0 );
+      for ( std::size_t i = 0; i < ptrScene->myLights.size(); ++i )
+        glInit( *this, ptrScene->myLights[ i ], myLightManipulators[ i ] );
+    }
   
   // Gives a bounding box to the camera
   camera()->setSceneBoundingBox( qglviewer::Vec( -12, -12, -2 ),qglviewer::Vec( 12, 12, 22 ) );
@@ -63,38 +223,15 @@ rt::Viewer::keyPressEvent(QKeyEvent *e)
     {
       int w = camera()->screenWidth();
       int h = camera()->screenHeight();
-
-      Image2D<Color> img;
-
-      std::ifstream input("../TP2/sky.ppm", std::ifstream::binary);
-      bool ok1 = Image2DReader<Color>::read(img, input, false);
-      if (!ok1) {
-          std::cerr << "Error reading input file." << std::endl;
-      }
-      input.close();
-
-      MyBackground bg(img);
-
-      Renderer renderer( *ptrScene, &bg );
-      qglviewer::Vec orig, dir;
-      camera()->convertClickToLine( QPoint( 0,0 ), orig, dir );
-      Vector3 origin( orig );
-      Vector3 dirUL( dir );
-      camera()->convertClickToLine( QPoint( w,0 ), orig, dir );
-      Vector3 dirUR( dir );
-      camera()->convertClickToLine( QPoint( 0, h ), orig, dir );
-      Vector3 dirLL( dir );
-      camera()->convertClickToLine( QPoint( w, h ), orig, dir );
-      Vector3 dirLR( dir );
-      renderer.setViewBox( origin, dirUL, dirUR, dirLL, dirLR );
       if ( modifiers == Qt::ShiftModifier ) { w /= 2; h /= 2; }
       else if ( modifiers == Qt::NoModifier ) { w /= 8; h /= 8; }
-      Image2D<Color> image( w, h );
-      renderer.setResolution( image.w(), image.h() );
-     renderer.render( image, maxDepth );
-      ofstream output( "output.ppm" );
-      Image2DWriter<Color>::write( image, output, true );
-      output.close();
+      startRender( w, h );
+      handled = true;
+    }
+  if ((e->key()==Qt::Key_C) && modifiers == Qt::NoModifier)
+    {
+      stopRender();
+      update();
       handled = true;
     }
   if (e->key()==Qt::Key_D)
@@ -105,6 +242,26 @@ rt::Viewer::keyPressEvent(QKeyEvent *e)
         { maxDepth = std::min( 20, maxDepth + 1 ); handled = true; }
       std::cout << "Max depth is " << maxDepth << std::endl; 
     }
+  if ((e->key()==Qt::Key_T) && modifiers == Qt::NoModifier)
+    {
+      stochastic = ! stochastic;
+      handled = true;
+      std::cout << "Stochastic ray-tracing is " << ( stochastic ? "on" : "off" ) << std::endl;
+    }
+  if (e->key()==Qt::Key_N)
+    {
+      if ( modifiers == Qt::ShiftModifier )
+        { samplesPerPixel = std::max( 1, samplesPerPixel / 2 ); handled = true; }
+      if ( modifiers == Qt::NoModifier )
+        { samplesPerPixel = std::min( 1024, samplesPerPixel * 2 ); handled = true; }
+      std::cout << "Samples per pixel: " << samplesPerPixel << std::endl;
+    }
+  if ((e->key()==Qt::Key_X) && modifiers == Qt::NoModifier)
+    {
+      antialiasing = ! antialiasing;
+      handled = true;
+      std::cout << "Adaptive antialiasing is " << ( antialiasing ? "on" : "off" ) << std::endl;
+    }
     
   if (!handled) QGLViewer::keyPressEvent(e);
 }
@@ -130,5 +287,9 @@ rt::Viewer::helpString() const
   text += "Press <b>R</b> to render the scene (low resolution).";
   text += "Press <b>Shift+R</b> to render the scene (medium resolution).";
   text += "Press <b>Ctrl+R</b> to render the scene (high resolution).";
+  text += "Renders run in the background and are displayed as they converge, moving the camera or a light cancels them. ";
+  text += "Press <b>C</b> to cancel the render and hide it.";
+  text += "Press <b>T</b> to toggle stochastic ray-tracing, <b>N</b>/<b>Shift+N</b> to change its number of samples per pixel.";
+  text += "Press <b>X</b> to toggle adaptive antialiasing.";
   return text;
 }
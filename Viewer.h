@@ -9,11 +9,16 @@
 #include <vector>
 #include <QKeyEvent>
 #include <QGLViewer/qglviewer.h>
+#include <QGLViewer/manipulatedFrame.h>
 
 namespace rt {
   
   /// Forward declaration of class Scene
   struct Scene;
+  /// Forward declaration of class Background
+  struct Background;
+  /// Forward declaration of class ProgressiveRenderer
+  struct ProgressiveRenderer;
 
   /// This class displays the interface for placing the camera and the
   /// lights, and the user may call the renderer from it.
@@ -21,7 +26,12 @@ namespace rt {
   {
   public:
     /// Default constructor. Scene is empty.
-    Viewer() : QGLViewer(), ptrScene( 0 ), maxDepth( 6 ) {}
+    Viewer() : QGLViewer(), ptrScene( 0 ), maxDepth( 6 ),
+               stochastic( false ), samplesPerPixel( 4 ), antialiasing( false ),
+               ptrRender( 0 ), ptrBackground( 0 ), myTexture( 0 ), myOverlay( false ) {}
+
+    /// Destructor. Stops the render and frees the light manipulators.
+    ~Viewer();
     
     /// Sets the scene
     void setScene( rt::Scene& aScene )
@@ -49,12 +59,53 @@ namespace rt {
     virtual QString helpString() const;
     /// Celled when pressing a key.
     virtual void keyPressEvent(QKeyEvent *e);
+    /// Called periodically while a render is running.
+    virtual void animate();
+
+    /// Starts rendering the scene in the background, with the given
+    /// resolution, and displays it over the scene as it converges.
+    void startRender( int w, int h );
+    /// Stops the render, if any, and hides it.
+    void stopRender();
+    /// Draws the current image of the render over the scene.
+    void drawRender();
+    /// @return the position of the camera and of the lights, so as to
+    /// detect that the rendered view is obsolete.
+    std::vector<double> viewState() const;
     
     /// Stores the scene
     rt::Scene* ptrScene;
 
     /// Maximum depth
     int maxDepth;
+
+    /// When 'true', renders follow one random branch per hit.
+    bool stochastic;
+
+    /// Samples per pixel of stochastic renders.
+    int samplesPerPixel;
+
+    /// When 'true', renders use adaptive antialiasing.
+    bool antialiasing;
+
+    /// The manipulators used to move the lights of the scene (same
+    /// order as Scene::myLights, 0 for lights that cannot be moved).
+    std::vector< qglviewer::ManipulatedFrame* > myLightManipulators;
+
+    /// The background render, 0 before the first one.
+    rt::ProgressiveRenderer* ptrRender;
+
+    /// The background of the renders (the sky).
+    rt::Background* ptrBackground;
+
+    /// The texture displaying the render, 0 until it is created.
+    GLuint myTexture;
+
+    /// When 'true', the render is displayed over the scene.
+    bool myOverlay;
+
+    /// The view state when the render was started (see viewState).
+    std::vector<double> myRenderState;
   };
 }
 
@@ -4,7 +4,9 @@
 namespace rt {
     WaveData::WaveData(float r, float a, float l, float phi) : r(r), a(a), l(l), phi(phi) { }
 
-    WaterPlane::WaterPlane(Point3 _c1, Vector3 _u1, Vector3 _v1, Material _main_m1) : PeriodicPlane(_c1, _u1, _v1, _main_m1, Material::black_plastic(), 0.f) {
+    WaterPlane::WaterPlane(Point3 _c1, Vector3 _u1, Vector3 _v1, Material _main_m1)
+        : PeriodicPlane(_c1, _u1, _v1, _main_m1, Material::black_plastic(), 0.f),
+          myNoiseResolution(0), myNoisePeriod(8) {
         myWaves.emplace_back(0.1f, 3.2f, 2.4f, 0.0f);
         myWaves.emplace_back(0.2f, 2.4f, 0.8f, 0.0f);
         myWaves.emplace_back(0.23f, 1.1f, 1.31f, 0.0f);
@@ -25,14 +27,26 @@ namespace rt {
         }
 
         // then add worley noise
-        double pos[3] = {p[0] * 2.f, p[1] * 2.f, p[2] * 2.f};
-        distortion += static_cast<float>(Worley(pos) * 0.75f);
+        Real pos[3] = {p[0] * 2.f, p[1] * 2.f, p[2] * 2.f};
+        Real noise = myNoise.empty() ? Worley(pos) : myNoise.value(Point3(pos));
+        distortion += noise * 0.75f;
 
         n[2] = distortion;
         return n;
     }
 
-    Material WaterPlane::getMaterial(Point3 /* p */) {
-        return material_main;
+    void WaterPlane::setNoiseVolume(int resolution, int period) {
+        myNoiseResolution = resolution;
+        myNoisePeriod = period;
+        myNoise = NoiseVolume();
+    }
+
+    void WaterPlane::prepare() {
+        if (myNoiseResolution > 0 && myNoise.empty())
+            myNoise.build(myNoiseResolution, myNoisePeriod);
+    }
+
+    const Material& WaterPlane::materialAt(Real /* x */, Real /* y */) {
+        return mainMaterial();
     }
 }
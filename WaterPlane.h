@@ -1,7 +1,9 @@
 #ifndef TP2_WATERPLANE_H
 #define TP2_WATERPLANE_H
 
+#include <vector>
 #include "PeriodicPlane.h"
+#include "NoiseVolume.h"
 namespace rt {
 
     struct WaveData {
@@ -13,18 +15,36 @@ namespace rt {
         Real phi;
     };
 
-    struct WaterPlane : public rt::PeriodicPlane {
+    struct WaterPlane final : public rt::PeriodicPlane {
 
         std::vector<WaveData> myWaves;
 
+        /// Resolution of the precomputed noise (0 to compute the exact
+        /// Worley noise at each point).
+        int myNoiseResolution;
+        /// Period of the precomputed noise, in cubes of the Worley noise.
+        int myNoisePeriod;
+        /// The precomputed noise, built by prepare().
+        NoiseVolume myNoise;
+
         WaterPlane(rt::Point3 _c, rt::Vector3 _u, rt::Vector3 _v, rt::Material _main_m);
 
+        /// Uses a precomputed periodic noise of \a resolution^3 samples
+        /// instead of the exact Worley noise, which is much faster but
+        /// smoother. A \a resolution of 0 restores the exact noise (e.g.
+        /// for reference renders).
+        void setNoiseVolume(int resolution, int period = 8);
+
+        /// Builds the precomputed noise, if any.
+        void prepare() override;
+
         /// @return the normal vector at point \a p on the sphere (\a p
         /// should be on or close to the sphere).
         Vector3 getNormal(Point3 p) override;
 
-        /// @return the material associated to this part of the object
-        Material getMaterial(Point3 p) override;
+        /// @return the material at the point of coordinates \a x and \a y,
+        /// which is the same everywhere on the water.
+        const Material& materialAt(Real x, Real y) override;
     };
 }
 
@@ -0,0 +1,235 @@
+/**
+@file WavefrontRenderer.h
+*/
+#pragma once
+#ifndef _WAVEFRONT_RENDERER_H_
+#define _WAVEFRONT_RENDERER_H_
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include "Renderer.h"
+
+/// Namespace RayTracer
+namespace rt {
+
+  /// An iterative alternative to the recursive Renderer::trace. The
+  /// pixels of a tile are rendered together, one generation of rays at
+  /// a time: each stage (extend, background, shade, shadow) processes
+  /// the whole queue of its rays before the next one starts, and the
+  /// rays are compacted into the queue of the stage they need next. The
+  /// ray trees are kept, and their colors are summed at the end, from
+  /// the leaves up, in the same order as trace does: the image is the
+  /// same as the one of the deterministic Renderer::render.
+  ///
+  /// It uses the scene, camera and background of a Renderer, and
+  /// ignores its stochastic and antialiasing modes.
+  struct WavefrontRenderer {
+
+    /// A node of the ray tree of a pixel.
+    struct PathNode {
+      /// The ray.
+      Ray ray;
+      /// Its closest intersection, if it hits the scene.
+      RayHit hit;
+      /// 'true' if the ray hits the scene.
+      bool found;
+      /// Index of the reflected and refracted rays (-1 for none).
+      int reflected, refracted;
+      /// Index of its first query in the shadow queue, and number of
+      /// its queries.
+      int first_shadow, nb_shadows;
+      /// The direct illumination at the hit.
+      Color direct;
+      /// The color of the ray, once resolved.
+      Color value;
+    };
+
+    /// A shadow ray towards a light, see Renderer::shadow.
+    struct ShadowQuery {
+      /// The ray from the point to the light.
+      Ray ray;
+      /// The color of the light, then the light received.
+      Color color;
+      /// The distance to the light.
+      Real distance;
+    };
+
+    /// Uses the scene, camera and settings of \a renderer.
+    explicit WavefrontRenderer( Renderer& renderer )
+      : myRenderer( renderer ), myTileSize( 64 ), myNbRays( 0 ), myNbShadowRays( 0 ) {}
+
+    /// Sets the size of the tiles, i.e. the number of primary rays of
+    /// a batch is \a tile_size^2.
+    void setTileSize( int tile_size ) { myTileSize = std::max( 1, tile_size ); }
+
+    /// Renders the scene into \a image, as Renderer::render does in
+    /// deterministic mode.
+    void render( Image2D<Color>& image, int max_depth )
+    {
+      Renderer& r = myRenderer;
+      std::cout << "Rendering into image (wavefront) ... might take a while." << std::endl;
+      image = Image2D<Color>( r.myWidth, r.myHeight );
+      r.prepare();
+      myNbRays       = 0;
+      myNbShadowRays = 0;
+      TileScheduler scheduler( r.myNbThreads );
+      scheduler.run( TileScheduler::split( r.myWidth, r.myHeight, myTileSize ),
+                     [&] ( const Tile& tile ) { renderTile( image, tile, max_depth ); },
+                     [] ( int done, int total ) { progressBar( std::cout, done, total ); } );
+      r.mySamplesSpent = (long) r.myWidth * r.myHeight;
+      std::cout << "Done." << std::endl;
+      std::cout << "Wavefront: " << myNbRays << " rays, "
+                << myNbShadowRays << " shadow rays." << std::endl;
+    }
+
+    /// Renders the pixels of \a tile into \a image.
+    void renderTile( Image2D<Color>& image, const Tile& tile, int max_depth )
+    {
+      Renderer& r = myRenderer;
+      Scene& scene = *r.ptrScene;
+      std::vector<PathNode> nodes;
+      std::vector<ShadowQuery> shadows;
+      std::vector<int> extend, next, shade;
+      // Primary rays, one node per pixel in scan order.
+      for ( int y = tile.y0; y < tile.y1; ++y )
+        for ( int x = tile.x0; x < tile.x1; ++x ) {
+          extend.push_back( (int) nodes.size() );
+          nodes.push_back( newNode( Ray( r.myOrigin, r.direction( (Real) x, (Real) y ), max_depth ) ) );
+        }
+      bool primary = true;
+      long nb_rays = 0, nb_shadow_rays = 0;
+      while ( ! extend.empty() ) {
+        nb_rays += (long) extend.size();
+        // Extend: closest hits (by packets for the coherent primary
+        // rays), then background rays are resolved at once.
+        std::size_t i = 0;
+        const int N = RayPacket::SIZE;
+        if ( primary )
+          for ( ; i + N <= extend.size(); i += N ) {
+            Ray rays[ N ];
+            RayHit hits[ N ];
+            for ( int k = 0; k < N; ++k ) rays[ k ] = nodes[ extend[ i + k ] ].ray;
+            int found = scene.rayIntersection( RayPacket( rays ), hits );
+            for ( int k = 0; k < N; ++k ) {
+              PathNode& node = nodes[ extend[ i + k ] ];
+              node.hit   = hits[ k ];
+              node.found = ( found >> k ) & 1;
+            }
+          }
+        for ( ; i < extend.size(); ++i ) {
+          PathNode& node = nodes[ extend[ i ] ];
+          node.found = scene.rayIntersection( node.ray, node.hit );
+        }
+        shade.clear();
+        for ( int n : extend ) {
+          if ( nodes[ n ].found ) shade.push_back( n );
+          else nodes[ n ].value = r.background( nodes[ n ].ray );
+        }
+        // Shade: shadow queries and secondary rays.
+        shadows.clear();
+        next.clear();
+        for ( int n : shade ) {
+          // nodes may grow: copy what is needed first.
+          const Ray ray = nodes[ n ].ray;
+          const RayHit hit = nodes[ n ].hit;
+          const Material& m = *hit.material;
+          nodes[ n ].first_shadow = (int) shadows.size();
+          r.sampleLights( ray, hit, nullptr, [&] ( const Vector3& direction, const Color& color, Real d ) {
+              ShadowQuery query;
+              query.ray      = Ray( hit.point, direction );
+              query.color    = color;
+              query.distance = d;
+              shadows.push_back( query );
+            } );
+          nodes[ n ].nb_shadows = (int) shadows.size() - nodes[ n ].first_shadow;
+          if ( ray.depth > 0 ) {
+            if ( m.coef_reflexion != 0 ) {
+              Vector3 direction_refl = r.reflect( ray.direction, hit.normal );
+              nodes[ n ].reflected = (int) nodes.size();
+              next.push_back( (int) nodes.size() );
+              nodes.push_back( newNode( Ray( hit.point + direction_refl * 0.001f,
+                                             direction_refl, ray.depth - 1 ) ) );
+            }
+            if ( m.coef_refraction != 0 ) {
+              Ray ray_refraction = r.refractionRay( ray, hit.point, hit.normal, m );
+              if ( ray_refraction.depth > 0 ) {
+                nodes[ n ].refracted = (int) nodes.size();
+                next.push_back( (int) nodes.size() );
+                nodes.push_back( newNode( ray_refraction ) );
+              }
+            }
+          }
+        }
+        // Shadow: the light received from each light.
+        nb_shadow_rays += (long) shadows.size();
+        for ( ShadowQuery& query : shadows )
+          query.color = r.shadow( query.ray, query.color, query.distance );
+        // Direct illumination, as Renderer::illumination.
+        for ( int n : shade ) {
+          PathNode& node = nodes[ n ];
+          const Material& m = *node.hit.material;
+          Vector3 w = r.reflect( node.ray.direction, node.hit.normal );
+          Color c;
+          for ( int k = 0; k < node.nb_shadows; ++k ) {
+            const ShadowQuery& query = shadows[ node.first_shadow + k ];
+            r.addLight( c, node.ray, m, node.hit.normal, w, query.ray.direction, query.color );
+          }
+          c += m.ambient;
+          node.direct = c;
+        }
+        extend.swap( next );
+        primary = false;
+      }
+      // Resolve the trees from the leaves, children come after their parent.
+      for ( int n = (int) nodes.size() - 1; n >= 0; --n ) {
+        PathNode& node = nodes[ n ];
+        if ( ! node.found ) continue;
+        const Material& m = *node.hit.material;
+        Color res( 0, 0, 0 );
+        if ( node.reflected >= 0 )
+          res += nodes[ node.reflected ].value * m.specular * m.coef_reflexion;
+        if ( node.refracted >= 0 )
+          res += nodes[ node.refracted ].value * m.diffuse * m.coef_refraction;
+        res += node.direct;
+        node.value = res;
+      }
+      int n = 0;
+      for ( int y = tile.y0; y < tile.y1; ++y )
+        for ( int x = tile.x0; x < tile.x1; ++x )
+          image.at( x, y ) = nodes[ n++ ].value.clamp();
+      myNbRays       += nb_rays;
+      myNbShadowRays += nb_shadow_rays;
+    }
+
+    /// @return the number of rays (without shadow rays) of the last render.
+    long nbRays() const { return myNbRays; }
+
+    /// @return the number of shadow rays of the last render.
+    long nbShadowRays() const { return myNbShadowRays; }
+
+  private:
+    /// The renderer giving the scene, camera and shading.
+    Renderer& myRenderer;
+    /// The size of the tiles.
+    int myTileSize;
+    /// Statistics of the last render.
+    std::atomic<long> myNbRays, myNbShadowRays;
+
+    /// @return a node for \a ray, without hit nor children.
+    static PathNode newNode( const Ray& ray )
+    {
+      PathNode node;
+      node.ray          = ray;
+      node.found        = false;
+      node.reflected    = -1;
+      node.refracted    = -1;
+      node.first_shadow = 0;
+      node.nb_shadows   = 0;
+      return node;
+    }
+  };
+
+} // namespace rt
+
+#endif // #define _WAVEFRONT_RENDERER_H_
@@ -0,0 +1,266 @@
+/**
+@file bench.cpp
+
+Micro-benchmark of the hot spots of the ray tracer: ray-sphere
+intersection (one sphere, and 64 spheres with or without SphereSet,
+whose shadow rays are also measured), ray-triangle mesh intersection,
+the illumination of a point, the directions of the camera rays, the
+reflected and refracted rays, the closest hits of primary rays (single
+rays and packets), the insertion of objects in a prepared scene and
+Worley noise. Build it twice to measure the gain of the vectorized
+PointVector and Worley noise:
+
+  qmake bench.pro && make                       (SSE)
+  qmake "DEFINES+=RT_NO_SIMD" bench.pro && make (scalar loops)
+*/
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "Scene.h"
+#include "DemoScene.h"
+#include "Sphere.h"
+#include "SphereSet.h"
+#include "TriangleMesh.h"
+#include "Renderer.h"
+#include "worley.h"
+
+using namespace std;
+using namespace rt;
+
+/// @return a pseudo-random number in [-1,1].
+static Real random11()
+{
+  return 2.0f * (Real) rand() / (Real) RAND_MAX - 1.0f;
+}
+
+/// Runs \a fn \a nb_calls times and prints the time of one call.
+template <typename Fn>
+static void measure( const char* name, long nb_calls, Fn fn )
+{
+  auto start = chrono::steady_clock::now();
+  fn();
+  auto stop  = chrono::steady_clock::now();
+  double ns = chrono::duration<double, nano>( stop - start ).count();
+  cout << name << ": " << ns / nb_calls << " ns/call" << endl;
+}
+
+int main( int argc, char** argv )
+{
+  int nb_rounds = argc > 1 ? atoi( argv[ 1 ] ) : 20;
+#if defined( __SSE2__ ) && ! defined( RT_NO_SIMD )
+  cout << "PointVector: SSE" << endl;
+#else
+  cout << "PointVector: scalar" << endl;
+#endif
+  srand( 0 );
+
+  // Rays from random origins towards random points near a unit sphere,
+  // half of them miss it.
+  Sphere sphere( Point3( 0, 0, 0 ), 1.0f, Material::glass() );
+  vector<Ray> rays;
+  for ( int i = 0; i < 100000; ++i ) {
+    Point3 o( 5.0f * random11(), 5.0f * random11(), 5.0f + random11() );
+    Point3 p( 1.5f * random11(), 1.5f * random11(), 1.5f * random11() );
+    rays.push_back( Ray( o, p - o ) );
+  }
+  long nb_hits = 0;
+  measure( "Sphere::rayIntersection", nb_rounds * (long) rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : rays ) {
+          RayHit hit;
+          if ( sphere.rayIntersection( ray, hit ) ) nb_hits += 1;
+        }
+    } );
+
+  // The same rays against 64 spheres, one object per sphere or a
+  // single SphereSet.
+  vector<GraphicalObject*> sphere_objects;
+  SphereSet sphere_set;
+  for ( int i = 0; i < 64; ++i ) {
+    Point3 c( 4.0f * random11(), 4.0f * random11(), 4.0f * random11() );
+    Real r = 0.2f + 0.1f * random11();
+    sphere_objects.push_back( new Sphere( c, r, Material::glass() ) );
+    sphere_set.add( c, r, Material::glass() );
+  }
+  long nb_set_hits = 0;
+  measure( "64 Sphere::rayIntersection", nb_rounds * (long) rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : rays ) {
+          RayHit hit;
+          if ( Scene::linearRayIntersection( sphere_objects, ray, hit ) ) nb_set_hits += 1;
+        }
+    } );
+  measure( "SphereSet::rayIntersection (64)", nb_rounds * (long) rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : rays ) {
+          RayHit hit;
+          if ( sphere_set.rayIntersection( ray, hit ) ) nb_set_hits -= 1;
+        }
+    } );
+  // Shadow rays through the glass spheres, which are all tested.
+  measure( "SphereSet::occluded (64)", nb_rounds * (long) rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : rays ) {
+          bool transparent = false;
+          if ( sphere_set.occluded( ray, 1e30f, transparent ) || transparent ) nb_set_hits += 1;
+        }
+    } );
+  for ( GraphicalObject* obj : sphere_objects ) delete obj;
+
+  // The same rays against a unit sphere made of 2 x 256 x 512 triangles.
+  TriangleMesh mesh( Material::glass() );
+  const int nb_lat = 256, nb_lon = 512;
+  for ( int i = 0; i <= nb_lat; ++i )
+    for ( int j = 0; j < nb_lon; ++j ) {
+      Point3 p = sphere.localize( -90.0f + 180.0f * i / nb_lat, 360.0f * j / nb_lon );
+      mesh.addVertex( p );
+      mesh.addNormal( p );
+    }
+  for ( int i = 0; i < nb_lat; ++i )
+    for ( int j = 0; j < nb_lon; ++j ) {
+      int a = i * nb_lon + j, b = i * nb_lon + ( j + 1 ) % nb_lon;
+      int c = a + nb_lon, d = b + nb_lon;
+      mesh.addTriangle( a, b, d, a, b, d );
+      mesh.addTriangle( a, d, c, a, d, c );
+    }
+  measure( "TriangleMesh::prepare (262144 triangles)", 1, [&] () { mesh.prepare(); } );
+  long nb_mesh_hits = 0;
+  measure( "TriangleMesh::rayIntersection", nb_rounds * (long) rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : rays ) {
+          RayHit hit;
+          if ( mesh.rayIntersection( ray, hit ) ) nb_mesh_hits += 1;
+        }
+    } );
+
+  // Intersections of the eye rays with the demo scene.
+  Scene scene;
+  buildDemoScene( scene );
+  scene.prepare();
+  Renderer renderer( scene, 0 );
+  Point3 eye( -14, -16, 8 );
+  vector<Ray> eye_rays;
+  vector<RayHit> hits;
+  for ( int i = 0; i < 20000; ++i ) {
+    Ray ray( eye, Point3( 4.0f * random11(), 2.0f + 4.0f * random11(), -1.0f ) - eye, 0 );
+    RayHit hit;
+    if ( scene.rayIntersection( ray, hit ) ) {
+      eye_rays.push_back( ray );
+      hits.push_back( hit );
+    }
+  }
+  Real sum = 0.0f;
+  measure( "Renderer::illumination", nb_rounds * (long) hits.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( std::size_t i = 0; i < hits.size(); ++i )
+          sum += renderer.illumination( eye_rays[ i ], hits[ i ] ).clamp().r();
+    } );
+
+  // Closest hits of the primary rays of a 640x480 image, one by one
+  // and by packets of neighbouring pixels.
+  Renderer camera( scene, 0 );
+  camera.setViewBox( eye, Vector3( 0.6f, 1.0f, -0.6f ), Vector3( 1.0f, 0.6f, -0.6f ),
+                     Vector3( 0.6f, 1.0f, -1.1f ), Vector3( 1.0f, 0.6f, -1.1f ) );
+  camera.setResolution( 640, 480 );
+  vector<Ray> primary_rays;
+  for ( int y = 0; y < 480; ++y )
+    for ( int x = 0; x < 640; ++x )
+      primary_rays.push_back( Ray( eye, camera.direction( (Real) x, (Real) y ), 0 ) );
+  // The vector arithmetic of the camera rays and of the secondary rays.
+  Real vec_sum = 0.0f;
+  measure( "Renderer::direction", nb_rounds * 640L * 480L, [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( int y = 0; y < 480; ++y )
+          for ( int x = 0; x < 640; ++x )
+            vec_sum += camera.direction( (Real) x, (Real) y )[ 0 ];
+    } );
+  const Material glass = Material::glass();
+  measure( "Renderer::reflect and refractionRay", nb_rounds * (long) hits.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( std::size_t i = 0; i < hits.size(); ++i ) {
+          vec_sum += camera.reflect( eye_rays[ i ].direction, hits[ i ].normal )[ 1 ];
+          Ray refracted = camera.refractionRay( eye_rays[ i ], hits[ i ].point,
+                                                hits[ i ].normal, glass );
+          if ( refracted.depth >= 0 ) vec_sum += refracted.direction[ 2 ];
+        }
+    } );
+  long nb_primary_hits = 0;
+  measure( "Scene::rayIntersection", nb_rounds * (long) primary_rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( const Ray& ray : primary_rays ) {
+          RayHit hit;
+          if ( scene.rayIntersection( ray, hit ) ) nb_primary_hits += 1;
+        }
+    } );
+  measure( "Scene::rayIntersection (packets)", nb_rounds * (long) primary_rays.size(), [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( std::size_t i = 0; i < primary_rays.size(); i += RayPacket::SIZE ) {
+          RayHit packet_hits[ RayPacket::SIZE ];
+          int found = scene.rayIntersection( RayPacket( &primary_rays[ i ] ), packet_hits );
+          for ( int j = 0; j < RayPacket::SIZE; ++j ) nb_primary_hits -= ( found >> j ) & 1;
+        }
+    } );
+
+  // Spheres added one by one along +x to a prepared scene: the inserted
+  // branches must not degrade into a chain. Their closest hits and
+  // shadow rays, along -x and random, are checked against brute force.
+  Scene row;
+  row.addObject( new Sphere( Point3( 0, 0, 0 ), 0.3f, Material::bronze() ) );
+  row.prepare();
+  const int nb_row = 2000;
+  measure( "Scene::addObject (spheres in a row)", nb_row - 1, [&] () {
+      for ( int i = 1; i < nb_row; ++i )
+        row.addObject( new Sphere( Point3( (Real) i, 0, 0 ), 0.3f, Material::bronze() ) );
+    } );
+  vector<Ray> row_rays;
+  for ( int i = 0; i < 1000; ++i ) {
+    Point3 o( (Real) nb_row + 10.0f, 0.2f * random11(), 0.2f * random11() );
+    row_rays.push_back( Ray( o, Vector3( -1, 0, 0 ), 0 ) );
+    Point3 p( (Real) nb_row * 0.5f * ( 1.0f + random11() ), 0.5f * random11(), 0.5f * random11() );
+    Point3 q( (Real) nb_row * 0.5f * ( 1.0f + random11() ), 5.0f * random11(), 5.0f );
+    row_rays.push_back( Ray( q, p - q, 0 ) );
+  }
+  int nb_row_errors = 0;
+  for ( const Ray& ray : row_rays ) {
+    RayHit hit, linear_hit;
+    const bool found = row.rayIntersection( ray, hit );
+    if ( found != Scene::linearRayIntersection( row.myObjects, ray, linear_hit )
+         || ( found && hit.t != linear_hit.t ) )
+      nb_row_errors += 1;
+    bool shadowed = false, transparent = false;
+    for ( GraphicalObject* obj : row.myObjects )
+      if ( obj->occluded( ray, 1e30f, transparent ) ) shadowed = true;
+    if ( row.occluded( ray, 1e30f ) != shadowed ) nb_row_errors += 1;
+  }
+  cout << "  height " << row.myBVH.height() << " (max " << BVH::MAX_DEPTH << "), "
+       << nb_row_errors << " errors" << endl;
+
+  // Worley noise on a grid of the water plane, point by point and batched.
+  const int nb_samples = 256 * 256;
+  vector<float> xs( nb_samples ), ys( nb_samples ), zs( nb_samples, -2.0f ), F1( nb_samples );
+  for ( int i = 0; i < nb_samples; ++i ) {
+    xs[ i ] = 0.05f * (float) ( i % 256 );
+    ys[ i ] = 0.05f * (float) ( i / 256 );
+  }
+  float noise = 0.0f;
+  measure( "Worley", nb_rounds * (long) nb_samples, [&] () {
+      for ( int k = 0; k < nb_rounds; ++k )
+        for ( int i = 0; i < nb_samples; ++i ) {
+          float at[ 3 ] = { xs[ i ], ys[ i ], zs[ i ] };
+          noise += Worley( at );
+        }
+    } );
+  measure( "WorleyBatch", nb_rounds * (long) nb_samples, [&] () {
+      for ( int k = 0; k < nb_rounds; ++k ) {
+        WorleyBatch( xs.data(), ys.data(), zs.data(), F1.data(), nb_samples );
+        noise += F1[ k ];
+      }
+    } );
+
+  // Prevents the compiler from removing the loops.
+  cout << "(checksum " << nb_hits << " " << sum << " " << noise
+       << " " << nb_primary_hits << " " << nb_set_hits << " " << nb_mesh_hits
+       << " " << vec_sum << ")" << endl;
+  return 0;
+}
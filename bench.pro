@@ -0,0 +1,21 @@
+# Ceci est un fichier de configuration pour le micro-benchmark du lancer
+# de rayons (sans Qt). Pour comparer avec les boucles scalaires :
+#   qmake "DEFINES+=RT_NO_SIMD" bench.pro && make
+
+# nom de votre executable
+TARGET  = bench
+# config de l executable
+TEMPLATE = app
+CONFIG *= console release
+CONFIG += c++11 thread
+CONFIG -= qt app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+# Noms de vos fichiers entete
+HEADERS = PointVector.h PointVectorSIMD.h Color.h Sphere.h SphereSet.h TriangleMesh.h Instance.h Transform.h AlignedAllocator.h MaterialTable.h GraphicalObject.h Light.h \
+          Material.h PointLight.h Renderer.h Ray.h Scene.h PeriodicPlane.h worley.h \
+          WaterPlane.h TileScheduler.h BoundingBox.h BVH.h RayHit.h RayPacket.h WavefrontRenderer.h Random.h DemoScene.h NoiseVolume.h
+
+# Noms de vos fichiers source
+SOURCES = bench.cpp Sphere.cpp SphereSet.cpp TriangleMesh.cpp Instance.cpp PeriodicPlane.cpp WaterPlane.cpp \
+          BVH.cpp DemoScene.cpp NoiseVolume.cpp
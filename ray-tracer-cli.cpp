@@ -0,0 +1,225 @@
+/**
+@file ray-tracer-cli.cpp
+
+Headless renderer: renders the demo scene, or a scene file (see
+SceneDescription), into a PPM image without any window, which is what
+render-farm nodes need. It only links the
+ray-tracing core (no Qt, OpenGL or QGLViewer).
+*/
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Scene.h"
+#include "DemoScene.h"
+#include "SceneFile.h"
+#include "SceneCache.h"
+#include "TriangleMesh.h"
+#include "Renderer.h"
+#include "WavefrontRenderer.h"
+#include "Image2D.h"
+#include "Image2DWriter.h"
+#include "Image2DReader.h"
+
+using namespace std;
+using namespace rt;
+
+static void usage( const char* name )
+{
+    cerr << "Usage: " << name << " [options]" << endl
+         << "  --scene FILE          renders the scene file FILE (text, binary or cache) instead of" << endl
+         << "                        the demo scene, its settings become the defaults" << endl
+         << "  --save-scene FILE     writes the binary form of the scene file, with the" << endl
+         << "                        settings of the options, into FILE" << endl
+         << "  --save-cache FILE     writes the scene built and prepared into the cache FILE," << endl
+         << "                        which --scene then reads without building anything" << endl
+         << "  -o, --output FILE     output PPM image (default output.ppm)" << endl
+         << "  -s, --size WxH        resolution of the image (default 640x480)" << endl
+         << "  -d, --depth N         maximum depth of rays (default 6)" << endl
+         << "  -t, --threads N       number of threads, 0 for all cores (default 0)" << endl
+         << "  --eye X,Y,Z           position of the camera (default -14,-16,8)" << endl
+         << "  --target X,Y,Z        point looked at (default 0,2,-1)" << endl
+         << "  --up X,Y,Z            up direction of the camera (default 0,0,1)" << endl
+         << "  --fov DEG             vertical field of view in degrees (default 45)" << endl
+         << "  --sky FILE            PPM image of the sky (default sky.ppm)" << endl
+         << "  --noise N             precomputed N^3 noise for the sea, 0 for the" << endl
+         << "                        exact Worley noise (default 0)" << endl
+         << "  --stochastic          follows one random branch at each reflexion or" << endl
+         << "                        refraction instead of both" << endl
+         << "  --spp N               samples per pixel of stochastic renders (default 1)" << endl
+         << "  --aa MIN,MAX,T        adaptive antialiasing: MIN samples per pixel, up to" << endl
+         << "                        MAX where the color varies by more than T (e.g. 4,16,0.05)" << endl
+         << "  --shadow-rays N       shadow rays per shading point, towards lights chosen" << endl
+         << "                        by their contribution, 0 for all lights (default 0)" << endl
+         << "  --light-threshold T   skips the lights contributing less than T (default 0)" << endl
+         << "  --no-packets          traces the primary rays one by one instead of" << endl
+         << "                        by packets of 4 (same image)" << endl
+         << "  --wavefront           traces the rays stage by stage instead of" << endl
+         << "                        recursively (same image, deterministic mode only)" << endl
+         << "  --mesh FILE           adds the triangle mesh of an OBJ file to the scene" << endl
+         << "  --mesh-at X,Y,Z,SIZE  center and size of the mesh (default 4,-2,0,3)" << endl;
+}
+
+/// Reads a vector written "x,y,z".
+static bool readVector( const char* str, Vector3& v )
+{
+    return sscanf( str, "%f,%f,%f", &v[ 0 ], &v[ 1 ], &v[ 2 ] ) == 3;
+}
+
+int main( int argc, char** argv )
+{
+    // The scene file is read first: its settings are the defaults of
+    // the other options. A scene cache gives the scene already built.
+    string scene_name, save_name, cache_name;
+    for ( int i = 1; i + 1 < argc; ++i )
+        if ( string( argv[ i ] ) == "--scene" ) scene_name = argv[ i + 1 ];
+    Scene scene;
+    SceneDescription description;
+    bool cached = ! scene_name.empty() && SceneCache::isCache( scene_name );
+    if ( cached ? ! SceneCache::read( scene_name, description, scene )
+                : ! scene_name.empty() && ! description.read( scene_name ) )
+        return 1;
+    RenderSettings& settings = description.settings;
+
+    string output_name = "output.ppm";
+    string sky_name    = settings.sky;
+    string mesh_name;
+    int width = settings.width, height = settings.height, max_depth = settings.max_depth;
+    int nb_threads = 0, noise = settings.noise, spp = settings.spp;
+    int aa_min = settings.aa_min, aa_max = settings.aa_max;
+    Real aa_threshold = settings.aa_threshold;
+    int shadow_rays = settings.shadow_rays;
+    Real light_threshold = settings.light_threshold;
+    bool stochastic = settings.stochastic, packets = true, wavefront = false;
+    Vector3 eye = settings.eye, target = settings.target, up = settings.up;
+    Real fov = settings.fov;
+    Point3 mesh_center( 4, -2, 0 );
+    Real mesh_size = 3.0f;
+
+    for ( int i = 1; i < argc; ++i ) {
+        string arg = argv[ i ];
+        bool has_value = i + 1 < argc;
+        const char* value = has_value ? argv[ i + 1 ] : "";
+        bool ok = has_value;
+        if ( arg == "-h" || arg == "--help" ) { usage( argv[ 0 ] ); return 0; }
+        if ( arg == "--stochastic" ) { stochastic = true; continue; }
+        if ( arg == "--no-packets" ) { packets = false; continue; }
+        if ( arg == "--wavefront" )  { wavefront = true; continue; }
+        else if ( arg == "--scene" )  {} // already read
+        else if ( arg == "--save-scene" ) save_name = value;
+        else if ( arg == "--save-cache" ) cache_name = value;
+        else if ( arg == "-o" || arg == "--output" )  output_name = value;
+        else if ( arg == "-s" || arg == "--size" )    ok = ok && sscanf( value, "%dx%d", &width, &height ) == 2;
+        else if ( arg == "-d" || arg == "--depth" )   ok = ok && sscanf( value, "%d", &max_depth ) == 1;
+        else if ( arg == "-t" || arg == "--threads" ) ok = ok && sscanf( value, "%d", &nb_threads ) == 1;
+        else if ( arg == "--eye" )    ok = ok && readVector( value, eye );
+        else if ( arg == "--target" ) ok = ok && readVector( value, target );
+        else if ( arg == "--up" )     ok = ok && readVector( value, up );
+        else if ( arg == "--fov" )    ok = ok && sscanf( value, "%f", &fov ) == 1;
+        else if ( arg == "--sky" )    sky_name = value;
+        else if ( arg == "--noise" )  ok = ok && sscanf( value, "%d", &noise ) == 1;
+        else if ( arg == "--spp" )    ok = ok && sscanf( value, "%d", &spp ) == 1;
+        else if ( arg == "--shadow-rays" ) ok = ok && sscanf( value, "%d", &shadow_rays ) == 1 && shadow_rays >= 0;
+        else if ( arg == "--light-threshold" ) ok = ok && sscanf( value, "%f", &light_threshold ) == 1;
+        else if ( arg == "--mesh" )   mesh_name = value;
+        else if ( arg == "--mesh-at" ) ok = ok && sscanf( value, "%f,%f,%f,%f", &mesh_center[ 0 ], &mesh_center[ 1 ],
+                                                          &mesh_center[ 2 ], &mesh_size ) == 4 && mesh_size > 0.0f;
+        else if ( arg == "--aa" )     ok = ok && sscanf( value, "%d,%d,%f", &aa_min, &aa_max, &aa_threshold ) == 3
+                                         && aa_min >= 0 && aa_max >= aa_min;
+        else ok = false;
+        if ( ! ok || width < 2 || height < 2 || max_depth < 0 || noise < 0 || spp < 1 ) {
+            cerr << "Invalid argument " << arg << endl;
+            usage( argv[ 0 ] );
+            return 1;
+        }
+        ++i;
+    }
+
+    if ( ( ! save_name.empty() || ! cache_name.empty() ) && scene_name.empty() ) {
+        cerr << "--save-scene and --save-cache need --scene." << endl;
+        return 1;
+    }
+    if ( ! cache_name.empty() && cached ) {
+        cerr << "--save-cache needs a scene file, not a cache." << endl;
+        return 1;
+    }
+    if ( cached && noise != settings.noise ) {
+        cerr << "--noise is ignored with a scene cache." << endl;
+        noise = settings.noise;
+    }
+    // The saved files keep the settings of the options.
+    settings.eye = eye; settings.target = target; settings.up = up; settings.fov = fov;
+    settings.width = width; settings.height = height; settings.max_depth = max_depth;
+    settings.spp = spp; settings.stochastic = stochastic; settings.noise = noise;
+    settings.aa_min = aa_min; settings.aa_max = aa_max; settings.aa_threshold = aa_threshold;
+    settings.sky = sky_name;
+    settings.shadow_rays = shadow_rays; settings.light_threshold = light_threshold;
+    if ( ! save_name.empty() && ! description.writeBinary( save_name ) ) return 1;
+
+    // Creates the 3D scene (unless read from a cache)
+    if ( scene_name.empty() )
+        buildDemoScene( scene, noise );
+    else if ( ! cached ) {
+        vector< shared_ptr<TriangleMesh> > mesh_objects;
+        if ( ! description.loadMeshes( mesh_objects, nb_threads ) ) return 1;
+        description.build( scene, mesh_objects );
+        if ( ! cache_name.empty()
+             && ! SceneCache::write( cache_name, description, mesh_objects, scene ) )
+            return 1;
+    }
+    if ( ! mesh_name.empty() ) {
+        TriangleMesh* mesh = new TriangleMesh( Material::redPlastic() );
+        if ( ! mesh->loadOBJ( mesh_name, nb_threads ) ) {
+            delete mesh;
+            return 1;
+        }
+        cout << "Mesh " << mesh_name << ": " << mesh->size() << " triangles." << endl;
+        mesh->fit( mesh_center, mesh_size );
+        scene.addObject( mesh );
+    }
+
+    Image2D<Color> sky;
+    ifstream input( sky_name.c_str(), ifstream::binary );
+    bool has_sky = input.good() && Image2DReader<Color>::read( sky, input, false );
+    input.close();
+    if ( ! has_sky )
+        cerr << "Error reading sky file " << sky_name << ", rendering without sky." << endl;
+    MyBackground bg( sky );
+
+    // Pinhole camera: directions of the rays through the four corners.
+    Vector3 front = ( target - eye ).normalized();
+    Vector3 right = front.cross( up ).normalized();
+    Vector3 top = right.cross( front );
+    Real h = std::tan( fov * 0.5f * M_PI / 180.0f );
+    Real w = h * (Real) width / (Real) height;
+    Renderer renderer( scene, has_sky ? &bg : 0 );
+    renderer.setViewBox( eye,
+                         front - w * right + h * top, front + w * right + h * top,
+                         front - w * right - h * top, front + w * right - h * top );
+    renderer.setResolution( width, height );
+    renderer.setNbThreads( nb_threads );
+    renderer.setStochastic( stochastic );
+    renderer.setPackets( packets );
+    renderer.setSamplesPerPixel( spp );
+    renderer.setAntialiasing( aa_min, aa_max, aa_threshold );
+    renderer.setLightSampling( shadow_rays, light_threshold );
+
+    Image2D<Color> image( width, height );
+    if ( wavefront ) {
+        if ( stochastic || aa_min > 0 )
+            cerr << "--wavefront ignores --stochastic and --aa." << endl;
+        WavefrontRenderer( renderer ).render( image, max_depth );
+    } else
+        renderer.render( image, max_depth );
+    ofstream output( output_name.c_str(), ofstream::binary );
+    if ( ! Image2DWriter<Color>::write( image, output, false ) || ! output.good() ) {
+        cerr << "Error writing output file " << output_name << endl;
+        return 1;
+    }
+    return 0;
+}
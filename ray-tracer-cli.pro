@@ -0,0 +1,22 @@
+# Ceci est un fichier de configuration pour le rendu en ligne de commande,
+# sans Qt, OpenGL ni libQGLViewer (par exemple sur une ferme de rendu).
+#   qmake ray-tracer-cli.pro && make
+
+# nom de votre executable
+TARGET  = ray-tracer-cli
+# config de l executable
+TEMPLATE = app
+CONFIG *= console release
+CONFIG += c++11 thread
+CONFIG -= qt app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+# Noms de vos fichiers entete
+HEADERS = PointVector.h PointVectorSIMD.h Color.h Sphere.h SphereSet.h TriangleMesh.h Instance.h Transform.h AlignedAllocator.h MaterialTable.h GraphicalObject.h Light.h \
+          Material.h PointLight.h Image2D.h Image2DWriter.h Image2DReader.h \
+          Renderer.h Ray.h Scene.h PeriodicPlane.h worley.h WaterPlane.h \
+          TileScheduler.h BoundingBox.h BVH.h RayHit.h RayPacket.h WavefrontRenderer.h Random.h DemoScene.h SceneFile.h SceneCache.h MappedFile.h NoiseVolume.h
+
+# Noms de vos fichiers source
+SOURCES = ray-tracer-cli.cpp Sphere.cpp SphereSet.cpp TriangleMesh.cpp Instance.cpp PeriodicPlane.cpp WaterPlane.cpp \
+          BVH.cpp DemoScene.cpp SceneFile.cpp SceneCache.cpp NoiseVolume.cpp
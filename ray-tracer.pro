@@ -5,18 +5,21 @@
 TARGET  = ray-tracer
 # config de l executable
 CONFIG *= qt opengl release
-CONFIG += c++11
+CONFIG += c++11 thread
 # config de Qt
 QT     *= opengl xml
 QMAKE_CXXFLAGS += -std=c++11
 
 # Noms de vos fichiers entete
-HEADERS = Viewer.h PointVector.h Color.h Sphere.h GraphicalObject.h Light.h \
+HEADERS = Viewer.h PointVector.h PointVectorSIMD.h Color.h Sphere.h SphereSet.h TriangleMesh.h Instance.h Transform.h AlignedAllocator.h MaterialTable.h GraphicalObject.h Light.h \
           Material.h PointLight.h Image2D.h Image2DWriter.h Renderer.h Ray.h \
-          Scene.h PeriodicPlane.h worley.h WaterPlane.h
+          Scene.h PeriodicPlane.h worley.h WaterPlane.h TileScheduler.h \
+          BoundingBox.h BVH.h RayHit.h RayPacket.h WavefrontRenderer.h Random.h GLDraw.h DemoScene.h SceneFile.h SceneCache.h MappedFile.h NoiseVolume.h \
+          ProgressiveRenderer.h GBuffer.h
           
 # Noms de vos fichiers source
-SOURCES = Viewer.cpp ray-tracer.cpp Sphere.cpp PeriodicPlane.cpp worley.cpp WaterPlane.cpp
+SOURCES = Viewer.cpp ray-tracer.cpp Sphere.cpp SphereSet.cpp TriangleMesh.cpp Instance.cpp PeriodicPlane.cpp WaterPlane.cpp \
+          BVH.cpp GLDraw.cpp DemoScene.cpp SceneFile.cpp SceneCache.cpp NoiseVolume.cpp
 
 ###########################################################
 # Commentez/decommentez selon votre config/systeme
@@ -34,6 +34,8 @@
 
    <at>    The input sample location.
    <max_order>  Smaller values compute faster. < 5, read the book to extend it.
+            It is a template parameter, so that all working arrays live
+            on the stack.
    <F>     The output values of F_1, F_2, ..F[n] in F[0], F[1], F[n-1]
    <delta> The output vector difference between the sample point and the n-th
             closest feature point. Thus, the feature point's location is the
@@ -54,7 +56,421 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <math.h>
+#if defined(__SSE2__) && !defined(RT_NO_SIMD)
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#endif
 
-double Worley(double at[3]);
+/* Header-only version: the function is templated on <max_order> and on
+   the floating-point type T (float or double) of the computations. */
+
+namespace worley_detail {
+
+  /* A hardwired lookup table to quickly determine how many feature
+     points should be in each spatial cube. We use a table so we don't
+     need to make multiple slower tests.  A random number indexed into
+     this array will give an approximate Poisson distribution of mean
+     density 2.5. Read the book for the long-winded explanation. */
+  static const int Poisson_count[256]=
+      {4,3,1,1,1,2,4,2,2,2,5,1,0,2,1,2,2,0,4,3,2,1,2,1,3,2,2,4,2,2,5,1,2,3,2,2,2,2,2,3,
+      2,4,2,5,3,2,2,2,5,3,3,5,2,1,3,3,4,4,2,3,0,4,2,2,2,1,3,2,2,2,3,3,3,1,2,0,2,1,1,2,
+      2,2,2,5,3,2,3,2,3,2,2,1,0,2,1,1,2,1,2,2,1,3,4,2,2,2,5,4,2,4,2,2,5,4,3,2,2,5,4,3,
+      3,3,5,2,2,2,2,2,3,1,1,4,2,1,3,3,4,3,2,4,3,3,3,4,5,1,4,2,4,3,1,2,3,5,3,2,1,3,1,3,
+      3,3,2,3,1,5,5,4,2,2,4,1,3,4,1,5,3,3,5,3,4,3,2,2,1,1,1,1,1,2,4,5,4,5,4,2,1,5,1,1,
+      2,3,3,3,2,5,2,3,3,2,0,2,1,1,4,2,1,3,2,1,2,2,3,2,5,5,3,4,5,5,2,4,4,5,3,2,2,2,1,4,
+      2,3,3,4,2,5,4,2,4,2,2,2,4,5,3,2};
+
+  /* This constant is manipulated to make sure that the mean value of F[0]
+     is 1.0. This makes an easy natural "scale" size of the cellular features. */
+  const double DENSITY_ADJUSTMENT = 0.398150;
+
+  /* This is a *lot* faster than using (int32_t)floor() on an x86 CPU.
+     It actually speeds up the entire Worley() call with almost 10%.
+     Added by Stefan Gustavson, October 2003. */
+  template <typename T>
+  inline int32_t LFLOOR(T x) { return x<0 ? ((int32_t)x-1) : ((int32_t)x); }
+
+  /* @return i modulo <period>, in [0,period[. */
+  inline int32_t Wrap(int32_t i, int32_t period)
+  {
+    i%=period;
+    return i<0 ? i+period : i;
+  }
+
+  /* the function to merge-sort a "cube" of samples into the current best-found
+     list of values. */
+  template <size_t max_order, typename T>
+  inline void AddSamples(int32_t xi, int32_t yi, int32_t zi,
+                         const T at[3], T F[max_order],
+                         T delta[max_order][3], uint32_t ID[max_order],
+                         int32_t period)
+  {
+    T dx, dy, dz, fx, fy, fz, d2;
+    int32_t count, i, j, index;
+    uint32_t seed, this_id;
+
+    /* Each cube has a random number seed based on the cube's ID number.
+       The seed might be better if it were a nonlinear hash like Perlin uses
+       for noise but we do very well with this faster simple one.
+       Our LCG uses Knuth-approved constants for maximal periods.
+       For a periodic noise, the ID numbers wrap around. */
+    if (period>0)
+      seed=702395077*Wrap(xi, period) + 915488749*Wrap(yi, period)
+        + 2120969693*Wrap(zi, period);
+    else
+      seed=702395077*xi + 915488749*yi + 2120969693*zi;
+
+    /* How many feature points are in this cube? */
+    count=Poisson_count[seed>>24]; /* 256 element lookup table. Use MSB */
+
+    seed=1402024253*seed+586950981; /* churn the seed with good Knuth LCG */
+
+    for (j=0; j<count; j++) /* test and insert each point into our solution */
+    {
+      this_id=seed;
+      seed=1402024253*seed+586950981; /* churn */
+
+      /* compute the 0..1 feature point location's XYZ */
+      fx=((T)seed+(T)0.5)*(T)(1.0/4294967296.0);
+      seed=1402024253*seed+586950981; /* churn */
+      fy=((T)seed+(T)0.5)*(T)(1.0/4294967296.0);
+      seed=1402024253*seed+586950981; /* churn */
+      fz=((T)seed+(T)0.5)*(T)(1.0/4294967296.0);
+      seed=1402024253*seed+586950981; /* churn */
+
+      /* delta from feature point to sample location */
+      dx=(T)xi+fx-at[0];
+      dy=(T)yi+fy-at[1];
+      dz=(T)zi+fz-at[2];
+
+      /* Distance computation!  Lots of interesting variations are
+         possible here!
+         Biased "stretched"   A*dx*dx+B*dy*dy+C*dz*dz
+         Manhattan distance   fabs(dx)+fabs(dy)+fabs(dz)
+         Radial Manhattan:    A*fabs(dR)+B*fabs(dTheta)+C*dz
+         Superquadratic:      pow(fabs(dx), A) + pow(fabs(dy), B) + pow(fabs(dz),C)
+
+         Go ahead and make your own! Remember that you must insure that
+         new distance function causes large deltas in 3D space to map into
+         large deltas in your distance function, so our 3D search can find
+         them! [Alternatively, change the search algorithm for your special
+         cases.]
+      */
+
+      d2=dx*dx+dy*dy+dz*dz; /* Euclidian distance, squared */
+
+      if (d2<F[max_order-1]) /* Is this point close enough to rememember? */
+      {
+        /* Insert the information into the output arrays if it's close enough.
+           We use an insertion sort.  No need for a binary search to find
+           the appropriate index.. usually we're dealing with order 2,3,4 so
+           we can just go through the list. If you were computing order 50
+           (wow!!) you could get a speedup with a binary search in the sorted
+           F[] list. */
+
+        index=max_order;
+        while (index>0 && d2<F[index-1]) index--;
+
+        /* We insert this new point into slot # <index> */
+
+        /* Bump down more distant information to make room for this new point. */
+        for (i=(int32_t)max_order-2; i>=index; i--)
+        {
+          F[i+1]=F[i];
+          ID[i+1]=ID[i];
+          delta[i+1][0]=delta[i][0];
+          delta[i+1][1]=delta[i][1];
+          delta[i+1][2]=delta[i][2];
+        }
+        /* Insert the new point's information into the list. */
+        F[index]=d2;
+        ID[index]=this_id;
+        delta[index][0]=dx;
+        delta[index][1]=dy;
+        delta[index][2]=dz;
+      }
+    }
+  }
+
+} // namespace worley_detail
+
+/* The main function! Computes F_1 .. F_<max_order> in <F>, with the
+   corresponding <delta> vectors and feature point <ID>s. If <period> is
+   positive, the noise is periodic along each axis, of period
+   <period>/DENSITY_ADJUSTMENT (i.e. <period> cubes). */
+template <size_t max_order, typename T>
+inline void Worley(const T at[3], T F[max_order], T delta[max_order][3],
+                   uint32_t ID[max_order], int32_t period = 0)
+{
+  using namespace worley_detail;
+  const T D = (T)DENSITY_ADJUSTMENT;
+  T x2,y2,z2, mx2, my2, mz2;
+  T new_at[3];
+  int32_t int_at[3];
+  size_t i;
+
+  /* Initialize the F values to "huge" so they will be replaced by the
+     first real sample tests. Note we'll be storing and comparing the
+     SQUARED distance from the feature points to avoid lots of slow
+     sqrt() calls. We'll use sqrt() only on the final answer. */
+  for (i=0; i<max_order; i++) F[i]=(T)999999.9;
+
+  /* Make our own local copy, multiplying to make mean(F[0])==1.0  */
+  new_at[0]=D*at[0];
+  new_at[1]=D*at[1];
+  new_at[2]=D*at[2];
+
+  /* Find the integer cube holding the hit point */
+  int_at[0]=LFLOOR(new_at[0]);
+  int_at[1]=LFLOOR(new_at[1]);
+  int_at[2]=LFLOOR(new_at[2]);
+
+  /* A simple way to compute the closest neighbors would be to test all
+     boundary cubes exhaustively. But this wastes a lot of time working on
+     cubes which are known to be too far away to matter! So we can use a
+     more complex testing method that avoids this needless testing of
+     distant cubes. This doubles the speed of the algorithm. */
+
+  /* Test the central cube for closest point(s). */
+  AddSamples<max_order>(int_at[0], int_at[1], int_at[2], new_at, F, delta, ID, period);
+
+  /* We test if neighbor cubes are even POSSIBLE contributors by examining the
+     combinations of the sum of the squared distances from the cube's lower
+     or upper corners.*/
+  x2=new_at[0]-(T)int_at[0];
+  y2=new_at[1]-(T)int_at[1];
+  z2=new_at[2]-(T)int_at[2];
+  mx2=((T)1-x2)*((T)1-x2);
+  my2=((T)1-y2)*((T)1-y2);
+  mz2=((T)1-z2)*((T)1-z2);
+  x2*=x2;
+  y2*=y2;
+  z2*=z2;
+
+  /* Test 6 facing neighbors of center cube. These are closest and most
+     likely to have a close feature point. */
+  if (x2<F[max_order-1])  AddSamples<max_order>(int_at[0]-1, int_at[1]  , int_at[2]  , new_at, F, delta, ID, period);
+  if (y2<F[max_order-1])  AddSamples<max_order>(int_at[0]  , int_at[1]-1, int_at[2]  , new_at, F, delta, ID, period);
+  if (z2<F[max_order-1])  AddSamples<max_order>(int_at[0]  , int_at[1]  , int_at[2]-1, new_at, F, delta, ID, period);
+
+  if (mx2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]  , int_at[2]  , new_at, F, delta, ID, period);
+  if (my2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]+1, int_at[2]  , new_at, F, delta, ID, period);
+  if (mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]  , int_at[2]+1, new_at, F, delta, ID, period);
+
+  /* Test 12 "edge cube" neighbors if necessary. They're next closest. */
+  if ( x2+ y2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]-1, int_at[2]  , new_at, F, delta, ID, period);
+  if ( x2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]  , int_at[2]-1, new_at, F, delta, ID, period);
+  if ( y2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]-1, int_at[2]-1, new_at, F, delta, ID, period);
+  if (mx2+my2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]+1, int_at[2]  , new_at, F, delta, ID, period);
+  if (mx2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]  , int_at[2]+1, new_at, F, delta, ID, period);
+  if (my2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]+1, int_at[2]+1, new_at, F, delta, ID, period);
+  if ( x2+my2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]+1, int_at[2]  , new_at, F, delta, ID, period);
+  if ( x2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]  , int_at[2]+1, new_at, F, delta, ID, period);
+  if ( y2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]-1, int_at[2]+1, new_at, F, delta, ID, period);
+  if (mx2+ y2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]-1, int_at[2]  , new_at, F, delta, ID, period);
+  if (mx2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]  , int_at[2]-1, new_at, F, delta, ID, period);
+  if (my2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]  , int_at[1]+1, int_at[2]-1, new_at, F, delta, ID, period);
+
+  /* Final 8 "corner" cubes */
+  if ( x2+ y2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]-1, int_at[2]-1, new_at, F, delta, ID, period);
+  if ( x2+ y2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]-1, int_at[2]+1, new_at, F, delta, ID, period);
+  if ( x2+my2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]+1, int_at[2]-1, new_at, F, delta, ID, period);
+  if ( x2+my2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]-1, int_at[1]+1, int_at[2]+1, new_at, F, delta, ID, period);
+  if (mx2+ y2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]-1, int_at[2]-1, new_at, F, delta, ID, period);
+  if (mx2+ y2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]-1, int_at[2]+1, new_at, F, delta, ID, period);
+  if (mx2+my2+ z2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]+1, int_at[2]-1, new_at, F, delta, ID, period);
+  if (mx2+my2+mz2<F[max_order-1]) AddSamples<max_order>(int_at[0]+1, int_at[1]+1, int_at[2]+1, new_at, F, delta, ID, period);
+
+  /* We're done! Convert everything to right size scale */
+  for (i=0; i<max_order; i++)
+  {
+    F[i]=sqrt(F[i])*(T)(1.0/DENSITY_ADJUSTMENT);
+    delta[i][0]*=(T)(1.0/DENSITY_ADJUSTMENT);
+    delta[i][1]*=(T)(1.0/DENSITY_ADJUSTMENT);
+    delta[i][2]*=(T)(1.0/DENSITY_ADJUSTMENT);
+  }
+}
+
+/* Shortcut returning only F_1 (and computing F_1 .. F_<max_order>),
+   e.g. Worley(at) with double or float coordinates. */
+template <size_t max_order = 1, typename T>
+inline T Worley(const T at[3], int32_t period = 0)
+{
+  T F[max_order];
+  T delta[max_order][3];
+  uint32_t ID[max_order];
+  Worley<max_order>(at, F, delta, ID, period);
+  return F[0];
+}
+
+#if defined(__SSE2__) && !defined(RT_NO_SIMD)
+namespace worley_detail {
+
+  /* The 26 neighbor cubes, in the order of Worley(): the 6 facing
+     cubes, then the 12 edge cubes, then the 8 corner cubes. */
+  static const int NEIGHBORS[26][3]={
+    {-1, 0, 0}, { 0,-1, 0}, { 0, 0,-1}, { 1, 0, 0}, { 0, 1, 0}, { 0, 0, 1},
+    {-1,-1, 0}, {-1, 0,-1}, { 0,-1,-1}, { 1, 1, 0}, { 1, 0, 1}, { 0, 1, 1},
+    {-1, 1, 0}, {-1, 0, 1}, { 0,-1, 1}, { 1,-1, 0}, { 1, 0,-1}, { 0, 1,-1},
+    {-1,-1,-1}, {-1,-1, 1}, {-1, 1,-1}, {-1, 1, 1},
+    { 1,-1,-1}, { 1,-1, 1}, { 1, 1,-1}, { 1, 1, 1} };
+
+  /* 32 bit multiplication of each lane, i.e. what (u)int32_t do. */
+  inline __m128i mullo(__m128i a, __m128i b)
+  {
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even=_mm_mul_epu32(a, b);
+    __m128i odd =_mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                              _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0,0,2,0)));
+#endif
+  }
+
+  /* a*seed+c in each lane: with a=1402024253 and c=586950981, this is
+     the Knuth LCG that churns the seed in AddSamples. */
+  inline __m128i lcg(__m128i seed, int32_t a, int32_t c)
+  {
+    return _mm_add_epi32(mullo(seed, _mm_set1_epi32(a)), _mm_set1_epi32(c));
+  }
+
+  /* The 0..1 feature point coordinate of each lane, rounded as
+     ((float)seed+0.5f)*(float)(1.0/4294967296.0). The two 16 bit halves
+     are converted exactly, so that their sum is rounded once. */
+  inline __m128 unitFloat(__m128i seed)
+  {
+    __m128 hi=_mm_cvtepi32_ps(_mm_srli_epi32(seed, 16));
+    __m128 lo=_mm_cvtepi32_ps(_mm_and_si128(seed, _mm_set1_epi32(0xffff)));
+    __m128 f =_mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+    return _mm_mul_ps(_mm_add_ps(f, _mm_set1_ps(0.5f)),
+                      _mm_set1_ps((float)(1.0/4294967296.0)));
+  }
+
+  /* AddSamples for max_order == 1, each lane testing its own cube
+     (xi, yi, zi) against its own (scaled) sample location. */
+  inline void AddSamples4(__m128i xi, __m128i yi, __m128i zi,
+                          __m128 at_x, __m128 at_y, __m128 at_z, __m128& F,
+                          int32_t period)
+  {
+    __m128i hx=xi, hy=yi, hz=zi;
+    if (period>0) /* the ID numbers of a periodic noise wrap around */
+    {
+      int32_t c[3][4];
+      _mm_storeu_si128((__m128i*)c[0], xi);
+      _mm_storeu_si128((__m128i*)c[1], yi);
+      _mm_storeu_si128((__m128i*)c[2], zi);
+      for (int a=0; a<3; a++)
+        for (int l=0; l<4; l++) c[a][l]=Wrap(c[a][l], period);
+      hx=_mm_loadu_si128((const __m128i*)c[0]);
+      hy=_mm_loadu_si128((const __m128i*)c[1]);
+      hz=_mm_loadu_si128((const __m128i*)c[2]);
+    }
+    __m128i seed=_mm_add_epi32(_mm_add_epi32(mullo(hx, _mm_set1_epi32(702395077)),
+                                             mullo(hy, _mm_set1_epi32(915488749))),
+                               mullo(hz, _mm_set1_epi32(2120969693)));
+    /* How many feature points are in each cube? */
+    uint32_t seeds[4];
+    _mm_storeu_si128((__m128i*)seeds, seed);
+    int32_t c0=Poisson_count[seeds[0]>>24], c1=Poisson_count[seeds[1]>>24];
+    int32_t c2=Poisson_count[seeds[2]>>24], c3=Poisson_count[seeds[3]>>24];
+    int32_t max_count=c0;
+    if (c1>max_count) max_count=c1;
+    if (c2>max_count) max_count=c2;
+    if (c3>max_count) max_count=c3;
+    __m128i count=_mm_setr_epi32(c0, c1, c2, c3);
+
+    __m128 fxi=_mm_cvtepi32_ps(xi), fyi=_mm_cvtepi32_ps(yi), fzi=_mm_cvtepi32_ps(zi);
+    seed=lcg(seed, 1402024253, 586950981); /* churn */
+    for (int32_t j=0; j<max_count; j++)
+    {
+      /* The 4 churns of the scalar loop, computed independently from
+         the current seed with the constants of the LCG applied 1 to 4
+         times. */
+      __m128 fx=unitFloat(lcg(seed, 1402024253, 586950981));
+      __m128 fy=unitFloat(lcg(seed, 1586653321, 2081239990));
+      __m128 fz=unitFloat(lcg(seed, 796795301, -2061676125));
+      seed=lcg(seed, 49518929, -1913925604);
+
+      __m128 dx=_mm_sub_ps(_mm_add_ps(fxi, fx), at_x);
+      __m128 dy=_mm_sub_ps(_mm_add_ps(fyi, fy), at_y);
+      __m128 dz=_mm_sub_ps(_mm_add_ps(fzi, fz), at_z);
+      __m128 d2=_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                           _mm_mul_ps(dz, dz));
+      /* lanes whose cube has fewer points keep their F */
+      __m128 active=_mm_castsi128_ps(_mm_cmpgt_epi32(count, _mm_set1_epi32(j)));
+      F=_mm_or_ps(_mm_and_ps(active, _mm_min_ps(F, d2)), _mm_andnot_ps(active, F));
+    }
+  }
+
+} // namespace worley_detail
+#endif
+
+/* Batched F_1: computes Worley<1> of the <n> sample locations given in
+   struct-of-arrays layout (x[i], y[i], z[i]) into F1[i]. With SSE2, four
+   locations are processed at once, one per lane: every lane searches the
+   neighbor cubes that any of the four may need, which gives the same
+   F_1 as the scalar float version. <period> is the one of Worley(). */
+inline void WorleyBatch(const float* x, const float* y, const float* z,
+                        float* F1, size_t n, int32_t period = 0)
+{
+  size_t i=0;
+#if defined(__SSE2__) && !defined(RT_NO_SIMD)
+  using namespace worley_detail;
+  const __m128 D=_mm_set1_ps((float)DENSITY_ADJUSTMENT);
+  const __m128 one=_mm_set1_ps(1.0f);
+  for (; i+4<=n; i+=4)
+  {
+    __m128 at_x=_mm_mul_ps(D, _mm_loadu_ps(x+i));
+    __m128 at_y=_mm_mul_ps(D, _mm_loadu_ps(y+i));
+    __m128 at_z=_mm_mul_ps(D, _mm_loadu_ps(z+i));
+    /* LFLOOR of each lane */
+    __m128i int_x=_mm_add_epi32(_mm_cvttps_epi32(at_x),
+                                _mm_castps_si128(_mm_cmplt_ps(at_x, _mm_setzero_ps())));
+    __m128i int_y=_mm_add_epi32(_mm_cvttps_epi32(at_y),
+                                _mm_castps_si128(_mm_cmplt_ps(at_y, _mm_setzero_ps())));
+    __m128i int_z=_mm_add_epi32(_mm_cvttps_epi32(at_z),
+                                _mm_castps_si128(_mm_cmplt_ps(at_z, _mm_setzero_ps())));
+    __m128 F=_mm_set1_ps((float)999999.9);
+    AddSamples4(int_x, int_y, int_z, at_x, at_y, at_z, F, period);
+
+    /* squared distances to the lower (x2) and upper (mx2) faces */
+    __m128 x2=_mm_sub_ps(at_x, _mm_cvtepi32_ps(int_x));
+    __m128 y2=_mm_sub_ps(at_y, _mm_cvtepi32_ps(int_y));
+    __m128 z2=_mm_sub_ps(at_z, _mm_cvtepi32_ps(int_z));
+    /* bounds[a][o+1]: squared distance to the neighbor cube at offset o
+       along axis a. */
+    __m128 bounds[3][3]={
+      { _mm_mul_ps(x2, x2), _mm_setzero_ps(), _mm_mul_ps(_mm_sub_ps(one, x2), _mm_sub_ps(one, x2)) },
+      { _mm_mul_ps(y2, y2), _mm_setzero_ps(), _mm_mul_ps(_mm_sub_ps(one, y2), _mm_sub_ps(one, y2)) },
+      { _mm_mul_ps(z2, z2), _mm_setzero_ps(), _mm_mul_ps(_mm_sub_ps(one, z2), _mm_sub_ps(one, z2)) } };
+
+    /* A neighbor cube is tested if it may hold a closer point for some
+       lane. */
+    for (int k=0; k<26; k++)
+    {
+      const int* o=NEIGHBORS[k];
+      __m128 bound=_mm_add_ps(_mm_add_ps(bounds[0][o[0]+1], bounds[1][o[1]+1]),
+                              bounds[2][o[2]+1]);
+      if (_mm_movemask_ps(_mm_cmplt_ps(bound, F))==0) continue;
+      AddSamples4(_mm_add_epi32(int_x, _mm_set1_epi32(o[0])),
+                  _mm_add_epi32(int_y, _mm_set1_epi32(o[1])),
+                  _mm_add_epi32(int_z, _mm_set1_epi32(o[2])), at_x, at_y, at_z, F,
+                  period);
+    }
+
+    _mm_storeu_ps(F1+i, _mm_mul_ps(_mm_sqrt_ps(F),
+                                   _mm_set1_ps((float)(1.0/DENSITY_ADJUSTMENT))));
+  }
+#endif
+  for (; i<n; i++)
+  {
+    float at[3]={ x[i], y[i], z[i] };
+    F1[i]=Worley(at, period);
+  }
+}
 
 #endif /* __WORLEY__NOISE__ */